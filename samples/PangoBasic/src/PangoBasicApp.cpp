@@ -57,6 +57,16 @@ void PangoBasicApp::keyDown( KeyEvent event )
 				mPango->setTextAntialias( kp::pango::TextAntialias::SUBPIXEL );
 			}
 			break;
+		case KeyEvent::KEY_q:
+			// Cycle the quality presets: crisp, smooth, preview
+			if( mPango->getTextQuality() == kp::pango::TextQuality::crisp() ) {
+				mPango->setTextQuality( kp::pango::TextQuality::smooth() );
+			} else if( mPango->getTextQuality() == kp::pango::TextQuality::smooth() ) {
+				mPango->setTextQuality( kp::pango::TextQuality::preview() );
+			} else {
+				mPango->setTextQuality( kp::pango::TextQuality::crisp() );
+			}
+			break;
 		case KeyEvent::KEY_UP:
 			mPango->setSpacing( mPango->getSpacing() + 1.0 );
 			break;
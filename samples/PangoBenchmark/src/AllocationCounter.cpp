@@ -0,0 +1,191 @@
+// AllocationCounter.cpp
+// Cinder-Pango
+//
+
+#include "AllocationCounter.h"
+#include "CinderPangoCore.h"
+#include "CinderPangoTrace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace kp::pango;
+
+namespace {
+
+std::atomic<bool> sCounting( false );
+std::atomic<size_t> sAllocations( 0 );
+
+void* allocate( size_t size )
+{
+	if( sCounting.load( std::memory_order_relaxed ) ) {
+		sAllocations.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	void *pointer = std::malloc( size ? size : 1 );
+	if( ! pointer ) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+} // anonymous namespace
+
+void* operator new( size_t size )
+{
+	return allocate( size );
+}
+
+void* operator new[]( size_t size )
+{
+	return allocate( size );
+}
+
+void* operator new( size_t size, const std::nothrow_t & ) noexcept
+{
+	try {
+		return allocate( size );
+	} catch( ... ) {
+		return nullptr;
+	}
+}
+
+void* operator new[]( size_t size, const std::nothrow_t & ) noexcept
+{
+	try {
+		return allocate( size );
+	} catch( ... ) {
+		return nullptr;
+	}
+}
+
+void operator delete( void *pointer ) noexcept
+{
+	std::free( pointer );
+}
+
+void operator delete[]( void *pointer ) noexcept
+{
+	std::free( pointer );
+}
+
+void operator delete( void *pointer, size_t ) noexcept
+{
+	std::free( pointer );
+}
+
+void operator delete[]( void *pointer, size_t ) noexcept
+{
+	std::free( pointer );
+}
+
+void AllocationCounter::start()
+{
+	sAllocations.store( 0 );
+	sCounting.store( true );
+}
+
+size_t AllocationCounter::stop()
+{
+	sCounting.store( false );
+	return sAllocations.load();
+}
+
+namespace {
+
+struct AllocationCase {
+	std::string name;
+	std::function<void( CinderPangoCore & )> setup;
+	std::function<void( CinderPangoCore &, int )> frame;
+};
+
+// Alternates between a and b, which have the same length so the rendered size doesn't change
+std::function<void( CinderPangoCore &, int )> alternateText( const std::string &a, const std::string &b )
+{
+	return [=]( CinderPangoCore &pango, int frame ) {
+		pango.setText( ( frame % 2 ) ? a : b );
+		pango.render();
+	};
+}
+
+std::vector<AllocationCase> createAllocationCases()
+{
+	std::vector<AllocationCase> cases;
+
+	auto defaults = []( CinderPangoCore &pango ) {
+		pango.setMaxSize( 400, 200 );
+		pango.setMinSize( 400, 200 );
+		pango.setDefaultTextSize( 18.0f );
+	};
+
+	cases.push_back( { "plain text", defaults, alternateText( "Score: 0001234 points", "Score: 0005678 points" ) } );
+	cases.push_back( { "markup text", defaults, alternateText( "<b>Score</b><br><i>0001234</i>", "<b>Score</b><br><i>0005678</i>" ) } );
+
+	cases.push_back( { "forced render", defaults, []( CinderPangoCore &pango, int ) {
+		pango.setText( "The quick brown fox jumps over the lazy dog" );
+		pango.render( true );
+	} } );
+
+	// Built once, copying them into the instance reuses its span storage
+	TextAttributes first;
+	TextAttributes second;
+	for( size_t i = 0; i < 8; i++ ) {
+		first.color( i * 6, i * 6 + 5, ( i == 2 ) ? ci::ColorA( 1, 0, 0, 1 ) : ci::ColorA( 0, 0, 0, 1 ) );
+		second.color( i * 6, i * 6 + 5, ( i == 5 ) ? ci::ColorA( 1, 0, 0, 1 ) : ci::ColorA( 0, 0, 0, 1 ) );
+	}
+	cases.push_back( { "recolor",
+		[=]( CinderPangoCore &pango ) {
+			defaults( pango );
+			pango.setText( "word0 word1 word2 word3 word4 word5 word6 word7" );
+		},
+		[=]( CinderPangoCore &pango, int frame ) {
+			pango.setTextAttributes( ( frame % 2 ) ? first : second );
+			pango.render();
+		} } );
+
+	cases.push_back( { "stats and tracing",
+		[=]( CinderPangoCore &pango ) {
+			defaults( pango );
+			pango.setStatsEnabled( true );
+			Trace::setEnabled( true );
+		},
+		alternateText( "Score: 0001234 points", "Score: 0005678 points" ) } );
+
+	return cases;
+}
+
+} // anonymous namespace
+
+int runAllocationCheck( int renders )
+{
+	int failures = 0;
+
+	for( const AllocationCase &allocationCase : createAllocationCases() ) {
+		CinderPangoCoreRef pango = CinderPangoCore::create();
+		allocationCase.setup( *pango );
+
+		// Warm up: surfaces, scratch buffers and string capacities reach their steady state size
+		for( int frame = 0; frame < 16; frame++ ) {
+			allocationCase.frame( *pango, frame );
+		}
+
+		AllocationCounter::start();
+		for( int frame = 0; frame < renders; frame++ ) {
+			allocationCase.frame( *pango, frame );
+		}
+		const size_t allocations = AllocationCounter::stop();
+
+		Trace::setEnabled( false );
+		std::printf( "%s %-24s %zu allocations in %d renders\n", allocations ? "FAIL" : "ok  ", allocationCase.name.c_str(), allocations, renders );
+		if( allocations ) {
+			failures++;
+		}
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+// AllocationCounter.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <cstddef>
+
+// Counts calls to the global operator new while counting is on. PangoBenchmark replaces the global allocator
+// for this (see AllocationCounter.cpp); GLib, Pango and Cairo allocate with malloc and aren't counted.
+class AllocationCounter {
+  public:
+	static void start();
+	static size_t stop(); // returns the number of allocations since start
+};
+
+// Runs steady state render loops and fails if any of them allocate. Returns the process exit code.
+int runAllocationCheck( int renders );
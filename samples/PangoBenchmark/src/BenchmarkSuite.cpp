@@ -0,0 +1,123 @@
+// BenchmarkSuite.cpp
+// Cinder-Pango
+//
+
+#include "BenchmarkSuite.h"
+
+#include <cairo.h>
+#include <pango/pango.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+double percentile( std::vector<double> &sorted, double percentile )
+{
+	const size_t rank = std::min( static_cast<size_t>( percentile / 100.0 * sorted.size() ), sorted.size() - 1 );
+	return sorted[ rank ];
+}
+
+void writeJsonString( FILE *file, const std::string &value )
+{
+	std::fputc( '"', file );
+	for( char c : value ) {
+		switch( c ) {
+			case '"':
+				std::fputs( "\\\"", file );
+				break;
+			case '\\':
+				std::fputs( "\\\\", file );
+				break;
+			case '\n':
+				std::fputs( "\\n", file );
+				break;
+			default:
+				if( static_cast<unsigned char>( c ) < 0x20 ) {
+					std::fprintf( file, "\\u%04x", c );
+				} else {
+					std::fputc( c, file );
+				}
+				break;
+		}
+	}
+	std::fputc( '"', file );
+}
+
+} // anonymous namespace
+
+BenchmarkSuite::BenchmarkSuite( int iterations, const std::string &filter ) :
+	mIterations( std::max( iterations, 1 ) ),
+	mFilter( filter ),
+	mLog( stdout )
+{
+}
+
+bool BenchmarkSuite::isSelected( const std::string &name ) const
+{
+	return mFilter.empty() || ( name.find( mFilter ) != std::string::npos );
+}
+
+BenchmarkResult* BenchmarkSuite::run( const std::string &name, const std::function<void( int )> &fn )
+{
+	if( ! isSelected( name ) ) {
+		return nullptr;
+	}
+
+	fn( 0 );
+
+	mSamples.resize( mIterations );
+	for( int i = 0; i < mIterations; i++ ) {
+		const auto startTime = std::chrono::steady_clock::now();
+		fn( i + 1 );
+		mSamples[ i ] = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - startTime ).count();
+	}
+
+	BenchmarkResult result;
+	result.name = name;
+	result.iterations = mIterations;
+	for( double sample : mSamples ) {
+		result.meanMicroseconds += sample;
+	}
+	result.meanMicroseconds /= mIterations;
+
+	std::sort( mSamples.begin(), mSamples.end() );
+	result.minMicroseconds = mSamples.front();
+	result.p50Microseconds = percentile( mSamples, 50.0 );
+	result.p99Microseconds = percentile( mSamples, 99.0 );
+
+	std::fprintf( mLog, "%-44s %10.2f us/iter  (p50 %9.2f, p99 %9.2f)\n", name.c_str(), result.meanMicroseconds, result.p50Microseconds, result.p99Microseconds );
+
+	mResults.push_back( result );
+	return &mResults.back();
+}
+
+void BenchmarkSuite::writeJson( FILE *file ) const
+{
+	std::fprintf( file, "{\n  \"iterations\": %d,\n  \"pango_version\": ", mIterations );
+	writeJsonString( file, pango_version_string() );
+	std::fputs( ",\n  \"cairo_version\": ", file );
+	writeJsonString( file, cairo_version_string() );
+	std::fputs( ",\n  \"results\": [", file );
+
+	for( size_t i = 0; i < mResults.size(); i++ ) {
+		const BenchmarkResult &result = mResults[ i ];
+		std::fputs( ( i == 0 ) ? "\n    { \"name\": " : ",\n    { \"name\": ", file );
+		writeJsonString( file, result.name );
+		std::fprintf( file, ", \"iterations\": %d, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"min_us\": %.3f", result.iterations,
+			result.meanMicroseconds, result.p50Microseconds, result.p99Microseconds, result.minMicroseconds );
+
+		if( ! result.metrics.empty() ) {
+			std::fputs( ", \"metrics\": {", file );
+			for( size_t m = 0; m < result.metrics.size(); m++ ) {
+				std::fputs( ( m == 0 ) ? " " : ", ", file );
+				writeJsonString( file, result.metrics[ m ].first );
+				std::fprintf( file, ": %.3f", result.metrics[ m ].second );
+			}
+			std::fputs( " }", file );
+		}
+		std::fputs( " }", file );
+	}
+
+	std::fputs( "\n  ]\n}\n", file );
+}
@@ -0,0 +1,50 @@
+// BenchmarkSuite.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchmarkResult {
+	std::string name; // slash separated, e.g. "latin/layout", stable across runs so results can be compared
+	int iterations = 0;
+	double meanMicroseconds = 0.0;
+	double p50Microseconds = 0.0;
+	double p99Microseconds = 0.0;
+	double minMicroseconds = 0.0;
+	std::vector<std::pair<std::string, double>> metrics; // extra numbers a case wants to report
+};
+
+// Runs cases, keeps their per-iteration timings, prints a table as it goes and writes everything out as JSON.
+class BenchmarkSuite {
+  public:
+	BenchmarkSuite( int iterations, const std::string &filter = "" );
+
+	int getIterations() const { return mIterations; }
+
+	// Human readable output, stdout by default
+	void setLog( FILE *log ) { mLog = log; }
+	FILE* getLog() const { return mLog; }
+
+	// Cases whose name doesn't contain the filter are skipped
+	bool isSelected( const std::string &name ) const;
+
+	// Runs fn once untimed (so font loading doesn't land in the first case), then times each of the iterations.
+	// fn gets the iteration number, starting at 1. Returns null if the case was filtered out.
+	BenchmarkResult* run( const std::string &name, const std::function<void( int )> &fn );
+
+	const std::vector<BenchmarkResult>& getResults() const { return mResults; }
+	void writeJson( FILE *file ) const;
+
+  private:
+	int mIterations;
+	std::string mFilter;
+	FILE *mLog;
+	std::vector<BenchmarkResult> mResults;
+	std::vector<double> mSamples;
+};
@@ -0,0 +1,91 @@
+// Corpora.cpp
+// Cinder-Pango
+//
+
+#include "Corpora.h"
+
+namespace {
+
+std::string repeat( const std::string &paragraph, int count )
+{
+	std::string text;
+	for( int i = 0; i < count; i++ ) {
+		text += paragraph;
+		text += ( i + 1 < count ) ? "\n" : "";
+	}
+	return text;
+}
+
+std::string createHeavyMarkup()
+{
+	// Every word in its own span, nested, with the attribute kinds Pango's markup parser has to convert
+	const char *colors[] = { "red", "#00AA00", "blue", "#333333" };
+	const char *fonts[] = { "Sans 14", "Serif Italic 18", "Monospace 12", "Sans Bold 24" };
+
+	std::string text;
+	for( int i = 0; i < 160; i++ ) {
+		const std::string index = std::to_string( i );
+		switch( i % 5 ) {
+			case 0:
+				text += "<b>bold" + index + "</b> ";
+				break;
+			case 1:
+				text += "<span foreground=\"" + std::string( colors[ i % 4 ] ) + "\">colored " + index + "</span> ";
+				break;
+			case 2:
+				text += "<span font=\"" + std::string( fonts[ i % 4 ] ) + "\"><i>font" + index + "</i></span> ";
+				break;
+			case 3:
+				text += "<span underline=\"single\" letter_spacing=\"512\" background=\"#FFFF00\">spaced &amp; " + index + "</span> ";
+				break;
+			default:
+				text += "<span size=\"larger\"><u>nested <s>" + index + "</s> <sup>2</sup></u></span><br>";
+				break;
+		}
+	}
+	return text;
+}
+
+} // anonymous namespace
+
+const std::vector<Corpus>& getCorpora()
+{
+	static const std::vector<Corpus> sCorpora = {
+		{ "latin",
+			repeat( "It was the best of times, it was the worst of times, it was the age of wisdom, it was the age of foolishness, it was the "
+					"epoch of belief, it was the epoch of incredulity, it was the season of Light, it was the season of Darkness, it was the "
+					"spring of hope, it was the winter of despair, we had everything before us, we had nothing before us.",
+				4 ),
+			false },
+		{ "cjk",
+			repeat( "中文是世界上使用人数最多的语言之一，汉字是一种表意文字，已有数千年的历史。"
+					"日本語は主に日本で使われる言語であり、漢字と平仮名と片仮名を組み合わせて書かれる。"
+					"한국어는 한글로 표기하며, 한글은 십오 세기에 창제된 음소 문자이다. ",
+				6 ),
+			false },
+		{ "hebrew",
+			repeat( "עברית היא שפה שמית ממשפחת השפות האפרו-אסיאתיות. היא השפה הרשמית של מדינת ישראל, ונכתבת מימין לשמאל "
+					"באלפבית בן עשרים ושתיים אותיות, לעיתים עם ניקוד: שָׁלוֹם עֲלֵיכֶם.",
+				5 ),
+			false },
+		{ "arabic",
+			repeat( "اللغة العربية هي أكثر اللغات السامية تحدثاً، وإحدى أكثر اللغات انتشاراً في العالم، يتحدثها أكثر من "
+					"أربعمئة مليون نسمة. تُكتب من اليمين إلى اليسار، وتتغير أشكال الحروف بحسب موقعها في الكلمة.",
+				5 ),
+			false },
+		{ "markup", createHeavyMarkup(), true },
+		// The sample string from PangoBasicApp
+		{ "mixed",
+			"<b>Bold Text中国话不用彁字。</b> "
+			"<span foreground=\"green\" font=\"24.0\">Green téxt</span> "
+			"<span foreground=\"red\" font=\"Times 48.0\">Red text</span> "
+			"<span foreground=\"blue\" font=\"Sans 72.0\">中国话不用彁字Я не говорю по-русски. AVAVAVA Blue text</span> "
+			"<i>Italic Text</i> "
+			"hovedgruppen fra <i>forskjellige</i> destinasjoner. Tilknytningsbillett er gyldig inntil 24 timer f√∏r avreise hovedgruppe.\n\nUnicef said 3m "
+			"people had been affected and more than <span font=\"33.0\">1,400</span> had been killed. <b>The government</b> said some 27,000 people remained "
+			"trapped "
+			"and awaiting help. ﬠﬡﬢﬣﬤﬥﬦﬧﬨ﬩שׁשׂשּׁשּׂאַאָאּבּגּדּמּנּסּףּפּצּקּרּשּתּוֹבֿכֿפֿﭏ",
+			true },
+	};
+	return sCorpora;
+}
@@ -0,0 +1,17 @@
+// Corpora.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Fixed texts the suite runs every stage against. They never change between runs, so results stay comparable.
+struct Corpus {
+	std::string name;
+	std::string text;
+	bool markup; // parsed with pango_parse_markup, otherwise set as plain text
+};
+
+const std::vector<Corpus>& getCorpora();
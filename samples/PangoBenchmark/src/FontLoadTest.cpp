@@ -0,0 +1,86 @@
+// FontLoadTest.cpp
+// Cinder-Pango
+//
+
+#include "FontLoadTest.h"
+#include "CinderPangoCore.h"
+#include "CinderPangoFallback.h"
+#include "CinderPangoFontPack.h"
+
+#include <fontconfig/fontconfig.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace kp::pango;
+
+int runFontLoadTest( const std::string &path, const std::string &source )
+{
+	if( ( source != "file" ) && ( source != "memory" ) && ( source != "mapped" ) ) {
+		std::fprintf( stderr, "Unknown font source %s, expected file, memory or mapped\n", source.c_str() );
+		return 1;
+	}
+
+	// What the app would already know, outside the timing
+	std::string family;
+	if( source == "file" ) {
+		int count = 0;
+		if( FcPattern *pattern = FcFreeTypeQuery( reinterpret_cast<const FcChar8 *>( path.c_str() ), 0, nullptr, &count ) ) {
+			FcChar8 *name = nullptr;
+			if( FcPatternGetString( pattern, FC_FAMILY, 0, &name ) == FcResultMatch ) {
+				family = reinterpret_cast<const char *>( name );
+			}
+			FcPatternDestroy( pattern );
+		}
+	}
+
+	// Stands in for a font that was just decompressed out of an asset pack
+	std::vector<unsigned char> data;
+	if( source == "memory" ) {
+		std::ifstream file( path, std::ios::binary );
+		data.assign( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	if( source == "file" ) {
+		CinderPangoCore::loadFont( path );
+	} else {
+		const std::vector<std::string> families = ( source == "memory" ) ? FontPack::loadFont( std::move( data ), path ) : FontPack::loadMapped( path );
+		if( ! families.empty() ) {
+			family = families.front();
+		}
+	}
+
+	const auto registeredTime = std::chrono::steady_clock::now();
+
+	if( family.empty() ) {
+		std::fprintf( stderr, "Could not load a font from %s\n", path.c_str() );
+		return 1;
+	}
+
+	CinderPangoCoreRef pango = CinderPangoCore::create();
+	pango->setMaxSize( 800, 200 );
+	pango->setDefaultTextFont( family );
+	pango->setDefaultTextSize( 24.0f );
+	pango->setText( "The quick brown fox jumps over the lazy dog" );
+	pango->render();
+
+	const auto renderedTime = std::chrono::steady_clock::now();
+
+	const double registerMilliseconds = std::chrono::duration<double, std::milli>( registeredTime - startTime ).count();
+	const double renderMilliseconds = std::chrono::duration<double, std::milli>( renderedTime - registeredTime ).count();
+	std::printf( "%-8s %-32s registered %8.2f ms, first render %8.2f ms, total %8.2f ms\n", source.c_str(), family.c_str(), registerMilliseconds,
+		renderMilliseconds, registerMilliseconds + renderMilliseconds );
+
+	// A substitute would make the timings meaningless
+	if( ! FontFallback::getCoverage( family, "Aa" ).familyAvailable ) {
+		std::fprintf( stderr, "%s was registered but fontconfig matches another family for it\n", family.c_str() );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,12 @@
+// FontLoadTest.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <string>
+
+// Time from registering a font to the first render with it, loaded from its file with loadFont, from memory or from a
+// mapped file with FontPack. Fonts stay registered for the life of the process, so compare sources in separate runs.
+// Returns the process exit code.
+int runFontLoadTest( const std::string &path, const std::string &source );
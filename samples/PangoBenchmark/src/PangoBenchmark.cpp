@@ -0,0 +1,479 @@
+// PangoBenchmark.cpp
+// Headless benchmarks for Cinder-Pango. Built on CinderPangoCore and the cinder-pango-core library,
+// so neither Cinder nor a window or GL context is needed.
+
+#include "AllocationCounter.h"
+#include "BenchmarkSuite.h"
+#include "CinderPangoCore.h"
+#include "CinderPangoVariations.h"
+#include "CinderPangoWarmUp.h"
+#include "Corpora.h"
+#include "FontLoadTest.h"
+#include "RegressionGate.h"
+#include "SoakTest.h"
+
+#include <glib.h>
+#include <pango/pangocairo.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <regex>
+#include <string>
+#include <vector>
+
+using namespace kp::pango;
+
+namespace {
+
+// Styling a list of words one span per word, once as generated markup and once as typed attributes
+void benchmarkAttributesVersusMarkup( BenchmarkSuite &suite )
+{
+	std::vector<std::string> words;
+	for( int i = 0; i < 64; i++ ) {
+		words.push_back( "word" + std::to_string( i ) + "&<>" );
+	}
+
+	CinderPangoCoreRef markupPango = CinderPangoCore::create();
+	markupPango->setMaxSize( 800, 600 );
+
+	suite.run( "spans/markup", [&]( int iteration ) {
+		std::string markup;
+		for( size_t i = 0; i < words.size(); i++ ) {
+			// The highlighted word changes every iteration so there's always something to parse
+			const char *color = ( i == iteration % words.size() ) ? "#FF0000" : "#000000";
+			gchar *escaped = g_markup_escape_text( words[ i ].c_str(), -1 );
+			markup += "<span foreground=\"" + std::string( color ) + "\" weight=\"bold\" letter_spacing=\"1024\">" + escaped + "</span> ";
+			g_free( escaped );
+		}
+		markupPango->setText( markup );
+		markupPango->measure();
+	} );
+
+	CinderPangoCoreRef attributePango = CinderPangoCore::create();
+	attributePango->setMaxSize( 800, 600 );
+
+	std::string text;
+	for( const auto &word : words ) {
+		text += word + " ";
+	}
+	attributePango->setText( text );
+
+	suite.run( "spans/attributes", [&]( int iteration ) {
+		TextAttributes attributes;
+		size_t start = 0;
+		for( size_t i = 0; i < words.size(); i++ ) {
+			const size_t end = start + words[ i ].size();
+			const ci::ColorA color = ( i == iteration % words.size() ) ? ci::ColorA( 1, 0, 0, 1 ) : ci::ColorA( 0, 0, 0, 1 );
+			attributes.color( start, end, color ).weight( start, end, TextWeight::BOLD ).letterSpacing( start, end, 1.0f );
+			start = end + 1;
+		}
+		attributePango->setTextAttributes( attributes );
+		attributePango->measure();
+	} );
+}
+
+// Moving a highlight between words, with the layout kept (color-only change) versus forced to relayout
+void benchmarkRecolor( BenchmarkSuite &suite )
+{
+	std::vector<size_t> wordStarts;
+	std::string text;
+	for( int i = 0; i < 64; i++ ) {
+		wordStarts.push_back( text.size() );
+		text += "word" + std::to_string( i ) + " ";
+	}
+
+	auto highlight = [&]( size_t word, float letterSpacing ) {
+		TextAttributes attributes;
+		for( size_t i = 0; i < wordStarts.size(); i++ ) {
+			const size_t end = ( i + 1 < wordStarts.size() ) ? wordStarts[ i + 1 ] - 1 : text.size() - 1;
+			attributes.color( wordStarts[ i ], end, ( i == word ) ? ci::ColorA( 1, 0, 0, 1 ) : ci::ColorA( 0, 0, 0, 1 ) );
+		}
+		attributes.letterSpacing( 0, text.size(), letterSpacing );
+		return attributes;
+	};
+
+	CinderPangoCoreRef pango = CinderPangoCore::create();
+	pango->setMaxSize( 800, 600 );
+	pango->setText( text );
+
+	suite.run( "recolor/color-only", [&]( int iteration ) {
+		pango->setTextAttributes( highlight( iteration % wordStarts.size(), 0.0f ) );
+		pango->render();
+	} );
+
+	suite.run( "recolor/relayout", [&]( int iteration ) {
+		// Alternating the letter spacing makes every update a metric change
+		pango->setTextAttributes( highlight( iteration % wordStarts.size(), ( iteration % 2 ) ? 0.0f : 0.01f ) );
+		pango->render();
+	} );
+}
+
+// The per-render preprocessing CinderPangoCore used before MarkupPreprocessor, kept here for comparison
+bool regexPreprocess( const std::string &text, std::string &processedText )
+{
+	std::regex e( "<br\\s?/?>", std::regex_constants::icase );
+	processedText = std::regex_replace( text, e, "\n" );
+	return ( ( processedText.find( "<" ) != std::string::npos ) && ( processedText.find( ">" ) != std::string::npos ) );
+}
+
+void benchmarkPreprocessor( BenchmarkSuite &suite )
+{
+	const std::vector<std::pair<std::string, std::string>> cases = {
+		{ "plain", "The quick brown fox jumps over the lazy dog. Frame " },
+		{ "breaks", "First line<br>Second line<BR/>Third line<br />Fourth line, frame " },
+		{ "markup", "<b>Bold</b> <span foreground=\"green\" font=\"24.0\">Green text</span><br><i>Italic</i> &amp; frame " },
+	};
+
+	MarkupPreprocessorRef preprocessor = MarkupPreprocessor::create();
+	std::string output;
+	std::string text;
+
+	for( const auto &entry : cases ) {
+		// Frame counter suffix, like PangoBasic, so the text is different every time
+		suite.run( "preprocess/" + entry.first + "/regex", [&]( int iteration ) {
+			text = entry.second + std::to_string( iteration );
+			regexPreprocess( text, output );
+		} );
+
+		suite.run( "preprocess/" + entry.first + "/scanner", [&]( int iteration ) {
+			text = entry.second + std::to_string( iteration );
+			preprocessor->process( text, output );
+		} );
+	}
+}
+
+// Each corpus through the stages of a render with raw Pango, then through the whole CinderPangoCore pipeline
+void benchmarkCorpora( BenchmarkSuite &suite )
+{
+	const int width = 800;
+
+	PangoFontMap *fontMap = pango_cairo_font_map_new();
+	PangoContext *context = pango_font_map_create_context( fontMap );
+	PangoFontDescription *fontDescription = pango_font_description_from_string( "Sans 18" );
+	MarkupPreprocessorRef preprocessor = MarkupPreprocessor::getDefault();
+
+	for( const Corpus &corpus : getCorpora() ) {
+		std::string processedText;
+
+		// Line break preprocessing and markup parsing, what happens before anything is handed to the layout
+		suite.run( corpus.name + "/parse", [&]( int ) {
+			preprocessor->process( corpus.text, processedText );
+			if( corpus.markup ) {
+				PangoAttrList *attributes = nullptr;
+				char *text = nullptr;
+				GError *error = nullptr;
+				if( pango_parse_markup( processedText.c_str(), -1, 0, &attributes, &text, nullptr, &error ) ) {
+					pango_attr_list_unref( attributes );
+					g_free( text );
+				} else {
+					g_error_free( error );
+				}
+			}
+		} );
+
+		preprocessor->process( corpus.text, processedText );
+		PangoLayout *layout = pango_layout_new( context );
+		pango_layout_set_font_description( layout, fontDescription );
+		pango_layout_set_width( layout, width * PANGO_SCALE );
+		pango_layout_set_wrap( layout, PANGO_WRAP_WORD_CHAR );
+		if( corpus.markup ) {
+			pango_layout_set_markup( layout, processedText.c_str(), -1 );
+		} else {
+			pango_layout_set_text( layout, processedText.c_str(), -1 );
+		}
+
+		// Itemization, shaping and line breaking, with the text and attributes already set
+		suite.run( corpus.name + "/layout", [&]( int ) {
+			pango_layout_context_changed( layout );
+			PangoRectangle inkRect, logicalRect;
+			pango_layout_get_pixel_extents( layout, &inkRect, &logicalRect );
+		} );
+
+		int pixelWidth, pixelHeight;
+		pango_layout_get_pixel_size( layout, &pixelWidth, &pixelHeight );
+		cairo_surface_t *surface = cairo_image_surface_create( CAIRO_FORMAT_ARGB32, std::max( pixelWidth, 1 ), std::max( pixelHeight, 1 ) );
+		cairo_t *cairoContext = cairo_create( surface );
+		pango_cairo_update_layout( cairoContext, layout );
+
+		// Clearing the surface and drawing the laid out glyphs
+		BenchmarkResult *raster = suite.run( corpus.name + "/raster", [&]( int ) {
+			cairo_save( cairoContext );
+			cairo_set_operator( cairoContext, CAIRO_OPERATOR_CLEAR );
+			cairo_paint( cairoContext );
+			cairo_restore( cairoContext );
+			cairo_set_source_rgba( cairoContext, 0.0, 0.0, 0.0, 1.0 );
+			cairo_move_to( cairoContext, 0.0, 0.0 );
+			pango_cairo_show_layout( cairoContext, layout );
+			cairo_surface_flush( surface );
+		} );
+		if( raster ) {
+			raster->metrics.push_back( { "pixels", static_cast<double>( pixelWidth ) * pixelHeight } );
+		}
+
+		cairo_destroy( cairoContext );
+		cairo_surface_destroy( surface );
+		g_object_unref( layout );
+
+		// Everything together, new text every frame like PangoBasic
+		CinderPangoCoreRef pango = CinderPangoCore::create();
+		pango->setMaxSize( width, 4096 );
+		pango->setDefaultTextSize( 18.0f );
+		pango->setText( corpus.text );
+		pango->render();
+		pango->setStatsEnabled( true );
+
+		BenchmarkResult *pipeline = suite.run( corpus.name + "/pipeline", [&]( int iteration ) {
+			pango->setText( corpus.text + std::to_string( iteration ) );
+			pango->render();
+		} );
+		if( pipeline ) {
+			const RenderStatsHistory *stats = pango->getStats();
+			for( int stage = 0; stage < static_cast<int>( RenderStage::COUNT ); stage++ ) {
+				const RenderStage renderStage = static_cast<RenderStage>( stage );
+				pipeline->metrics.push_back( { std::string( "p50_" ) + getRenderStageName( renderStage ) + "_us", stats->getP50( renderStage ) * 1e6 } );
+			}
+		}
+	}
+
+	pango_font_description_free( fontDescription );
+	g_object_unref( context );
+	g_object_unref( fontMap );
+}
+
+// First render of the mixed script corpus' text at a size nothing has drawn yet, as is and after warmUp() for that size. Every
+// iteration moves to a new size, so Cairo's glyph caches never have it already. The warmed case times warmUp() and
+// render() together and reports the render alone in its metrics.
+void benchmarkWarmUp( BenchmarkSuite &suite )
+{
+	const auto &corpora = getCorpora();
+	const auto mixed = std::find_if( corpora.begin(), corpora.end(), []( const Corpus &corpus ) { return corpus.name == "mixed"; } );
+	if( mixed == corpora.end() ) {
+		return;
+	}
+
+	// Without the markup, whose spans have fixed sizes, so every glyph is drawn at the new size
+	std::string text;
+	char *plainText = nullptr;
+	if( pango_parse_markup( mixed->text.c_str(), -1, 0, nullptr, &plainText, nullptr, nullptr ) ) {
+		text = plainText;
+		g_free( plainText );
+	}
+
+	float nextSize = 20.0f;
+	auto render = [&]( float size ) {
+		CinderPangoCoreRef pango = CinderPangoCore::create();
+		pango->setMaxSize( 800, 4096 );
+		pango->setDefaultTextSize( size );
+		pango->setText( text );
+		pango->render();
+	};
+
+	suite.run( "warmup/cold", [&]( int ) {
+		render( nextSize );
+		nextSize += 0.01f;
+	} );
+
+	double renderMicroseconds = 0.0;
+	int renders = 0;
+	BenchmarkResult *warmed = suite.run( "warmup/warmed", [&]( int ) {
+		WarmUpRequest request;
+		request.sizes = { nextSize };
+		request.characters = text;
+		FontWarmUp::warmUp( { request } );
+
+		const auto startTime = std::chrono::steady_clock::now();
+		render( nextSize );
+		renderMicroseconds += std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - startTime ).count();
+		renders++;
+		nextSize += 0.01f;
+	} );
+	if( warmed ) {
+		warmed->metrics.push_back( { "render_mean_us", renderMicroseconds / renders } );
+	}
+}
+
+// Raster cost per quality preset: redrawing a laid out text with every glyph cached (a color change), and drawing at a
+// size nothing has drawn yet, which rasterizes every glyph again
+void benchmarkQuality( BenchmarkSuite &suite )
+{
+	const auto &corpora = getCorpora();
+	const auto mixed = std::find_if( corpora.begin(), corpora.end(), []( const Corpus &corpus ) { return corpus.name == "mixed"; } );
+	if( mixed == corpora.end() ) {
+		return;
+	}
+
+	std::string text;
+	char *plainText = nullptr;
+	if( pango_parse_markup( mixed->text.c_str(), -1, 0, nullptr, &plainText, nullptr, nullptr ) ) {
+		text = plainText;
+		g_free( plainText );
+	}
+
+	const std::pair<const char *, TextQuality> presets[] = {
+		{ "crisp", TextQuality::crisp() },
+		{ "smooth", TextQuality::smooth() },
+		{ "preview", TextQuality::preview() },
+	};
+
+	float nextSize = 40.0f;
+	for( const auto &preset : presets ) {
+		CinderPangoCoreRef pango = CinderPangoCore::create();
+		pango->setMaxSize( 800, 4096 );
+		pango->setTextQuality( preset.second );
+		pango->setText( text );
+		pango->render();
+
+		suite.run( std::string( "quality/" ) + preset.first + "/raster", [&]( int iteration ) {
+			pango->setDefaultTextColor( ( iteration % 2 ) ? ci::ColorA::black() : ci::ColorA::white() );
+			pango->render();
+		} );
+
+		suite.run( std::string( "quality/" ) + preset.first + "/cold", [&]( int ) {
+			pango->setDefaultTextSize( nextSize );
+			pango->render();
+			nextSize += 0.01f;
+		} );
+	}
+}
+
+// Animating the weight of a variable font, one instance per step once each step has been seen. Skipped when none of
+// the candidate families is installed as a variable font with a wght axis.
+void benchmarkVariations( BenchmarkSuite &suite )
+{
+	std::string family;
+	for( const char *candidate : { "Roboto Flex", "Inter", "Noto Sans", "Source Sans 3", "Cantarell" } ) {
+		for( const FontAxis &axis : FontVariations::getAxes( candidate ) ) {
+			if( ( axis.tag == "wght" ) && family.empty() ) {
+				family = candidate;
+			}
+		}
+	}
+	if( family.empty() ) {
+		std::fprintf( stderr, "No variable font with a wght axis installed, skipping variations/animate_wght\n" );
+		return;
+	}
+
+	CinderPangoCoreRef pango = CinderPangoCore::create();
+	pango->setMaxSize( 800, 600 );
+	pango->setDefaultTextFont( family );
+	pango->setDefaultTextSize( 24.0f );
+	pango->setText( "The quick brown fox jumps over the lazy dog" );
+
+	// A sweep up and down the axis, a bit less than one unit per frame
+	const size_t instancesBefore = FontVariations::getInstanceCount();
+	BenchmarkResult *result = suite.run( "variations/animate_wght", [&]( int iteration ) {
+		const int phase = ( iteration * 7 / 8 ) % 1000;
+		pango->setDefaultTextAxis( "wght", 400.0f + static_cast<float>( ( phase < 500 ) ? phase : 1000 - phase ) );
+		pango->render();
+	} );
+	if( result ) {
+		result->metrics.push_back( { "instances_created", static_cast<double>( FontVariations::getInstanceCount() - instancesBefore ) } );
+	}
+}
+
+void printUsage( const char *executable )
+{
+	std::fprintf( stderr,
+		"Usage: %s [iterations] [--filter <substring>] [--json <file, - for stdout>]\n"
+		"       %s --regress <directory> [--update] [iterations] [--filter <substring>] [--threshold <fraction>] [--tolerance <0-255>]\n"
+		"       %s --allocations [renders]\n"
+		"       %s --soak [instances]\n"
+		"       %s --font-load <font file> [--source <file|memory|mapped>]\n",
+		executable, executable, executable, executable, executable );
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	int iterations = 0;
+	std::string filter;
+	std::string jsonPath;
+	RegressionOptions regression;
+	bool allocationCheck = false;
+	bool soakTest = false;
+	std::string fontLoadPath;
+	std::string fontLoadSource = "file";
+
+	for( int i = 1; i < argc; i++ ) {
+		if( ( std::strcmp( argv[ i ], "--filter" ) == 0 ) && ( i + 1 < argc ) ) {
+			filter = argv[ ++i ];
+		} else if( ( std::strcmp( argv[ i ], "--json" ) == 0 ) && ( i + 1 < argc ) ) {
+			jsonPath = argv[ ++i ];
+		} else if( ( std::strcmp( argv[ i ], "--regress" ) == 0 ) && ( i + 1 < argc ) ) {
+			regression.directory = argv[ ++i ];
+		} else if( std::strcmp( argv[ i ], "--allocations" ) == 0 ) {
+			allocationCheck = true;
+		} else if( std::strcmp( argv[ i ], "--soak" ) == 0 ) {
+			soakTest = true;
+		} else if( ( std::strcmp( argv[ i ], "--font-load" ) == 0 ) && ( i + 1 < argc ) ) {
+			fontLoadPath = argv[ ++i ];
+		} else if( ( std::strcmp( argv[ i ], "--source" ) == 0 ) && ( i + 1 < argc ) ) {
+			fontLoadSource = argv[ ++i ];
+		} else if( std::strcmp( argv[ i ], "--update" ) == 0 ) {
+			regression.update = true;
+		} else if( ( std::strcmp( argv[ i ], "--threshold" ) == 0 ) && ( i + 1 < argc ) ) {
+			regression.timingThreshold = std::atof( argv[ ++i ] );
+		} else if( ( std::strcmp( argv[ i ], "--tolerance" ) == 0 ) && ( i + 1 < argc ) ) {
+			regression.pixelTolerance = std::atoi( argv[ ++i ] );
+		} else if( std::atoi( argv[ i ] ) > 0 ) {
+			iterations = std::atoi( argv[ i ] );
+		} else {
+			printUsage( argv[ 0 ] );
+			return 1;
+		}
+	}
+
+	CinderPangoCore::setTextRenderer( TextRenderer::FREETYPE );
+
+	if( ! fontLoadPath.empty() ) {
+		return runFontLoadTest( fontLoadPath, fontLoadSource );
+	}
+
+	if( soakTest ) {
+		return runSoakTest( ( iterations > 0 ) ? iterations : 100000 );
+	}
+
+	if( allocationCheck ) {
+		return runAllocationCheck( ( iterations > 0 ) ? iterations : 1000 );
+	}
+
+	if( ! regression.directory.empty() ) {
+		regression.filter = filter;
+		if( iterations > 0 ) {
+			regression.iterations = iterations;
+		}
+		return runRegressionGate( regression );
+	}
+
+	BenchmarkSuite suite( ( iterations > 0 ) ? iterations : 1000, filter );
+	if( jsonPath == "-" ) {
+		// Keep stdout clean for the JSON
+		suite.setLog( stderr );
+	}
+
+	benchmarkCorpora( suite );
+	benchmarkAttributesVersusMarkup( suite );
+	benchmarkRecolor( suite );
+	benchmarkPreprocessor( suite );
+	benchmarkWarmUp( suite );
+	benchmarkQuality( suite );
+	benchmarkVariations( suite );
+
+	if( ! jsonPath.empty() ) {
+		FILE *file = ( jsonPath == "-" ) ? stdout : std::fopen( jsonPath.c_str(), "w" );
+		if( ! file ) {
+			std::fprintf( stderr, "Could not open %s for writing\n", jsonPath.c_str() );
+			return 1;
+		}
+		suite.writeJson( file );
+		if( file != stdout ) {
+			std::fclose( file );
+		}
+	}
+
+	return 0;
+}
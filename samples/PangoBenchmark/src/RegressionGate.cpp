@@ -0,0 +1,464 @@
+// RegressionGate.cpp
+// Cinder-Pango
+//
+
+#include "RegressionGate.h"
+#include "BenchmarkSuite.h"
+#include "CinderPangoCore.h"
+#include "Corpora.h"
+
+#include <cairo.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using namespace kp::pango;
+
+namespace {
+
+struct RegressionCase {
+	std::string name;
+	std::string text;
+	float size;
+	ci::ivec2 maxSize;
+	TextAlignment alignment;
+	TextWeight weight;
+	bool italics;
+	float spacing;
+	ci::ColorA backgroundColor;
+};
+
+// Pixels copied out of a render, top row first (surfaces are flipped for GL by default)
+struct Image {
+	int width = 0;
+	int height = 0;
+	std::vector<uint32_t> pixels; // premultiplied ARGB32
+};
+
+// The same pixels reached two ways: through a fast path and by rendering from scratch
+struct EquivalenceCheck {
+	std::string name;
+	std::function<void( CinderPangoCore & )> fastPath;
+	std::function<void( CinderPangoCore & )> fromScratch;
+};
+
+RegressionCase makeCase( const std::string &name, const std::string &text, float size, int width )
+{
+	return { name, text, size, ci::ivec2( width, 2048 ), TextAlignment::LEFT, TextWeight::NORMAL, false, 0.0f, ci::ColorA::zero() };
+}
+
+std::vector<RegressionCase> createCases()
+{
+	std::vector<RegressionCase> cases;
+	for( const Corpus &corpus : getCorpora() ) {
+		cases.push_back( makeCase( corpus.name + "-12", corpus.text, 12.0f, 600 ) );
+		cases.push_back( makeCase( corpus.name + "-32", corpus.text, 32.0f, 900 ) );
+	}
+
+	const std::string latin = getCorpora().front().text;
+
+	RegressionCase centered = makeCase( "latin-center", latin, 16.0f, 500 );
+	centered.alignment = TextAlignment::CENTER;
+	cases.push_back( centered );
+
+	RegressionCase right = makeCase( "latin-right", latin, 16.0f, 500 );
+	right.alignment = TextAlignment::RIGHT;
+	cases.push_back( right );
+
+	RegressionCase justified = makeCase( "latin-justify", latin, 16.0f, 500 );
+	justified.alignment = TextAlignment::JUSTIFY;
+	cases.push_back( justified );
+
+	RegressionCase styled = makeCase( "latin-bold-italic-spaced", latin, 20.0f, 700 );
+	styled.weight = TextWeight::BOLD;
+	styled.italics = true;
+	styled.spacing = 6.0f;
+	cases.push_back( styled );
+
+	RegressionCase background = makeCase( "latin-background", latin, 14.0f, 400 );
+	background.backgroundColor = ci::ColorA( 0.2f, 0.4f, 0.8f, 1.0f );
+	cases.push_back( background );
+
+	cases.push_back( makeCase( "narrow-wrap", latin, 24.0f, 90 ) );
+	cases.push_back( makeCase( "clipped", latin, 24.0f, 200 ) );
+	cases.back().maxSize.y = 60;
+
+	return cases;
+}
+
+void applyCase( CinderPangoCore &pango, const RegressionCase &regressionCase )
+{
+	pango.setMaxSize( regressionCase.maxSize );
+	pango.setDefaultTextSize( regressionCase.size );
+	pango.setTextAlignment( regressionCase.alignment );
+	pango.setDefaultTextWeight( regressionCase.weight );
+	pango.setDefaultTextItalicsEnabled( regressionCase.italics );
+	pango.setSpacing( regressionCase.spacing );
+	pango.setBackgroundColor( regressionCase.backgroundColor );
+	pango.setText( regressionCase.text );
+}
+
+std::vector<EquivalenceCheck> createEquivalenceChecks()
+{
+	std::vector<EquivalenceCheck> checks;
+
+	// Words with their own colors, so the highlight can move between them
+	std::string words;
+	std::vector<size_t> starts;
+	for( int i = 0; i < 40; i++ ) {
+		starts.push_back( words.size() );
+		words += "word" + std::to_string( i ) + " ";
+	}
+	auto highlight = [=]( size_t word ) {
+		TextAttributes attributes;
+		for( size_t i = 0; i < starts.size(); i++ ) {
+			const size_t end = ( i + 1 < starts.size() ) ? starts[ i + 1 ] - 1 : words.size() - 1;
+			attributes.color( starts[ i ], end, ( i == word ) ? ci::ColorA( 1, 0, 0, 1 ) : ci::ColorA( 0, 0, 0, 1 ) );
+		}
+		return attributes;
+	};
+	auto setup = [=]( CinderPangoCore &pango ) {
+		pango.setMaxSize( 400, 400 );
+		pango.setDefaultTextSize( 18.0f );
+		pango.setText( words );
+	};
+
+	// In place recolor with a partial re-raster
+	checks.push_back( { "recolor",
+		[=]( CinderPangoCore &pango ) {
+			setup( pango );
+			pango.setTextAttributes( highlight( 3 ) );
+			pango.render();
+			pango.setTextAttributes( highlight( 27 ) );
+		},
+		[=]( CinderPangoCore &pango ) {
+			setup( pango );
+			pango.setTextAttributes( highlight( 27 ) );
+		} } );
+
+	// The same overlapping color spans in the opposite order, the later one wins where they overlap
+	auto overlapping = [=]( bool redFirst ) {
+		TextAttributes attributes;
+		const ci::ColorA red( 1, 0, 0, 1 );
+		const ci::ColorA blue( 0, 0, 1, 1 );
+		attributes.color( starts[ redFirst ? 2 : 4 ], starts[ redFirst ? 6 : 8 ] - 1, redFirst ? red : blue );
+		attributes.color( starts[ redFirst ? 4 : 2 ], starts[ redFirst ? 8 : 6 ] - 1, redFirst ? blue : red );
+		return attributes;
+	};
+	checks.push_back( { "recolor-reordered",
+		[=]( CinderPangoCore &pango ) {
+			setup( pango );
+			pango.setTextAttributes( overlapping( true ) );
+			pango.render();
+			pango.setTextAttributes( overlapping( false ) );
+		},
+		[=]( CinderPangoCore &pango ) {
+			setup( pango );
+			pango.setTextAttributes( overlapping( false ) );
+		} } );
+
+	// New text drawn into the surface left over from old text of the same size
+	checks.push_back( { "reuse-surface",
+		[=]( CinderPangoCore &pango ) {
+			pango.setMaxSize( 300, 40 );
+			pango.setMinSize( 300, 40 );
+			pango.setText( "First text, 12345" );
+			pango.render();
+			pango.setText( "Second text, 67890" );
+		},
+		[=]( CinderPangoCore &pango ) {
+			pango.setMaxSize( 300, 40 );
+			pango.setMinSize( 300, 40 );
+			pango.setText( "Second text, 67890" );
+		} } );
+
+	// The size fitTextSize settles on, versus setting it directly
+	const std::string latin = getCorpora().front().text;
+	auto fittedSize = std::make_shared<float>( 0.0f );
+	checks.push_back( { "fit-text-size",
+		[=]( CinderPangoCore &pango ) {
+			pango.setMaxSize( 300, 200 );
+			pango.setText( latin );
+			*fittedSize = pango.fitTextSize( 4.0f, 64.0f ).size;
+		},
+		[=]( CinderPangoCore &pango ) {
+			pango.setMaxSize( 300, 200 );
+			pango.setDefaultTextSize( *fittedSize );
+			pango.setText( latin );
+		} } );
+
+	return checks;
+}
+
+Image captureImage( CinderPangoCore &pango )
+{
+	Image image;
+	cairo_surface_t *surface = pango.getCairoSurface();
+	if( ! surface ) {
+		return image;
+	}
+
+	cairo_surface_flush( surface );
+	image.width = cairo_image_surface_get_width( surface );
+	image.height = cairo_image_surface_get_height( surface );
+	image.pixels.resize( static_cast<size_t>( image.width ) * image.height );
+
+	const int stride = cairo_image_surface_get_stride( surface );
+	const unsigned char *data = cairo_image_surface_get_data( surface );
+	for( int y = 0; y < image.height; y++ ) {
+		const unsigned char *row = data + static_cast<size_t>( image.height - 1 - y ) * stride;
+		std::memcpy( &image.pixels[ static_cast<size_t>( y ) * image.width ], row, image.width * 4 );
+	}
+	return image;
+}
+
+bool writePng( const Image &image, const std::string &path )
+{
+	const int stride = cairo_format_stride_for_width( CAIRO_FORMAT_ARGB32, image.width );
+	std::vector<unsigned char> data( static_cast<size_t>( stride ) * image.height );
+	for( int y = 0; y < image.height; y++ ) {
+		std::memcpy( &data[ static_cast<size_t>( y ) * stride ], &image.pixels[ static_cast<size_t>( y ) * image.width ], image.width * 4 );
+	}
+
+	cairo_surface_t *surface = cairo_image_surface_create_for_data( data.data(), CAIRO_FORMAT_ARGB32, image.width, image.height, stride );
+	const bool written = ( cairo_surface_write_to_png( surface, path.c_str() ) == CAIRO_STATUS_SUCCESS );
+	cairo_surface_destroy( surface );
+	return written;
+}
+
+bool readPng( const std::string &path, Image &image )
+{
+	cairo_surface_t *surface = cairo_image_surface_create_from_png( path.c_str() );
+	const bool valid = ( cairo_surface_status( surface ) == CAIRO_STATUS_SUCCESS ) && ( cairo_image_surface_get_format( surface ) == CAIRO_FORMAT_ARGB32 );
+	if( valid ) {
+		image.width = cairo_image_surface_get_width( surface );
+		image.height = cairo_image_surface_get_height( surface );
+		image.pixels.resize( static_cast<size_t>( image.width ) * image.height );
+
+		const int stride = cairo_image_surface_get_stride( surface );
+		const unsigned char *data = cairo_image_surface_get_data( surface );
+		for( int y = 0; y < image.height; y++ ) {
+			std::memcpy( &image.pixels[ static_cast<size_t>( y ) * image.width ], data + static_cast<size_t>( y ) * stride, image.width * 4 );
+		}
+	}
+	cairo_surface_destroy( surface );
+	return valid;
+}
+
+// Empty if the images match within the tolerances, otherwise what's wrong.
+// PNG stores unpremultiplied alpha, so antialiased edges come back from a golden off by one now and then.
+std::string compareImages( const Image &expected, const Image &actual, const RegressionOptions &options )
+{
+	if( ( expected.width != actual.width ) || ( expected.height != actual.height ) ) {
+		std::ostringstream message;
+		message << "size " << actual.width << "x" << actual.height << ", expected " << expected.width << "x" << expected.height;
+		return message.str();
+	}
+
+	size_t differentPixels = 0;
+	int maxDifference = 0;
+	for( size_t i = 0; i < expected.pixels.size(); i++ ) {
+		int pixelDifference = 0;
+		for( int shift = 0; shift < 32; shift += 8 ) {
+			const int a = ( expected.pixels[ i ] >> shift ) & 0xFF;
+			const int b = ( actual.pixels[ i ] >> shift ) & 0xFF;
+			pixelDifference = std::max( pixelDifference, std::abs( a - b ) );
+		}
+		maxDifference = std::max( maxDifference, pixelDifference );
+		if( pixelDifference > options.pixelTolerance ) {
+			differentPixels++;
+		}
+	}
+
+	const double fraction = expected.pixels.empty() ? 0.0 : static_cast<double>( differentPixels ) / expected.pixels.size();
+	if( fraction > options.maxDifferentPixels ) {
+		std::ostringstream message;
+		message << differentPixels << " pixels differ (" << fraction * 100.0 << "%), max channel difference " << maxDifference;
+		return message.str();
+	}
+	return "";
+}
+
+// Empty if the metrics match
+std::string compareMetrics( const TextMetrics &expected, const TextMetrics &actual )
+{
+	if( ( expected.logicalSize == actual.logicalSize ) && ( expected.inkSize == actual.inkSize ) && ( expected.lineCount == actual.lineCount ) &&
+		( expected.baseline == actual.baseline ) ) {
+		return "";
+	}
+
+	std::ostringstream message;
+	message << "logical " << actual.logicalSize.x << "x" << actual.logicalSize.y << ", " << actual.lineCount << " lines, baseline " << actual.baseline
+			<< ", expected " << expected.logicalSize.x << "x" << expected.logicalSize.y << ", " << expected.lineCount << " lines, baseline " << expected.baseline;
+	return message.str();
+}
+
+std::map<std::string, double> readTimings( const std::string &path )
+{
+	std::map<std::string, double> timings;
+	std::ifstream file( path );
+	std::string name;
+	double microseconds;
+	while( file >> name >> microseconds ) {
+		timings[ name ] = microseconds;
+	}
+	return timings;
+}
+
+} // anonymous namespace
+
+int runRegressionGate( const RegressionOptions &options )
+{
+	int failures = 0;
+	auto fail = [&]( const std::string &name, const std::string &message ) {
+		std::printf( "FAIL %-36s %s\n", name.c_str(), message.c_str() );
+		failures++;
+	};
+
+	// Pixels against the goldens
+	for( const RegressionCase &regressionCase : createCases() ) {
+		if( ! options.filter.empty() && ( regressionCase.name.find( options.filter ) == std::string::npos ) ) {
+			continue;
+		}
+
+		CinderPangoCoreRef pango = CinderPangoCore::create();
+		applyCase( *pango, regressionCase );
+		pango->render();
+		const Image actual = captureImage( *pango );
+		const std::string goldenPath = options.directory + "/" + regressionCase.name + ".png";
+
+		if( options.update ) {
+			if( ! writePng( actual, goldenPath ) ) {
+				fail( regressionCase.name, "could not write " + goldenPath );
+			}
+			continue;
+		}
+
+		Image golden;
+		if( ! readPng( goldenPath, golden ) ) {
+			fail( regressionCase.name, "no golden at " + goldenPath + ", run with --update to create it" );
+			continue;
+		}
+
+		const std::string difference = compareImages( golden, actual, options );
+		if( ! difference.empty() ) {
+			writePng( actual, options.directory + "/" + regressionCase.name + ".actual.png" );
+			fail( regressionCase.name, difference );
+		}
+	}
+
+	// Fast paths against rendering from scratch, these need no goldens
+	for( const EquivalenceCheck &check : createEquivalenceChecks() ) {
+		if( ! options.filter.empty() && ( check.name.find( options.filter ) == std::string::npos ) ) {
+			continue;
+		}
+
+		CinderPangoCoreRef fast = CinderPangoCore::create();
+		check.fastPath( *fast );
+		fast->render();
+		CinderPangoCoreRef scratch = CinderPangoCore::create();
+		check.fromScratch( *scratch );
+		scratch->render();
+
+		const std::string difference = compareImages( captureImage( *scratch ), captureImage( *fast ), options );
+		if( ! difference.empty() ) {
+			fail( check.name, "fast path differs from a fresh render: " + difference );
+		}
+	}
+
+	// Pooled batch layouts against an instance's own measurement. One thread, so the plain job reuses the layout the
+	// markup job just used.
+	const std::string batchName = "measure-batch-after-markup";
+	if( options.filter.empty() || ( batchName.find( options.filter ) != std::string::npos ) ) {
+		MeasureJob markupJob;
+		markupJob.text = "<b><span font=\"Serif 40\">Bold</span></b> and big";
+		markupJob.style.size = 16.0f;
+		markupJob.maxSize = ci::ivec2( 400, 400 );
+		MeasureJob plainJob = markupJob;
+		plainJob.text = "Plain text after markup";
+
+		const std::vector<TextMetrics> batch = CinderPangoCore::measureBatch( { markupJob, plainJob }, 1 );
+
+		CinderPangoCoreRef solo = CinderPangoCore::create();
+		solo->setMaxSize( plainJob.maxSize );
+		solo->setDefaultTextFont( plainJob.style.font );
+		solo->setDefaultTextSize( plainJob.style.size );
+		solo->setText( plainJob.text );
+
+		const std::string difference = compareMetrics( solo->measure(), batch[ 1 ] );
+		if( ! difference.empty() ) {
+			fail( batchName, "batch measurement differs from measure(): " + difference );
+		}
+	}
+
+	// Batch measurement at a quality preset whose hinting changes the advances
+	const std::string qualityName = "measure-batch-smooth";
+	if( options.filter.empty() || ( qualityName.find( options.filter ) != std::string::npos ) ) {
+		MeasureJob job;
+		job.text = getCorpora().front().text;
+		job.style.size = 13.0f;
+		job.style.quality = TextQuality::smooth();
+		job.maxSize = ci::ivec2( 500, 2048 );
+
+		const std::vector<TextMetrics> batch = CinderPangoCore::measureBatch( { job }, 1 );
+
+		CinderPangoCoreRef solo = CinderPangoCore::create();
+		solo->setMaxSize( job.maxSize );
+		solo->setDefaultTextFont( job.style.font );
+		solo->setDefaultTextSize( job.style.size );
+		solo->setTextQuality( job.style.quality );
+		solo->setText( job.text );
+
+		const std::string difference = compareMetrics( solo->measure(), batch[ 0 ] );
+		if( ! difference.empty() ) {
+			fail( qualityName, "batch measurement differs from measure(): " + difference );
+		}
+	}
+
+	// Timings against the baseline, forced full renders of every case
+	BenchmarkSuite suite( options.iterations, options.filter );
+	for( const RegressionCase &regressionCase : createCases() ) {
+		CinderPangoCoreRef pango = CinderPangoCore::create();
+		applyCase( *pango, regressionCase );
+		suite.run( regressionCase.name, [&]( int ) { pango->render( true ); } );
+	}
+
+	const std::string timingsPath = options.directory + "/timings.txt";
+	if( options.update ) {
+		std::ofstream file( timingsPath );
+		for( const BenchmarkResult &result : suite.getResults() ) {
+			file << result.name << " " << result.p50Microseconds << "\n";
+		}
+		if( ! file ) {
+			fail( "timings", "could not write " + timingsPath );
+		}
+	} else {
+		const std::map<std::string, double> baseline = readTimings( timingsPath );
+		for( const BenchmarkResult &result : suite.getResults() ) {
+			auto found = baseline.find( result.name );
+			if( found == baseline.end() ) {
+				fail( result.name, "no timing baseline in " + timingsPath + ", run with --update to create it" );
+			} else if( result.p50Microseconds > found->second * ( 1.0 + options.timingThreshold ) ) {
+				std::ostringstream message;
+				message << "p50 " << result.p50Microseconds << " us, baseline " << found->second << " us (+"
+						<< ( result.p50Microseconds / found->second - 1.0 ) * 100.0 << "%)";
+				fail( result.name, message.str() );
+			}
+		}
+	}
+
+	if( options.update ) {
+		std::printf( "Updated goldens and timings in %s\n", options.directory.c_str() );
+	} else {
+		std::printf( failures ? "%d regression(s)\n" : "No regressions\n", failures );
+	}
+	return failures ? 1 : 0;
+}
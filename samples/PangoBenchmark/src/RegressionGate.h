@@ -0,0 +1,21 @@
+// RegressionGate.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <string>
+
+struct RegressionOptions {
+	std::string directory;		  // goldens (<case>.png) and timings.txt live here
+	bool update = false;		  // write goldens and timings instead of checking against them
+	int iterations = 200;		  // per timed case
+	int pixelTolerance = 2;		  // max per channel difference that still counts as equal
+	double maxDifferentPixels = 0.001; // fraction of pixels allowed beyond the tolerance
+	double timingThreshold = 0.15; // fail when a case's p50 is this much slower than the baseline
+	std::string filter;
+};
+
+// Renders every regression case through CinderPangoCore and compares pixels and timings against the stored ones.
+// Returns the process exit code, non-zero if anything regressed.
+int runRegressionGate( const RegressionOptions &options );
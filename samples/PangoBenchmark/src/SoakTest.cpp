@@ -0,0 +1,98 @@
+// SoakTest.cpp
+// Cinder-Pango
+//
+
+#include "SoakTest.h"
+#include "CinderPangoCore.h"
+#include "CinderPangoLedger.h"
+#include "CinderPangoMetrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#if defined( __linux__ )
+#include <unistd.h>
+#endif
+
+using namespace kp::pango;
+
+namespace {
+
+// Resident set size in bytes, 0 where it isn't available
+size_t getResidentBytes()
+{
+#if defined( __linux__ )
+	std::ifstream statm( "/proc/self/statm" );
+	size_t totalPages = 0;
+	size_t residentPages = 0;
+	if( statm >> totalPages >> residentPages ) {
+		return residentPages * static_cast<size_t>( sysconf( _SC_PAGESIZE ) );
+	}
+#endif
+	return 0;
+}
+
+} // anonymous namespace
+
+int runSoakTest( int instances )
+{
+	// Font caches, fontconfig and the glyph cache fill up during the first instances, growth after that is a leak
+	const int warmUpInstances = std::max( instances / 10, 1 );
+	const int sampleInterval = std::max( instances / 20, 1 );
+	const size_t maxGrowthBytes = 4 * 1024 * 1024;
+
+	ResourceLedger::setEnabled( true );
+	size_t baselineBytes = 0;
+	size_t peakBytes = 0;
+
+	for( int i = 0; i < instances; i++ ) {
+		{
+			CinderPangoCoreRef pango = CinderPangoCore::create();
+			pango->setMaxSize( 320, 240 );
+			pango->setDefaultTextSize( 12.0f + ( i % 8 ) );
+			pango->setText( ( i % 2 ) ? "<b>Instance</b> number " + std::to_string( i ) : "Instance number " + std::to_string( i ) );
+			pango->render();
+		}
+
+		if( ( i + 1 ) == warmUpInstances ) {
+			baselineBytes = getResidentBytes();
+		}
+
+		if( ( ( i + 1 ) % sampleInterval ) == 0 ) {
+			const size_t bytes = getResidentBytes();
+			peakBytes = std::max( peakBytes, bytes );
+			std::printf( "%8d instances  RSS %8.2f MB\n", i + 1, bytes / ( 1024.0 * 1024.0 ) );
+			std::fflush( stdout );
+		}
+	}
+
+	int failures = 0;
+
+	const std::string leaks = ResourceLedger::getLeakReport();
+	if( ! leaks.empty() ) {
+		std::printf( "FAIL resources still alive after all instances were destroyed:\n%s", leaks.c_str() );
+		failures++;
+	}
+
+	if( Metrics::get( Counter::INSTANCES_ALIVE ) != 0 ) {
+		std::printf( "FAIL %lld instances still alive\n", static_cast<long long>( Metrics::get( Counter::INSTANCES_ALIVE ) ) );
+		failures++;
+	}
+
+	const size_t finalBytes = getResidentBytes();
+	if( baselineBytes == 0 ) {
+		std::printf( "RSS isn't available on this platform, only the ledger was checked\n" );
+	} else {
+		const double growthMegabytes = ( static_cast<double>( finalBytes ) - baselineBytes ) / ( 1024.0 * 1024.0 );
+		std::printf( "RSS after warm up %.2f MB, final %.2f MB (%+.2f MB), peak %.2f MB\n", baselineBytes / ( 1024.0 * 1024.0 ),
+			finalBytes / ( 1024.0 * 1024.0 ), growthMegabytes, peakBytes / ( 1024.0 * 1024.0 ) );
+		if( finalBytes > baselineBytes + maxGrowthBytes ) {
+			std::printf( "FAIL RSS grew by more than %zu MB after warm up\n", maxGrowthBytes / ( 1024 * 1024 ) );
+			failures++;
+		}
+	}
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,9 @@
+// SoakTest.h
+// Cinder-Pango
+//
+
+#pragma once
+
+// Creates, renders and destroys the given number of CinderPangoCore instances while sampling RSS, then checks that
+// memory stayed flat and the resource ledger is empty. Returns the process exit code.
+int runSoakTest( int instances );
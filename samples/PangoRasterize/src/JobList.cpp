@@ -0,0 +1,494 @@
+// JobList.cpp
+// Cinder-Pango
+//
+
+#include "JobList.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+using namespace kp::pango;
+
+namespace {
+
+// A JSON scalar, jobs don't need arrays or nested objects
+struct JsonValue {
+	enum Type { STRING, NUMBER, BOOL, NUL } type = NUL;
+	std::string string;
+	double number = 0.0;
+	bool boolean = false;
+};
+
+class JsonLineParser {
+  public:
+	explicit JsonLineParser( const std::string &line ) :
+		mLine( line ),
+		mPosition( 0 )
+	{
+	}
+
+	bool parseObject( std::map<std::string, JsonValue> &object, std::string &error )
+	{
+		skipSpace();
+		if( ! consume( '{' ) ) {
+			error = "expected a JSON object";
+			return false;
+		}
+
+		skipSpace();
+		if( consume( '}' ) ) {
+			return atEnd( error );
+		}
+
+		while( true ) {
+			std::string key;
+			JsonValue value;
+			skipSpace();
+			if( ! parseString( key, error ) ) {
+				return false;
+			}
+			skipSpace();
+			if( ! consume( ':' ) ) {
+				error = "expected ':' after \"" + key + "\"";
+				return false;
+			}
+			skipSpace();
+			if( ! parseValue( value, error ) ) {
+				error += " in \"" + key + "\"";
+				return false;
+			}
+			object[ key ] = value;
+
+			skipSpace();
+			if( consume( '}' ) ) {
+				return atEnd( error );
+			}
+			if( ! consume( ',' ) ) {
+				error = "expected ',' or '}'";
+				return false;
+			}
+		}
+	}
+
+  private:
+	bool parseValue( JsonValue &value, std::string &error )
+	{
+		if( peek() == '"' ) {
+			value.type = JsonValue::STRING;
+			return parseString( value.string, error );
+		}
+		if( matchWord( "true" ) ) {
+			value.type = JsonValue::BOOL;
+			value.boolean = true;
+			return true;
+		}
+		if( matchWord( "false" ) ) {
+			value.type = JsonValue::BOOL;
+			value.boolean = false;
+			return true;
+		}
+		if( matchWord( "null" ) ) {
+			value.type = JsonValue::NUL;
+			return true;
+		}
+		if( ( peek() == '{' ) || ( peek() == '[' ) ) {
+			error = "nested objects and arrays aren't supported";
+			return false;
+		}
+
+		const char *begin = mLine.c_str() + mPosition;
+		char *end = nullptr;
+		value.number = std::strtod( begin, &end );
+		if( end == begin ) {
+			error = "unexpected character";
+			return false;
+		}
+		value.type = JsonValue::NUMBER;
+		mPosition += end - begin;
+		return true;
+	}
+
+	bool parseString( std::string &result, std::string &error )
+	{
+		if( ! consume( '"' ) ) {
+			error = "expected a string";
+			return false;
+		}
+
+		result.clear();
+		while( mPosition < mLine.size() ) {
+			const char c = mLine[ mPosition++ ];
+			if( c == '"' ) {
+				return true;
+			}
+			if( c != '\\' ) {
+				result += c;
+				continue;
+			}
+			if( mPosition >= mLine.size() ) {
+				break;
+			}
+
+			const char escaped = mLine[ mPosition++ ];
+			switch( escaped ) {
+				case 'n':
+					result += '\n';
+					break;
+				case 't':
+					result += '\t';
+					break;
+				case 'r':
+					result += '\r';
+					break;
+				case 'b':
+					result += '\b';
+					break;
+				case 'f':
+					result += '\f';
+					break;
+				case 'u': {
+					uint32_t codepoint = 0;
+					if( ! parseHex4( codepoint ) ) {
+						error = "bad \\u escape";
+						return false;
+					}
+					// Characters outside the BMP come as a surrogate pair
+					uint32_t low = 0;
+					if( ( codepoint >= 0xD800 ) && ( codepoint < 0xDC00 ) && ( mLine.compare( mPosition, 2, "\\u" ) == 0 ) ) {
+						mPosition += 2;
+						if( ! parseHex4( low ) || ( low < 0xDC00 ) || ( low > 0xDFFF ) ) {
+							error = "bad surrogate pair";
+							return false;
+						}
+						codepoint = 0x10000 + ( ( codepoint - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+					}
+					appendUtf8( result, codepoint );
+					break;
+				}
+				default: // " \ and /
+					result += escaped;
+					break;
+			}
+		}
+
+		error = "unterminated string";
+		return false;
+	}
+
+	bool parseHex4( uint32_t &value )
+	{
+		if( mPosition + 4 > mLine.size() ) {
+			return false;
+		}
+		value = 0;
+		for( int i = 0; i < 4; i++ ) {
+			const char c = mLine[ mPosition++ ];
+			value <<= 4;
+			if( ( c >= '0' ) && ( c <= '9' ) ) {
+				value |= c - '0';
+			} else if( ( c >= 'a' ) && ( c <= 'f' ) ) {
+				value |= c - 'a' + 10;
+			} else if( ( c >= 'A' ) && ( c <= 'F' ) ) {
+				value |= c - 'A' + 10;
+			} else {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static void appendUtf8( std::string &result, uint32_t codepoint )
+	{
+		if( codepoint < 0x80 ) {
+			result += static_cast<char>( codepoint );
+		} else if( codepoint < 0x800 ) {
+			result += static_cast<char>( 0xC0 | ( codepoint >> 6 ) );
+			result += static_cast<char>( 0x80 | ( codepoint & 0x3F ) );
+		} else if( codepoint < 0x10000 ) {
+			result += static_cast<char>( 0xE0 | ( codepoint >> 12 ) );
+			result += static_cast<char>( 0x80 | ( ( codepoint >> 6 ) & 0x3F ) );
+			result += static_cast<char>( 0x80 | ( codepoint & 0x3F ) );
+		} else {
+			result += static_cast<char>( 0xF0 | ( codepoint >> 18 ) );
+			result += static_cast<char>( 0x80 | ( ( codepoint >> 12 ) & 0x3F ) );
+			result += static_cast<char>( 0x80 | ( ( codepoint >> 6 ) & 0x3F ) );
+			result += static_cast<char>( 0x80 | ( codepoint & 0x3F ) );
+		}
+	}
+
+	bool matchWord( const char *word )
+	{
+		const size_t length = std::strlen( word );
+		if( mLine.compare( mPosition, length, word ) == 0 ) {
+			mPosition += length;
+			return true;
+		}
+		return false;
+	}
+
+	bool atEnd( std::string &error )
+	{
+		skipSpace();
+		if( mPosition != mLine.size() ) {
+			error = "trailing characters after the object";
+			return false;
+		}
+		return true;
+	}
+
+	char peek() const { return ( mPosition < mLine.size() ) ? mLine[ mPosition ] : '\0'; }
+
+	bool consume( char c )
+	{
+		if( peek() == c ) {
+			mPosition++;
+			return true;
+		}
+		return false;
+	}
+
+	void skipSpace()
+	{
+		while( ( mPosition < mLine.size() ) && std::strchr( " \t\r\n", mLine[ mPosition ] ) ) {
+			mPosition++;
+		}
+	}
+
+	const std::string &mLine;
+	size_t mPosition;
+};
+
+// #rrggbb or #rrggbbaa
+bool parseColor( const std::string &value, ci::ColorA &color )
+{
+	if( ( value.size() != 7 && value.size() != 9 ) || ( value[ 0 ] != '#' ) ) {
+		return false;
+	}
+
+	char *end = nullptr;
+	const unsigned long rgba = std::strtoul( value.c_str() + 1, &end, 16 );
+	if( *end != '\0' ) {
+		return false;
+	}
+
+	const unsigned long packed = ( value.size() == 7 ) ? ( ( rgba << 8 ) | 0xFF ) : rgba;
+	color = ci::ColorA( ( ( packed >> 24 ) & 0xFF ) / 255.0f, ( ( packed >> 16 ) & 0xFF ) / 255.0f, ( ( packed >> 8 ) & 0xFF ) / 255.0f, ( packed & 0xFF ) / 255.0f );
+	return true;
+}
+
+bool parseWeight( const JsonValue &value, TextWeight &weight )
+{
+	if( value.type == JsonValue::NUMBER ) {
+		weight = static_cast<TextWeight>( static_cast<int>( value.number ) );
+		return true;
+	}
+
+	static const std::map<std::string, TextWeight> names = {
+		{ "thin", TextWeight::THIN },
+		{ "ultralight", TextWeight::ULTRALIGHT },
+		{ "light", TextWeight::LIGHT },
+		{ "semilight", TextWeight::SEMILIGHT },
+		{ "book", TextWeight::BOOK },
+		{ "normal", TextWeight::NORMAL },
+		{ "medium", TextWeight::MEDIUM },
+		{ "semibold", TextWeight::SEMIBOLD },
+		{ "bold", TextWeight::BOLD },
+		{ "ultrabold", TextWeight::ULTRABOLD },
+		{ "heavy", TextWeight::HEAVY },
+		{ "ultraheavy", TextWeight::ULTRAHEAVY },
+	};
+	auto it = names.find( value.string );
+	if( it == names.end() ) {
+		return false;
+	}
+	weight = it->second;
+	return true;
+}
+
+bool parseAlignment( const std::string &value, TextAlignment &alignment )
+{
+	static const std::map<std::string, TextAlignment> names = {
+		{ "left", TextAlignment::LEFT },
+		{ "center", TextAlignment::CENTER },
+		{ "right", TextAlignment::RIGHT },
+		{ "justify", TextAlignment::JUSTIFY },
+	};
+	auto it = names.find( value );
+	if( it == names.end() ) {
+		return false;
+	}
+	alignment = it->second;
+	return true;
+}
+
+bool parseAntialias( const std::string &value, TextAntialias &antialias )
+{
+	static const std::map<std::string, TextAntialias> names = {
+		{ "default", TextAntialias::DEFAULT },
+		{ "none", TextAntialias::NONE },
+		{ "gray", TextAntialias::GRAY },
+		{ "subpixel", TextAntialias::SUBPIXEL },
+	};
+	auto it = names.find( value );
+	if( it == names.end() ) {
+		return false;
+	}
+	antialias = it->second;
+	return true;
+}
+
+bool parseQuality( const std::string &value, TextQuality &quality )
+{
+	static const std::map<std::string, TextQuality> names = {
+		{ "crisp", TextQuality::crisp() },
+		{ "smooth", TextQuality::smooth() },
+		{ "preview", TextQuality::preview() },
+	};
+	auto it = names.find( value );
+	if( it == names.end() ) {
+		return false;
+	}
+	quality = it->second;
+	return true;
+}
+
+bool parseFormat( const std::string &value, OutputFormat &format )
+{
+	if( value == "png" ) {
+		format = OutputFormat::PNG;
+	} else if( value == "raw" ) {
+		format = OutputFormat::RAW;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool hasSuffix( const std::string &value, const std::string &suffix )
+{
+	return ( value.size() >= suffix.size() ) && ( value.compare( value.size() - suffix.size(), suffix.size(), suffix ) == 0 );
+}
+
+bool parseJob( const std::map<std::string, JsonValue> &object, OutputFormat defaultFormat, const std::string &outputDirectory, RasterJob &job, std::string &error )
+{
+	bool hasFormat = false;
+	// Fields come in key order, an explicit antialias overrides the preset's either way
+	bool hasAntialias = false;
+	TextAntialias antialias = TextAntialias::DEFAULT;
+
+	for( const auto &field : object ) {
+		const std::string &key = field.first;
+		const JsonValue &value = field.second;
+		const bool isString = ( value.type == JsonValue::STRING );
+		const bool isNumber = ( value.type == JsonValue::NUMBER );
+		bool valid = true;
+
+		if( key == "text" ) {
+			valid = isString;
+			job.text = value.string;
+		} else if( key == "out" ) {
+			valid = isString && ! value.string.empty();
+			job.outputPath = value.string;
+		} else if( key == "format" ) {
+			valid = isString && parseFormat( value.string, job.format );
+			hasFormat = true;
+		} else if( key == "font" ) {
+			valid = isString;
+			job.style.font = value.string;
+		} else if( key == "size" ) {
+			valid = isNumber && ( value.number > 0.0 );
+			job.style.size = static_cast<float>( value.number );
+		} else if( key == "weight" ) {
+			valid = ( isString || isNumber ) && parseWeight( value, job.style.weight );
+		} else if( key == "italic" ) {
+			valid = ( value.type == JsonValue::BOOL );
+			job.style.italicsEnabled = value.boolean;
+		} else if( key == "smallCaps" ) {
+			valid = ( value.type == JsonValue::BOOL );
+			job.style.smallCapsEnabled = value.boolean;
+		} else if( key == "align" ) {
+			valid = isString && parseAlignment( value.string, job.style.alignment );
+		} else if( key == "spacing" ) {
+			valid = isNumber;
+			job.style.spacing = static_cast<float>( value.number );
+		} else if( key == "color" ) {
+			valid = isString && parseColor( value.string, job.color );
+		} else if( key == "background" ) {
+			valid = isString && parseColor( value.string, job.backgroundColor );
+		} else if( key == "antialias" ) {
+			valid = isString && parseAntialias( value.string, antialias );
+			hasAntialias = true;
+		} else if( key == "quality" ) {
+			valid = isString && parseQuality( value.string, job.quality );
+		} else if( key == "width" ) {
+			valid = isNumber && ( value.number > 0.0 );
+			job.maxSize.x = static_cast<int>( value.number );
+		} else if( key == "height" ) {
+			valid = isNumber && ( value.number > 0.0 );
+			job.maxSize.y = static_cast<int>( value.number );
+		} else if( key == "minWidth" ) {
+			valid = isNumber && ( value.number >= 0.0 );
+			job.minSize.x = static_cast<int>( value.number );
+		} else if( key == "minHeight" ) {
+			valid = isNumber && ( value.number >= 0.0 );
+			job.minSize.y = static_cast<int>( value.number );
+		} else {
+			error = "unknown field \"" + key + "\"";
+			return false;
+		}
+
+		if( ! valid ) {
+			error = "bad value for \"" + key + "\"";
+			return false;
+		}
+	}
+
+	if( job.outputPath.empty() ) {
+		error = "missing \"out\"";
+		return false;
+	}
+
+	if( hasAntialias ) {
+		job.quality.antialias = antialias;
+	}
+
+	if( ! hasFormat ) {
+		job.format = hasSuffix( job.outputPath, ".raw" ) ? OutputFormat::RAW : hasSuffix( job.outputPath, ".png" ) ? OutputFormat::PNG : defaultFormat;
+	}
+
+	if( ! outputDirectory.empty() && ( job.outputPath[ 0 ] != '/' ) ) {
+		job.outputPath = outputDirectory + "/" + job.outputPath;
+	}
+
+	return true;
+}
+
+} // anonymous namespace
+
+bool readJobList( std::istream &input, OutputFormat defaultFormat, const std::string &outputDirectory, std::vector<RasterJob> &jobs, std::string &error )
+{
+	std::string line;
+	size_t lineNumber = 0;
+
+	while( std::getline( input, line ) ) {
+		lineNumber++;
+
+		const size_t first = line.find_first_not_of( " \t\r" );
+		if( ( first == std::string::npos ) || ( line[ first ] == '#' ) ) {
+			continue;
+		}
+
+		std::map<std::string, JsonValue> object;
+		RasterJob job;
+		job.lineNumber = lineNumber;
+		if( ! JsonLineParser( line ).parseObject( object, error ) || ! parseJob( object, defaultFormat, outputDirectory, job, error ) ) {
+			error = "line " + std::to_string( lineNumber ) + ": " + error;
+			return false;
+		}
+		jobs.push_back( std::move( job ) );
+	}
+
+	return true;
+}
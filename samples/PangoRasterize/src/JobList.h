@@ -0,0 +1,35 @@
+// JobList.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPangoCore.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+enum class OutputFormat {
+	PNG, // premultiplied ARGB32 as written by Cairo
+	RAW, // tightly packed premultiplied BGRA rows, top down
+};
+
+// One line of the job list, see readme.md for the fields
+struct RasterJob {
+	std::string text; // may contain markup
+	std::string outputPath;
+	OutputFormat format = OutputFormat::PNG;
+	kp::pango::TextStyle style;
+	ci::ColorA color = ci::ColorA::black();
+	ci::ColorA backgroundColor = ci::ColorA::zero();
+	ci::ivec2 minSize = ci::ivec2( 0, 0 );
+	ci::ivec2 maxSize = ci::ivec2( 320, 240 );
+	kp::pango::TextQuality quality;
+	size_t lineNumber = 0;
+};
+
+// Reads one flat JSON object per line. Blank lines and lines starting with # are skipped. Relative output paths are
+// resolved against outputDirectory (if not empty), and the format defaults to the output path's extension, then to
+// defaultFormat. Returns false and describes the first bad line in error.
+bool readJobList( std::istream &input, OutputFormat defaultFormat, const std::string &outputDirectory, std::vector<RasterJob> &jobs, std::string &error );
@@ -0,0 +1,306 @@
+// PangoRasterize.cpp
+// Renders a list of text jobs to PNG or raw pixel files in parallel. Only needs the headless core,
+// see readme.md for the job list format.
+
+#include "CinderPangoCore.h"
+#include "JobList.h"
+
+#include <cairo.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace kp::pango;
+
+namespace {
+
+struct JobResult {
+	bool ok = false;
+	std::string error;
+	int width = 0;
+	int height = 0;
+	double renderSeconds = 0.0; // state changes and render()
+	double totalSeconds = 0.0;	// including writing the file
+};
+
+void applyJob( CinderPangoCore &pango, const RasterJob &job )
+{
+	pango.setDefaultTextFont( job.style.font );
+	pango.setDefaultTextSize( job.style.size );
+	pango.setDefaultTextWeight( job.style.weight );
+	pango.setDefaultTextItalicsEnabled( job.style.italicsEnabled );
+	pango.setDefaultTextSmallCapsEnabled( job.style.smallCapsEnabled );
+	pango.setTextAlignment( job.style.alignment );
+	pango.setSpacing( job.style.spacing );
+	pango.setDefaultTextColor( job.color );
+	pango.setBackgroundColor( job.backgroundColor );
+	pango.setTextQuality( job.quality );
+	pango.setMinSize( job.minSize );
+	pango.setMaxSize( job.maxSize );
+	pango.setText( job.text );
+}
+
+bool writeRaw( const CinderPangoCore &pango, const std::string &path )
+{
+	FILE *file = std::fopen( path.c_str(), "wb" );
+	if( ! file ) {
+		return false;
+	}
+
+	// Drop the stride padding so the file is exactly width * height * 4 bytes
+	const ci::ivec2 size = pango.getPixelSize();
+	const unsigned char *pixels = pango.getPixels();
+	const size_t rowBytes = static_cast<size_t>( size.x ) * 4;
+	bool written = true;
+	for( int y = 0; ( y < size.y ) && written; y++ ) {
+		written = ( std::fwrite( pixels + static_cast<size_t>( y ) * pango.getPixelStride(), 1, rowBytes, file ) == rowBytes );
+	}
+
+	return ( std::fclose( file ) == 0 ) && written;
+}
+
+JobResult runJob( CinderPangoCore &pango, const RasterJob &job )
+{
+	JobResult result;
+	const auto start = std::chrono::steady_clock::now();
+
+	applyJob( pango, job );
+	pango.render();
+	result.renderSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	if( ! pango.getPixels() ) {
+		result.error = "nothing was rendered";
+		result.totalSeconds = result.renderSeconds;
+		return result;
+	}
+
+	const ci::ivec2 size = pango.getPixelSize();
+	result.width = size.x;
+	result.height = size.y;
+
+	std::error_code ignored;
+	const ci::fs::path parent = ci::fs::path( job.outputPath ).parent_path();
+	if( ! parent.empty() ) {
+		ci::fs::create_directories( parent, ignored );
+	}
+
+	if( job.format == OutputFormat::PNG ) {
+		result.ok = ( cairo_surface_write_to_png( pango.getCairoSurface(), job.outputPath.c_str() ) == CAIRO_STATUS_SUCCESS );
+	} else {
+		result.ok = writeRaw( pango, job.outputPath );
+	}
+
+	if( ! result.ok ) {
+		result.error = "could not write " + job.outputPath;
+	}
+
+	result.totalSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	return result;
+}
+
+// Workers pull job indices until they run out, like CinderPangoCore::measureBatch. Each one keeps a single
+// instance for all of its jobs, so its font map, font descriptions, layout and surface are reused from job to job.
+std::vector<JobResult> runJobs( const std::vector<RasterJob> &jobs, size_t numThreads )
+{
+	std::vector<JobResult> results( jobs.size() );
+	std::atomic<size_t> nextJob( 0 );
+
+	auto worker = [&]() {
+		CinderPangoCoreRef pango = CinderPangoCore::create();
+		pango->setSurfaceFlipped( false ); // files are top down
+		for( size_t i = nextJob++; i < jobs.size(); i = nextJob++ ) {
+			results[ i ] = runJob( *pango, jobs[ i ] );
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for( size_t i = 1; i < numThreads; i++ ) {
+		threads.emplace_back( worker );
+	}
+	worker();
+
+	for( auto &thread : threads ) {
+		thread.join();
+	}
+
+	return results;
+}
+
+void writeJsonString( FILE *file, const std::string &value )
+{
+	std::fputc( '"', file );
+	for( char c : value ) {
+		if( ( c == '"' ) || ( c == '\\' ) ) {
+			std::fputc( '\\', file );
+			std::fputc( c, file );
+		} else if( static_cast<unsigned char>( c ) < 0x20 ) {
+			std::fprintf( file, "\\u%04x", c );
+		} else {
+			std::fputc( c, file );
+		}
+	}
+	std::fputc( '"', file );
+}
+
+// One JSON object per job, in job list order
+void writeReport( FILE *file, const std::vector<RasterJob> &jobs, const std::vector<JobResult> &results )
+{
+	for( size_t i = 0; i < jobs.size(); i++ ) {
+		const JobResult &result = results[ i ];
+		std::fprintf( file, "{\"line\": %zu, \"out\": ", jobs[ i ].lineNumber );
+		writeJsonString( file, jobs[ i ].outputPath );
+		std::fprintf( file, ", \"ok\": %s, \"width\": %d, \"height\": %d, \"renderMs\": %.3f, \"totalMs\": %.3f", result.ok ? "true" : "false", result.width,
+			result.height, result.renderSeconds * 1000.0, result.totalSeconds * 1000.0 );
+		if( ! result.ok ) {
+			std::fputs( ", \"error\": ", file );
+			writeJsonString( file, result.error );
+		}
+		std::fputs( "}\n", file );
+	}
+}
+
+void printSummary( const std::vector<JobResult> &results, size_t numThreads, double seconds )
+{
+	size_t failed = 0;
+	double megapixels = 0.0;
+	std::vector<double> times;
+	times.reserve( results.size() );
+	for( const JobResult &result : results ) {
+		if( ! result.ok ) {
+			failed++;
+			continue;
+		}
+		megapixels += result.width * static_cast<double>( result.height ) / 1000000.0;
+		times.push_back( result.totalSeconds );
+	}
+
+	std::fprintf( stderr, "Rendered %zu jobs (%zu failed) in %.2f s on %zu threads: %.1f jobs/s, %.2f Mpx/s\n", results.size(), failed, seconds,
+		numThreads, results.size() / seconds, megapixels / seconds );
+
+	if( ! times.empty() ) {
+		std::sort( times.begin(), times.end() );
+		auto percentile = [&]( double p ) { return times[ std::min( static_cast<size_t>( p / 100.0 * times.size() ), times.size() - 1 ) ] * 1000.0; };
+		std::fprintf( stderr, "Per job: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", percentile( 50.0 ), percentile( 99.0 ), times.back() * 1000.0 );
+	}
+}
+
+void printUsage( const char *executable )
+{
+	std::fprintf( stderr,
+		"Usage: %s <jobs.jsonl, - for stdin> [--threads <count>] [--out-dir <directory>] [--format <png|raw>]\n"
+		"       %*s [--font <file>]... [--report <file, - for stdout>]\n",
+		executable, static_cast<int>( std::strlen( executable ) ), "" );
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	std::string jobListPath;
+	std::string outputDirectory;
+	std::string reportPath;
+	std::vector<std::string> fontPaths;
+	OutputFormat defaultFormat = OutputFormat::PNG;
+	size_t numThreads = 0;
+
+	for( int i = 1; i < argc; i++ ) {
+		if( ( std::strcmp( argv[ i ], "--threads" ) == 0 ) && ( i + 1 < argc ) ) {
+			numThreads = static_cast<size_t>( std::max( std::atoi( argv[ ++i ] ), 0 ) );
+		} else if( ( std::strcmp( argv[ i ], "--out-dir" ) == 0 ) && ( i + 1 < argc ) ) {
+			outputDirectory = argv[ ++i ];
+		} else if( ( std::strcmp( argv[ i ], "--format" ) == 0 ) && ( i + 1 < argc ) ) {
+			const std::string format = argv[ ++i ];
+			if( ( format != "png" ) && ( format != "raw" ) ) {
+				printUsage( argv[ 0 ] );
+				return 1;
+			}
+			defaultFormat = ( format == "raw" ) ? OutputFormat::RAW : OutputFormat::PNG;
+		} else if( ( std::strcmp( argv[ i ], "--font" ) == 0 ) && ( i + 1 < argc ) ) {
+			fontPaths.push_back( argv[ ++i ] );
+		} else if( ( std::strcmp( argv[ i ], "--report" ) == 0 ) && ( i + 1 < argc ) ) {
+			reportPath = argv[ ++i ];
+		} else if( jobListPath.empty() && ( ( argv[ i ][ 0 ] != '-' ) || ( std::strcmp( argv[ i ], "-" ) == 0 ) ) ) {
+			jobListPath = argv[ i ];
+		} else {
+			printUsage( argv[ 0 ] );
+			return 1;
+		}
+	}
+
+	if( jobListPath.empty() ) {
+		printUsage( argv[ 0 ] );
+		return 1;
+	}
+
+	std::vector<RasterJob> jobs;
+	std::string error;
+	bool parsed = false;
+	if( jobListPath == "-" ) {
+		parsed = readJobList( std::cin, defaultFormat, outputDirectory, jobs, error );
+	} else {
+		std::ifstream input( jobListPath );
+		if( ! input ) {
+			std::fprintf( stderr, "Could not open %s\n", jobListPath.c_str() );
+			return 1;
+		}
+		parsed = readJobList( input, defaultFormat, outputDirectory, jobs, error );
+	}
+
+	if( ! parsed ) {
+		std::fprintf( stderr, "%s: %s\n", jobListPath.c_str(), error.c_str() );
+		return 1;
+	}
+
+	if( jobs.empty() ) {
+		std::fprintf( stderr, "No jobs in %s\n", jobListPath.c_str() );
+		return 0;
+	}
+
+	// Fonts are registered with fontconfig for the whole process, before any worker creates its font map
+	CinderPangoCore::setTextRenderer( TextRenderer::FREETYPE );
+	for( const std::string &fontPath : fontPaths ) {
+		CinderPangoCore::loadFont( fontPath );
+	}
+
+	if( numThreads == 0 ) {
+		numThreads = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+	}
+	numThreads = std::min( numThreads, jobs.size() );
+
+	const auto start = std::chrono::steady_clock::now();
+	const std::vector<JobResult> results = runJobs( jobs, numThreads );
+	const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	if( ! reportPath.empty() ) {
+		FILE *file = ( reportPath == "-" ) ? stdout : std::fopen( reportPath.c_str(), "w" );
+		if( ! file ) {
+			std::fprintf( stderr, "Could not open %s for writing\n", reportPath.c_str() );
+			return 1;
+		}
+		writeReport( file, jobs, results );
+		if( file != stdout ) {
+			std::fclose( file );
+		}
+	}
+
+	for( size_t i = 0; i < jobs.size(); i++ ) {
+		if( ! results[ i ].ok ) {
+			std::fprintf( stderr, "%s:%zu: %s\n", jobListPath.c_str(), jobs[ i ].lineNumber, results[ i ].error.c_str() );
+		}
+	}
+
+	printSummary( results, numThreads, seconds );
+
+	const bool allSucceeded = std::all_of( results.begin(), results.end(), []( const JobResult &result ) { return result.ok; } );
+	return allSucceeded ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+// PangoStream.cpp
+// Renders a timed subtitle / lower third scene into raw frames on stdout (or a file) for an external encoder,
+// e.g. piped into ffmpeg. Only needs the headless core, see readme.md.
+
+#include "CinderPangoCore.h"
+#include "CinderPangoFrameStream.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace kp::pango;
+
+namespace {
+
+struct Cue {
+	double start;
+	double end;
+	std::string text; // may contain markup and <br>
+};
+
+const double kFadeSeconds = 0.25;
+
+// One cue per line: <start seconds> <end seconds> <text>. Blank lines and lines starting with # are skipped.
+bool readCues( const std::string &path, std::vector<Cue> &cues )
+{
+	std::ifstream input( path );
+	if( ! input ) {
+		std::fprintf( stderr, "Could not open %s\n", path.c_str() );
+		return false;
+	}
+
+	std::string line;
+	size_t lineNumber = 0;
+	while( std::getline( input, line ) ) {
+		lineNumber++;
+		if( line.empty() || ( line[ 0 ] == '#' ) ) {
+			continue;
+		}
+
+		std::istringstream stream( line );
+		Cue cue;
+		if( ! ( stream >> cue.start >> cue.end ) || ( cue.end <= cue.start ) ) {
+			std::fprintf( stderr, "%s:%zu: expected <start> <end> <text>\n", path.c_str(), lineNumber );
+			return false;
+		}
+		std::getline( stream >> std::ws, cue.text );
+		cues.push_back( cue );
+	}
+
+	std::sort( cues.begin(), cues.end(), []( const Cue &a, const Cue &b ) { return a.start < b.start; } );
+	return true;
+}
+
+std::vector<Cue> createDemoCues()
+{
+	return {
+		{ 0.5, 3.0, "<b>Cinder-Pango</b><br>Streaming raw frames" },
+		{ 3.5, 6.0, "Mixed scripts: 日本語, العربية, עברית" },
+		{ 6.5, 9.5, "<span foreground=\"#ffcc00\">Subtitles</span> burned in<br>without a PNG in between" },
+	};
+}
+
+// The cue on screen at a time and its opacity, fading in and out at the edges
+const Cue* findCue( const std::vector<Cue> &cues, double time, float &opacity )
+{
+	for( const Cue &cue : cues ) {
+		if( ( time >= cue.start ) && ( time < cue.end ) ) {
+			const double fade = std::min( { ( time - cue.start ) / kFadeSeconds, ( cue.end - time ) / kFadeSeconds, 1.0 } );
+			opacity = static_cast<float>( fade );
+			return &cue;
+		}
+	}
+	return nullptr;
+}
+
+void printUsage( const char *executable )
+{
+	std::fprintf( stderr,
+		"Usage: %s <width> <height> [--fps <rate>] [--seconds <duration>] [--format <bgra|a8>] [--cues <file>] [--size <points>]\n"
+		"       %*s [--font <file>]... [--out <file, default stdout>] [--realtime]\n",
+		executable, static_cast<int>( std::strlen( executable ) ), "" );
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	int width = 0;
+	int height = 0;
+	double fps = 30.0;
+	double seconds = -1.0;
+	float textSize = 36.0f;
+	FrameFormat format = FrameFormat::BGRA;
+	std::string cuesPath;
+	std::string outputPath;
+	std::vector<std::string> fontPaths;
+	bool realtime = false;
+
+	for( int i = 1; i < argc; i++ ) {
+		if( ( std::strcmp( argv[ i ], "--fps" ) == 0 ) && ( i + 1 < argc ) ) {
+			fps = std::atof( argv[ ++i ] );
+		} else if( ( std::strcmp( argv[ i ], "--seconds" ) == 0 ) && ( i + 1 < argc ) ) {
+			seconds = std::atof( argv[ ++i ] );
+		} else if( ( std::strcmp( argv[ i ], "--size" ) == 0 ) && ( i + 1 < argc ) ) {
+			textSize = static_cast<float>( std::atof( argv[ ++i ] ) );
+		} else if( ( std::strcmp( argv[ i ], "--format" ) == 0 ) && ( i + 1 < argc ) ) {
+			const std::string name = argv[ ++i ];
+			if( ( name != "bgra" ) && ( name != "a8" ) ) {
+				printUsage( argv[ 0 ] );
+				return 1;
+			}
+			format = ( name == "a8" ) ? FrameFormat::A8 : FrameFormat::BGRA;
+		} else if( ( std::strcmp( argv[ i ], "--cues" ) == 0 ) && ( i + 1 < argc ) ) {
+			cuesPath = argv[ ++i ];
+		} else if( ( std::strcmp( argv[ i ], "--font" ) == 0 ) && ( i + 1 < argc ) ) {
+			fontPaths.push_back( argv[ ++i ] );
+		} else if( ( std::strcmp( argv[ i ], "--out" ) == 0 ) && ( i + 1 < argc ) ) {
+			outputPath = argv[ ++i ];
+		} else if( std::strcmp( argv[ i ], "--realtime" ) == 0 ) {
+			realtime = true;
+		} else if( ( width == 0 ) && ( std::atoi( argv[ i ] ) > 0 ) ) {
+			width = std::atoi( argv[ i ] );
+		} else if( ( height == 0 ) && ( std::atoi( argv[ i ] ) > 0 ) ) {
+			height = std::atoi( argv[ i ] );
+		} else {
+			printUsage( argv[ 0 ] );
+			return 1;
+		}
+	}
+
+	if( ( width == 0 ) || ( height == 0 ) || ( fps <= 0.0 ) ) {
+		printUsage( argv[ 0 ] );
+		return 1;
+	}
+
+	std::vector<Cue> cues;
+	if( cuesPath.empty() ) {
+		cues = createDemoCues();
+	} else if( ! readCues( cuesPath, cues ) ) {
+		return 1;
+	}
+
+	if( seconds < 0.0 ) {
+		seconds = cues.empty() ? 0.0 : std::max_element( cues.begin(), cues.end(), []( const Cue &a, const Cue &b ) { return a.end < b.end; } )->end + 0.5;
+	}
+
+	int fileDescriptor = 1;
+	if( ! outputPath.empty() ) {
+		fileDescriptor = open( outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+		if( fileDescriptor < 0 ) {
+			std::fprintf( stderr, "Could not open %s for writing\n", outputPath.c_str() );
+			return 1;
+		}
+	}
+
+	// A consumer that goes away should fail the write, not kill the process
+	std::signal( SIGPIPE, SIG_IGN );
+
+	CinderPangoCore::setTextRenderer( TextRenderer::FREETYPE );
+	for( const std::string &fontPath : fontPaths ) {
+		CinderPangoCore::loadFont( fontPath );
+	}
+
+	// A fixed size surface, so every tick reuses it and the frame copy is a straight row copy
+	CinderPangoCoreRef pango = CinderPangoCore::create();
+	pango->setSurfaceFlipped( false );
+	pango->setMinSize( width, height );
+	pango->setMaxSize( width, height );
+	pango->setDefaultTextSize( textSize );
+	pango->setTextAlignment( TextAlignment::CENTER );
+	pango->setBackgroundColor( ci::ColorA::zero() );
+
+	FrameStreamRef stream = FrameStream::create( fileDescriptor, width, height, format );
+
+	const int frameCount = static_cast<int>( seconds * fps );
+	const auto start = std::chrono::steady_clock::now();
+	const Cue *lastCue = nullptr;
+	int renderedFrames = 0;
+	bool ok = true;
+
+	for( int frame = 0; ( frame < frameCount ) && ok; frame++ ) {
+		const double time = frame / fps;
+
+		// Only the cue changes relayout, fades are color changes
+		float opacity = 0.0f;
+		const Cue *cue = findCue( cues, time, opacity );
+		if( cue != lastCue ) {
+			pango->setText( cue ? cue->text : "" );
+			lastCue = cue;
+		}
+		pango->setDefaultTextColor( ci::ColorA( 1.0f, 1.0f, 1.0f, opacity ) );
+
+		if( pango->render() ) {
+			renderedFrames++;
+		}
+		ok = stream->writeFrame( *pango );
+
+		if( realtime ) {
+			std::this_thread::sleep_until( start + std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( ( frame + 1 ) / fps ) ) );
+		}
+	}
+
+	stream->finish();
+	const double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	if( fileDescriptor != 1 ) {
+		close( fileDescriptor );
+	}
+
+	std::fprintf( stderr, "Wrote %llu of %d frames (%d rendered, the rest reused) at %dx%d in %.2f s: %.1f fps, %.2f s waiting on the consumer\n",
+		static_cast<unsigned long long>( stream->getFramesWritten() ), frameCount, renderedFrames, width, height, elapsed,
+		( elapsed > 0.0 ) ? stream->getFramesWritten() / elapsed : 0.0, stream->getStallSeconds() );
+
+	if( stream->hasFailed() ) {
+		std::fprintf( stderr, "Writing frames failed, did the consumer exit?\n" );
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,359 @@
+// CinderPangoAttributes.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoAttributes.h"
+#include "CinderPangoCore.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace kp::pango;
+using namespace ci;
+
+namespace {
+
+guint16 toPangoColor( float channel )
+{
+	return static_cast<guint16>( glm::clamp( channel, 0.0f, 1.0f ) * 65535.0f + 0.5f );
+}
+
+bool isColorAttribute( const PangoAttribute *attribute )
+{
+	const PangoAttrType type = attribute->klass->type;
+	return ( type == PANGO_ATTR_FOREGROUND ) || ( type == PANGO_ATTR_BACKGROUND ) || ( type == PANGO_ATTR_UNDERLINE_COLOR ) || ( type == PANGO_ATTR_STRIKETHROUGH_COLOR );
+}
+
+// All runs of a layout, in logical order
+void getRuns( PangoLayout *layout, std::vector<PangoGlyphItem *> &runs )
+{
+	runs.clear();
+	for( GSList *lineNode = pango_layout_get_lines_readonly( layout ); lineNode; lineNode = lineNode->next ) {
+		PangoLayoutLine *line = static_cast<PangoLayoutLine *>( lineNode->data );
+		for( GSList *runNode = line->runs; runNode; runNode = runNode->next ) {
+			runs.push_back( static_cast<PangoGlyphItem *>( runNode->data ) );
+		}
+	}
+
+	std::sort( runs.begin(), runs.end(), []( const PangoGlyphItem *a, const PangoGlyphItem *b ) { return a->item->offset < b->item->offset; } );
+}
+
+} // anonymous namespace
+
+TextAttributes& TextAttributes::color( size_t start, size_t end, const ColorA &color )
+{
+	return add( Type::COLOR, start, end, color, 0.0f );
+}
+
+TextAttributes& TextAttributes::backgroundColor( size_t start, size_t end, const ColorA &color )
+{
+	return add( Type::BACKGROUND_COLOR, start, end, color, 0.0f );
+}
+
+TextAttributes& TextAttributes::weight( size_t start, size_t end, TextWeight weight )
+{
+	return add( Type::WEIGHT, start, end, ColorA::zero(), static_cast<float>( weight ) );
+}
+
+TextAttributes& TextAttributes::size( size_t start, size_t end, float size )
+{
+	return add( Type::SIZE, start, end, ColorA::zero(), size );
+}
+
+TextAttributes& TextAttributes::letterSpacing( size_t start, size_t end, float spacing )
+{
+	return add( Type::LETTER_SPACING, start, end, ColorA::zero(), spacing );
+}
+
+TextAttributes& TextAttributes::underline( size_t start, size_t end, TextUnderline underline )
+{
+	return add( Type::UNDERLINE, start, end, ColorA::zero(), static_cast<float>( underline ) );
+}
+
+TextAttributes& TextAttributes::underlineColor( size_t start, size_t end, const ColorA &color )
+{
+	return add( Type::UNDERLINE_COLOR, start, end, color, 0.0f );
+}
+
+TextAttributes& TextAttributes::font( size_t start, size_t end, const std::string &family )
+{
+	return add( Type::FONT, start, end, ColorA::zero(), 0.0f, family );
+}
+
+TextAttributes& TextAttributes::axes( size_t start, size_t end, const std::string &family, const FontAxes &axes )
+{
+	return font( start, end, FontVariations::resolve( family, axes ) );
+}
+
+TextAttributes& TextAttributes::add( Type type, size_t start, size_t end, const ColorA &color, float value, const std::string &family )
+{
+	Span span;
+	span.type = type;
+	span.start = start;
+	span.end = end;
+	span.color = color;
+	span.value = value;
+	span.family = family;
+	mSpans.push_back( span );
+	return *this;
+}
+
+void TextAttributes::applyTo( PangoLayout *layout, bool merge ) const
+{
+	if( merge && mSpans.empty() ) {
+		return;
+	}
+
+	PangoAttrList *currentList = merge ? pango_layout_get_attributes( layout ) : nullptr;
+	PangoAttrList *attributeList = currentList ? pango_attr_list_copy( currentList ) : pango_attr_list_new();
+
+	for( const Span &span : mSpans ) {
+		// pango_attr_list_insert keeps insertion order for equal start indices, so later spans win
+		pango_attr_list_insert( attributeList, createPangoAttribute( span ) );
+	}
+
+	pango_layout_set_attributes( layout, attributeList );
+	pango_attr_list_unref( attributeList );
+}
+
+PangoAttribute* TextAttributes::createPangoAttribute( const Span &span )
+{
+	PangoAttribute *attribute = nullptr;
+
+	// Pango 1.36 has no alpha attributes, so the alpha of span colors is ignored
+	switch( span.type ) {
+		case Type::COLOR:
+			attribute = pango_attr_foreground_new( toPangoColor( span.color.r ), toPangoColor( span.color.g ), toPangoColor( span.color.b ) );
+			break;
+		case Type::BACKGROUND_COLOR:
+			attribute = pango_attr_background_new( toPangoColor( span.color.r ), toPangoColor( span.color.g ), toPangoColor( span.color.b ) );
+			break;
+		case Type::WEIGHT:
+			attribute = pango_attr_weight_new( static_cast<PangoWeight>( static_cast<int>( span.value ) ) );
+			break;
+		case Type::SIZE:
+			attribute = pango_attr_size_new( static_cast<int>( span.value * PANGO_SCALE ) );
+			break;
+		case Type::LETTER_SPACING:
+			attribute = pango_attr_letter_spacing_new( static_cast<int>( span.value * PANGO_SCALE ) );
+			break;
+		case Type::UNDERLINE:
+			attribute = pango_attr_underline_new( static_cast<PangoUnderline>( static_cast<int>( span.value ) ) );
+			break;
+		case Type::UNDERLINE_COLOR:
+			attribute = pango_attr_underline_color_new( toPangoColor( span.color.r ), toPangoColor( span.color.g ), toPangoColor( span.color.b ) );
+			break;
+		case Type::FONT:
+			attribute = pango_attr_family_new( span.family.c_str() );
+			break;
+	}
+
+	attribute->start_index = static_cast<guint>( span.start );
+	attribute->end_index = static_cast<guint>( span.end );
+	return attribute;
+}
+
+bool TextAttributes::differOnlyInColor( const TextAttributes &a, const TextAttributes &b, RangeList *changedRanges )
+{
+	// Everything but colors has to match span for span, in the same order since order decides precedence
+	auto nextNonColor = []( const std::vector<Span> &spans, size_t i ) {
+		while( ( i < spans.size() ) && spans[ i ].isColor() ) {
+			i++;
+		}
+		return i;
+	};
+
+	size_t i = nextNonColor( a.mSpans, 0 );
+	size_t j = nextNonColor( b.mSpans, 0 );
+	while( ( i < a.mSpans.size() ) && ( j < b.mSpans.size() ) ) {
+		if( ! ( a.mSpans[ i ] == b.mSpans[ j ] ) ) {
+			return false;
+		}
+		i = nextNonColor( a.mSpans, i + 1 );
+		j = nextNonColor( b.mSpans, j + 1 );
+	}
+
+	if( ( i < a.mSpans.size() ) || ( j < b.mSpans.size() ) ) {
+		return false;
+	}
+
+	// Color spans are compared in order too, a later span wins where it overlaps an earlier one. Past the common start
+	// and end, spans at the same position that differ mark where pixels may change. If the counts differ in between,
+	// everything in between does.
+	std::vector<const Span *> colorsA;
+	std::vector<const Span *> colorsB;
+	for( const Span &span : a.mSpans ) {
+		if( span.isColor() ) {
+			colorsA.push_back( &span );
+		}
+	}
+	for( const Span &span : b.mSpans ) {
+		if( span.isColor() ) {
+			colorsB.push_back( &span );
+		}
+	}
+
+	size_t first = 0;
+	while( ( first < colorsA.size() ) && ( first < colorsB.size() ) && ( *colorsA[ first ] == *colorsB[ first ] ) ) {
+		first++;
+	}
+	size_t endA = colorsA.size();
+	size_t endB = colorsB.size();
+	while( ( endA > first ) && ( endB > first ) && ( *colorsA[ endA - 1 ] == *colorsB[ endB - 1 ] ) ) {
+		endA--;
+		endB--;
+	}
+
+	const bool aligned = ( endA - first ) == ( endB - first );
+	for( size_t k = first; k < std::max( endA, endB ); k++ ) {
+		const Span *spanA = ( k < endA ) ? colorsA[ k ] : nullptr;
+		const Span *spanB = ( k < endB ) ? colorsB[ k ] : nullptr;
+		if( aligned && ( *spanA == *spanB ) ) {
+			continue;
+		}
+		if( spanA ) {
+			changedRanges->emplace_back( spanA->start, spanA->end );
+		}
+		if( spanB ) {
+			changedRanges->emplace_back( spanB->start, spanB->end );
+		}
+	}
+	return true;
+}
+
+bool TextAttributes::recolorLayout( PangoLayout *layout, PangoAttrList *baseAttributes, RecolorScratch &scratch ) const
+{
+	std::vector<PangoGlyphItem *> &runs = scratch.runs;
+	getRuns( layout, runs );
+
+	// Each color span has to start and end on run boundaries, otherwise a run would need two colors
+	std::vector<size_t> &boundaries = scratch.boundaries;
+	boundaries.clear();
+	boundaries.push_back( 0 );
+	for( const PangoGlyphItem *run : runs ) {
+		boundaries.push_back( run->item->offset + run->item->length );
+	}
+	std::sort( boundaries.begin(), boundaries.end() );
+
+	const size_t textEnd = boundaries.back();
+	for( const Span &span : mSpans ) {
+		if( span.isColor() ) {
+			for( size_t offset : { span.start, span.end } ) {
+				if( ( offset < textEnd ) && ! std::binary_search( boundaries.begin(), boundaries.end(), offset ) ) {
+					return false;
+				}
+			}
+		}
+	}
+
+	// Resolve the colors for each run from the same attribute stack a full layout would see
+	PangoAttrList *attributeList = baseAttributes ? pango_attr_list_copy( baseAttributes ) : pango_attr_list_new();
+	for( const Span &span : mSpans ) {
+		if( span.isColor() ) {
+			pango_attr_list_insert( attributeList, createPangoAttribute( span ) );
+		}
+	}
+
+	PangoAttrIterator *iterator = pango_attr_list_get_iterator( attributeList );
+
+	for( PangoGlyphItem *run : runs ) {
+		gint rangeStart = 0;
+		gint rangeEnd = 0;
+		pango_attr_iterator_range( iterator, &rangeStart, &rangeEnd );
+		while( rangeEnd <= run->item->offset && pango_attr_iterator_next( iterator ) ) {
+			pango_attr_iterator_range( iterator, &rangeStart, &rangeEnd );
+		}
+
+		// Non-shaping attributes live in each item's extra_attrs, swap out the color ones
+		PangoAnalysis &analysis = run->item->analysis;
+		GSList *node = analysis.extra_attrs;
+		while( node ) {
+			GSList *next = node->next;
+			PangoAttribute *attribute = static_cast<PangoAttribute *>( node->data );
+			if( isColorAttribute( attribute ) ) {
+				pango_attribute_destroy( attribute );
+				analysis.extra_attrs = g_slist_delete_link( analysis.extra_attrs, node );
+			}
+			node = next;
+		}
+
+		GSList *activeAttributes = pango_attr_iterator_get_attrs( iterator );
+		for( GSList *activeNode = activeAttributes; activeNode; activeNode = activeNode->next ) {
+			PangoAttribute *attribute = static_cast<PangoAttribute *>( activeNode->data );
+			if( isColorAttribute( attribute ) ) {
+				analysis.extra_attrs = g_slist_prepend( analysis.extra_attrs, attribute );
+			} else {
+				pango_attribute_destroy( attribute );
+			}
+		}
+		g_slist_free( activeAttributes );
+	}
+
+	pango_attr_iterator_destroy( iterator );
+	pango_attr_list_unref( attributeList );
+	return true;
+}
+
+Rectf TextAttributes::getRangeBounds( PangoLayout *layout, const RangeList &ranges )
+{
+	bool empty = true;
+	PangoRectangle bounds = { 0, 0, 0, 0 };
+
+	auto include = [&]( const PangoRectangle &rect ) {
+		if( rect.width <= 0 || rect.height <= 0 ) {
+			return;
+		}
+
+		if( empty ) {
+			bounds = rect;
+			empty = false;
+		} else {
+			const int x1 = std::max( bounds.x + bounds.width, rect.x + rect.width );
+			const int y1 = std::max( bounds.y + bounds.height, rect.y + rect.height );
+			bounds.x = std::min( bounds.x, rect.x );
+			bounds.y = std::min( bounds.y, rect.y );
+			bounds.width = x1 - bounds.x;
+			bounds.height = y1 - bounds.y;
+		}
+	};
+
+	PangoLayoutIter *iter = pango_layout_get_iter( layout );
+	do {
+		PangoLayoutRun *run = pango_layout_iter_get_run_readonly( iter );
+		if( ! run ) {
+			continue;
+		}
+
+		const size_t runStart = run->item->offset;
+		const size_t runEnd = runStart + run->item->length;
+		for( const auto &range : ranges ) {
+			if( ( range.first < runEnd ) && ( range.second > runStart ) ) {
+				PangoRectangle inkRect;
+				PangoRectangle logicalRect;
+				pango_layout_iter_get_run_extents( iter, &inkRect, &logicalRect );
+				include( inkRect );
+				include( logicalRect );
+				break;
+			}
+		}
+	} while( pango_layout_iter_next_run( iter ) );
+	pango_layout_iter_free( iter );
+
+	if( empty ) {
+		return Rectf( 0, 0, 0, 0 );
+	}
+
+	// Round out to whole pixels, with a pixel of slack for antialiasing
+	return Rectf( std::floor( bounds.x / static_cast<float>( PANGO_SCALE ) ) - 1.0f, std::floor( bounds.y / static_cast<float>( PANGO_SCALE ) ) - 1.0f,
+		std::ceil( ( bounds.x + bounds.width ) / static_cast<float>( PANGO_SCALE ) ) + 1.0f, std::ceil( ( bounds.y + bounds.height ) / static_cast<float>( PANGO_SCALE ) ) + 1.0f );
+}
+
+bool TextAttributes::operator==( const TextAttributes &rhs ) const
+{
+	return mSpans == rhs.mSpans;
+}
+
+bool TextAttributes::Span::operator==( const Span &rhs ) const
+{
+	return ( type == rhs.type ) && ( start == rhs.start ) && ( end == rhs.end ) && ( color == rhs.color ) && ( value == rhs.value ) && ( family == rhs.family );
+}
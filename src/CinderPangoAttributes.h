@@ -0,0 +1,108 @@
+// CinderPangoAttributes.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPangoTypes.h"
+#include "CinderPangoVariations.h"
+
+#include <pango/pango.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kp { namespace pango {
+
+enum class TextWeight : int;
+
+enum class TextUnderline : int {
+	NONE = PANGO_UNDERLINE_NONE,
+	SINGLE = PANGO_UNDERLINE_SINGLE,
+	DOUBLE = PANGO_UNDERLINE_DOUBLE,
+	LOW = PANGO_UNDERLINE_LOW,
+	ERROR = PANGO_UNDERLINE_ERROR,
+};
+
+// Typed per-range styling, an alternative to generating markup strings for Pango to parse again.
+// Ranges are byte offsets into the text as displayed (i.e. after any markup has been stripped), end is exclusive.
+// Spans added later win over earlier ones and over inline markup where they overlap.
+class TextAttributes {
+  public:
+	TextAttributes& color( size_t start, size_t end, const ci::ColorA &color );
+	TextAttributes& backgroundColor( size_t start, size_t end, const ci::ColorA &color );
+	TextAttributes& weight( size_t start, size_t end, TextWeight weight );
+	TextAttributes& size( size_t start, size_t end, float size );
+	TextAttributes& letterSpacing( size_t start, size_t end, float spacing );
+	TextAttributes& underline( size_t start, size_t end, TextUnderline underline );
+	TextAttributes& underlineColor( size_t start, size_t end, const ci::ColorA &color );
+	TextAttributes& font( size_t start, size_t end, const std::string &family );
+	// A variable family at the given axis values, the instance family from FontVariations as a font span. Spans built from
+	// values within the same quantization step compare equal, so re-applying them every frame doesn't relayout. While
+	// FontVariations defers new instances the span gets the plain family, build it again later.
+	TextAttributes& axes( size_t start, size_t end, const std::string &family, const FontAxes &axes );
+
+	void clear() { mSpans.clear(); }
+	bool isEmpty() const { return mSpans.empty(); }
+
+	// Sets the spans as the layout's attributes. When merging, they're added on top of the layout's
+	// current attributes (e.g. the ones pango_layout_set_markup just parsed), otherwise those are replaced.
+	void applyTo( PangoLayout *layout, bool merge ) const;
+
+	// Byte ranges, end exclusive
+	using RangeList = std::vector<std::pair<size_t, size_t>>;
+
+	// True if the two sets only differ in color spans (text, background and underline color), which don't affect
+	// shaping or line breaks. The ranges where colors may have changed are appended to changedRanges.
+	static bool differOnlyInColor( const TextAttributes &a, const TextAttributes &b, RangeList *changedRanges );
+
+	// Working memory for recolorLayout, kept by the caller so repeated recolors stop allocating once it has grown
+	struct RecolorScratch {
+		std::vector<PangoGlyphItem *> runs;
+		std::vector<size_t> boundaries;
+	};
+
+	// Rewrites the color attributes of an already laid out layout's runs in place, keeping its lines.
+	// baseAttributes are the attributes the spans were merged onto (e.g. parsed markup), may be null.
+	// Returns false, leaving the layout untouched, if a color span boundary falls inside a run, in which
+	// case the layout has to be redone to split the run.
+	bool recolorLayout( PangoLayout *layout, PangoAttrList *baseAttributes, RecolorScratch &scratch ) const;
+
+	// Bounds of the runs overlapping any of the ranges, ink included, in layout pixels
+	static ci::Rectf getRangeBounds( PangoLayout *layout, const RangeList &ranges );
+
+	bool operator==( const TextAttributes &rhs ) const;
+	bool operator!=( const TextAttributes &rhs ) const { return ! ( *this == rhs ); }
+
+  private:
+	enum class Type {
+		COLOR,
+		BACKGROUND_COLOR,
+		WEIGHT,
+		SIZE,
+		LETTER_SPACING,
+		UNDERLINE,
+		UNDERLINE_COLOR,
+		FONT,
+	};
+
+	struct Span {
+		Type type;
+		size_t start;
+		size_t end;
+		ci::ColorA color;
+		float value;
+		std::string family;
+
+		bool isColor() const { return ( type == Type::COLOR ) || ( type == Type::BACKGROUND_COLOR ) || ( type == Type::UNDERLINE_COLOR ); }
+		bool operator==( const Span &rhs ) const;
+	};
+
+	TextAttributes& add( Type type, size_t start, size_t end, const ci::ColorA &color, float value, const std::string &family = std::string() );
+	static PangoAttribute* createPangoAttribute( const Span &span );
+
+	std::vector<Span> mSpans;
+};
+
+}} // namespace kp::pango
@@ -0,0 +1,1339 @@
+// CinderPangoCore.cpp
+// PangoBasic
+//
+// Created by Eric Mika on 1/6/16.
+//
+
+#include "CinderPangoCore.h"
+#include "CinderPangoFallback.h"
+#include "CinderPangoFreeType.h"
+#include "CinderPangoInternal.h"
+#include "CinderPangoLedger.h"
+#include "CinderPangoMetrics.h"
+#include "CinderPangoTrace.h"
+#include "CinderPangoWarmUp.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#if CAIRO_HAS_WIN32_SURFACE
+#include <cairo-win32.h>
+#endif
+
+using namespace kp::pango;
+using namespace kp::pango::detail;
+using namespace ci;
+
+void kp::pango::detail::applyFontOptions( PangoContext *context, cairo_font_options_t *fontOptions, const TextQuality &quality )
+{
+	cairo_font_options_set_antialias( fontOptions, static_cast<cairo_antialias_t>( quality.antialias ) );
+	cairo_font_options_set_hint_style( fontOptions, static_cast<cairo_hint_style_t>( quality.hintStyle ) );
+	cairo_font_options_set_hint_metrics( fontOptions, static_cast<cairo_hint_metrics_t>( quality.hintMetrics ) );
+	cairo_font_options_set_subpixel_order( fontOptions, static_cast<cairo_subpixel_order_t>( quality.subpixelOrder ) );
+
+	// Copied into the context, which keys Pango's and Cairo's font caches by it
+	pango_cairo_context_set_font_options( context, fontOptions );
+}
+
+PangoFontDescription* kp::pango::detail::createFontDescription( const std::string &font, float size, TextWeight weight, bool italicsEnabled, bool smallCapsEnabled )
+{
+	// The family string may carry its own style words, parse it as is and set the size directly. Appending
+	// std::to_string( size ) allocated on every font update and broke in locales with a decimal comma.
+	PangoFontDescription *fontDescription = pango_font_description_from_string( font.c_str() );
+	pango_font_description_set_size( fontDescription, static_cast<gint>( size * PANGO_SCALE ) );
+	pango_font_description_set_weight( fontDescription, static_cast<PangoWeight>( weight ) );
+	pango_font_description_set_style( fontDescription, italicsEnabled ? PANGO_STYLE_ITALIC : PANGO_STYLE_NORMAL );
+	pango_font_description_set_variant( fontDescription, smallCapsEnabled ? PANGO_VARIANT_SMALL_CAPS : PANGO_VARIANT_NORMAL );
+	return ResourceLedger::track( Resource::FONT_DESCRIPTION, fontDescription );
+}
+
+void kp::pango::detail::applyAlignment( PangoLayout *layout, TextAlignment alignment )
+{
+	// Pango separates alignment and justification... I prefer a simpler API here to handling certain edge cases.
+	if( alignment == TextAlignment::JUSTIFY ) {
+		pango_layout_set_justify( layout, true );
+		pango_layout_set_alignment( layout, static_cast<PangoAlignment>( TextAlignment::LEFT ) );
+	} else {
+		pango_layout_set_justify( layout, false );
+		pango_layout_set_alignment( layout, static_cast<PangoAlignment>( alignment ) );
+	}
+}
+
+TextMetrics kp::pango::detail::getLayoutMetrics( PangoLayout *layout, const ivec2 &maxSize )
+{
+	PangoRectangle inkRect;
+	PangoRectangle logicalRect;
+	pango_layout_get_pixel_extents( layout, &inkRect, &logicalRect );
+
+	TextMetrics metrics;
+	metrics.logicalSize = ivec2( logicalRect.width, logicalRect.height );
+	metrics.inkSize = ivec2( inkRect.width, inkRect.height );
+	metrics.lineCount = pango_layout_get_line_count( layout );
+	metrics.baseline = PANGO_PIXELS( pango_layout_get_baseline( layout ) );
+	metrics.overflowed = ( logicalRect.width > maxSize.x ) || ( logicalRect.height > maxSize.y );
+	return metrics;
+}
+
+void kp::pango::detail::addLayoutFamilies( PangoLayout *layout, std::vector<std::string> &families )
+{
+	auto addFamilies = [&families]( const char *familyList ) {
+		if( ! familyList ) {
+			return;
+		}
+		gchar **names = g_strsplit( familyList, ",", -1 );
+		for( gchar **name = names; *name; name++ ) {
+			families.push_back( g_strstrip( *name ) );
+		}
+		g_strfreev( names );
+	};
+
+	if( const PangoFontDescription *fontDescription = pango_layout_get_font_description( layout ) ) {
+		addFamilies( pango_font_description_get_family( fontDescription ) );
+	}
+
+	if( PangoAttrList *attributes = pango_layout_get_attributes( layout ) ) {
+		PangoAttrIterator *iterator = pango_attr_list_get_iterator( attributes );
+		do {
+			GSList *spans = pango_attr_iterator_get_attrs( iterator );
+			for( GSList *span = spans; span; span = span->next ) {
+				const PangoAttribute *attribute = static_cast<const PangoAttribute *>( span->data );
+				if( attribute->klass->type == PANGO_ATTR_FAMILY ) {
+					addFamilies( reinterpret_cast<const PangoAttrString *>( attribute )->value );
+				} else if( attribute->klass->type == PANGO_ATTR_FONT_DESC ) {
+					addFamilies( pango_font_description_get_family( reinterpret_cast<const PangoAttrFontDesc *>( attribute )->desc ) );
+				}
+			}
+			g_slist_free_full( spans, reinterpret_cast<GDestroyNotify>( pango_attribute_destroy ) );
+		} while( pango_attr_iterator_next( iterator ) );
+		pango_attr_iterator_destroy( iterator );
+	}
+
+	PangoLayoutIter *iter = pango_layout_get_iter( layout );
+	do {
+		PangoLayoutRun *run = pango_layout_iter_get_run_readonly( iter );
+		if( run && run->item->analysis.font ) {
+			PangoFontDescription *fontDescription = pango_font_describe( run->item->analysis.font );
+			addFamilies( pango_font_description_get_family( fontDescription ) );
+			pango_font_description_free( fontDescription );
+		}
+	} while( pango_layout_iter_next_run( iter ) );
+	pango_layout_iter_free( iter );
+}
+
+namespace {
+
+// A layout and everything it needs, owned by one thread at a time during batch measurement.
+// Pango objects aren't thread safe, so each pooled layout gets its own font map and context.
+struct PooledLayout {
+	PangoFontMap *fontMap = nullptr;
+	PangoContext *context = nullptr;
+	PangoLayout *layout = nullptr;
+	PangoFontDescription *fontDescription = nullptr;
+	cairo_font_options_t *fontOptions = nullptr;
+	TextStyle lastStyle;
+	std::string processedText;
+	uint64_t fontChangeSerial = FontFallback::getChangeSerial();
+
+	PooledLayout()
+	{
+		fontMap = ResourceLedger::track( Resource::FONT_MAP, detail::createFontMap() );
+		context = ResourceLedger::track( Resource::PANGO_CONTEXT, pango_font_map_create_context( fontMap ) );
+		layout = ResourceLedger::track( Resource::LAYOUT, pango_layout_new( context ) );
+		fontOptions = ResourceLedger::track( Resource::FONT_OPTIONS, cairo_font_options_create() );
+		applyFontOptions( context, fontOptions, TextQuality() );
+	}
+
+	~PooledLayout()
+	{
+		if( fontDescription ) {
+			ResourceLedger::untrack( Resource::FONT_DESCRIPTION, fontDescription );
+			pango_font_description_free( fontDescription );
+		}
+		ResourceLedger::untrack( Resource::FONT_OPTIONS, fontOptions );
+		cairo_font_options_destroy( fontOptions );
+		ResourceLedger::untrack( Resource::LAYOUT, layout );
+		g_object_unref( layout );
+		ResourceLedger::untrack( Resource::PANGO_CONTEXT, context );
+		g_object_unref( context );
+		ResourceLedger::untrack( Resource::FONT_MAP, fontMap );
+		g_object_unref( fontMap );
+	}
+
+	TextMetrics measure( const MeasureJob &job )
+	{
+		const TextStyle &style = job.style;
+
+		// Every job lays out from scratch, dropping the fonts cached before the installed fonts changed is all it takes
+		const uint64_t serial = FontFallback::getChangeSerial();
+		if( serial != fontChangeSerial ) {
+			clearFontMapCache( fontMap );
+			pango_layout_context_changed( layout );
+			fontChangeSerial = serial;
+		}
+
+		// Consecutive jobs tend to share a style, so only rebuild the font options and description when they change
+		if( style.quality != lastStyle.quality ) {
+			applyFontOptions( context, fontOptions, style.quality );
+			pango_layout_context_changed( layout );
+			lastStyle.quality = style.quality;
+		}
+
+		if( ! fontDescription || ( style.font != lastStyle.font ) || ( style.size != lastStyle.size ) || ( style.weight != lastStyle.weight ) ||
+			( style.italicsEnabled != lastStyle.italicsEnabled ) || ( style.smallCapsEnabled != lastStyle.smallCapsEnabled ) ) {
+			if( fontDescription ) {
+				ResourceLedger::untrack( Resource::FONT_DESCRIPTION, fontDescription );
+				pango_font_description_free( fontDescription );
+			}
+
+			fontDescription = createFontDescription( style.font, style.size, style.weight, style.italicsEnabled, style.smallCapsEnabled );
+			pango_layout_set_font_description( layout, fontDescription );
+			lastStyle = style;
+		}
+
+		pango_layout_set_width( layout, job.maxSize.x * PANGO_SCALE );
+		pango_layout_set_height( layout, job.maxSize.y * PANGO_SCALE );
+		applyAlignment( layout, style.alignment );
+		pango_layout_set_spacing( layout, style.spacing * PANGO_SCALE );
+
+		if( MarkupPreprocessor::getDefault()->process( job.text, processedText ) ) {
+			pango_layout_set_markup( layout, processedText.c_str(), -1 );
+			Metrics::increment( Counter::SET_MARKUP_CALLS );
+		} else {
+			// set_text keeps the attributes the last markup job left on the pooled layout
+			pango_layout_set_attributes( layout, nullptr );
+			pango_layout_set_text( layout, processedText.c_str(), -1 );
+		}
+
+		return getLayoutMetrics( layout, job.maxSize );
+	}
+};
+
+class LayoutPool {
+  public:
+	std::unique_ptr<PooledLayout> acquire()
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( mLayouts.empty() ) {
+			Metrics::increment( Counter::LAYOUT_POOL_MISSES );
+			return std::unique_ptr<PooledLayout>( new PooledLayout() );
+		}
+
+		Metrics::increment( Counter::LAYOUT_POOL_HITS );
+		auto layout = std::move( mLayouts.back() );
+		mLayouts.pop_back();
+		return layout;
+	}
+
+	void release( std::unique_ptr<PooledLayout> layout )
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mLayouts.push_back( std::move( layout ) );
+	}
+
+  private:
+	std::mutex mMutex;
+	std::vector<std::unique_ptr<PooledLayout>> mLayouts;
+};
+
+LayoutPool& getLayoutPool()
+{
+	static LayoutPool pool;
+	return pool;
+}
+
+} // anonymous namespace
+
+CinderPangoCoreRef CinderPangoCore::create()
+{
+	return CinderPangoCoreRef( new CinderPangoCore() );
+}
+
+CinderPangoCore::CinderPangoCore() :
+	mText( "" ),
+	mProcessedText( "" ),
+	mProbablyHasMarkup( false ),
+	mMarkupPreprocessor( MarkupPreprocessor::getDefault() ),
+	mMinSize( ivec2( 0, 0 ) ),
+	mMaxSize( ivec2( 320, 240 ) ),
+	mDefaultTextFont( "Sans" ),
+	mDefaultTextItalicsEnabled( false ),
+	mDefaultTextSmallCapsEnabled( false ),
+	mDefaultTextColor( ColorA::black() ),
+	mBackgroundColor( ColorA::zero() ),
+	mDefaultTextSize( 12.0 ),
+	mTextAlignment( TextAlignment::LEFT ),
+	mDefaultTextWeight( TextWeight::NORMAL ),
+	mVariationsDeferred( false ),
+	mTextQuality(),
+	mSpacing( 0 ),
+	mNeedsFontUpdate( false ),
+	mNeedsMeasuring( false ),
+	mNeedsTextRender( false ),
+	mNeedsFontOptionUpdate( false ),
+	mNeedsMarkupDetection( false ),
+	mNeedsSurfaceResize( false ),
+	mNeedsLayoutIndexUpdate( false ),
+	mNeedsRecolor( false ),
+	mLayoutAttributesStale( false ),
+	mSurfaceFlipped( true ),
+	mPixelWidth( -1 ),
+	mPixelHeight( -1 ),
+	mNeedsPartialRender( false ),
+	mLayoutGeneration( 0 ),
+	mFontChangeSerial( FontFallback::getChangeSerial() ),
+	pFontMap( nullptr ),
+	pPangoContext( nullptr ),
+	pPangoLayout( nullptr ),
+	pFontDescription( nullptr ),
+	pMarkupAttributes( nullptr ),
+#ifdef CAIRO_HAS_WIN32_SURFACE
+    pCairoImageSurface( nullptr ),
+#endif
+    pCairoSurface( nullptr ),
+	pCairoContext( nullptr ),
+	pCairoFontOptions( nullptr )
+{
+	Metrics::increment( Counter::INSTANCES_ALIVE );
+	Metrics::increment( Counter::INSTANCES_CREATED );
+
+	pFontMap = FontFallback::acquireFontMap();		// Create Font Map for reuse, or share this thread's
+	if( ! pFontMap ) {
+		CI_LOG_E( "Cannot create the pango font map." );
+		return;
+	}
+
+	pPangoContext = ResourceLedger::track( Resource::PANGO_CONTEXT, pango_font_map_create_context( pFontMap ) ); 	// Create Pango Context for reuse
+	if( ! pPangoContext ) {
+		CI_LOG_E( "Cannot create the pango font context." );
+		return;
+	}
+
+	pPangoLayout = ResourceLedger::track( Resource::LAYOUT, pango_layout_new( pPangoContext ) );	// Create Pango Layout for reuse
+	if( ! pPangoLayout ) {
+		CI_LOG_E( "Cannot create the pango layout." );
+		return;
+	}
+
+	pCairoFontOptions = ResourceLedger::track( Resource::FONT_OPTIONS, cairo_font_options_create() );
+	if( ! pCairoFontOptions ) {
+		CI_LOG_E( "Cannot create Cairo font options." );
+		return;
+	}
+
+	// Generate the default font config
+	mNeedsFontOptionUpdate = true;
+	mNeedsFontUpdate = true;
+	render();
+}
+
+CinderPangoCore::~CinderPangoCore()
+{
+	Metrics::decrement( Counter::INSTANCES_ALIVE );
+
+	if( pCairoContext ) {
+		ResourceLedger::untrack( Resource::CAIRO_CONTEXT, pCairoContext );
+		cairo_destroy( pCairoContext );
+	}
+
+	// On Windows the image surface belongs to the win32 surface (cairo_win32_surface_get_image doesn't add a
+	// reference), destroying it instead of the surface itself crashed and leaked the DIB
+	if( pCairoSurface ) {
+		ResourceLedger::untrack( Resource::SURFACE, pCairoSurface );
+		cairo_surface_destroy( pCairoSurface );
+	}
+
+	if( pFontDescription ) {
+		ResourceLedger::untrack( Resource::FONT_DESCRIPTION, pFontDescription );
+		pango_font_description_free( pFontDescription );
+	}
+
+	if( pMarkupAttributes ) {
+		ResourceLedger::untrack( Resource::ATTRIBUTE_LIST, pMarkupAttributes );
+		pango_attr_list_unref( pMarkupAttributes );
+	}
+
+	if( pCairoFontOptions ) {
+		ResourceLedger::untrack( Resource::FONT_OPTIONS, pCairoFontOptions );
+		cairo_font_options_destroy( pCairoFontOptions );
+	}
+
+	// Dependents first: the layout holds the context, which holds the font map
+	if( pPangoLayout ) {
+		ResourceLedger::untrack( Resource::LAYOUT, pPangoLayout );
+		g_object_unref( pPangoLayout );
+	}
+
+	if( pPangoContext ) {
+		ResourceLedger::untrack( Resource::PANGO_CONTEXT, pPangoContext );
+		g_object_unref( pPangoContext );
+	}
+
+	FontFallback::releaseFontMap( pFontMap );
+}
+
+const std::string& CinderPangoCore::getText() const
+{
+	return mText;
+}
+
+void CinderPangoCore::setText( const std::string &text )
+{
+	if( text != mText ) {
+		mText = text;
+		mNeedsMarkupDetection = true;
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+	}
+}
+
+const TextAttributes& CinderPangoCore::getTextAttributes() const
+{
+	return mTextAttributes;
+}
+
+void CinderPangoCore::setTextAttributes( const TextAttributes &attributes )
+{
+	if( attributes != mTextAttributes ) {
+		// Color-only changes can keep the current lines, unless a relayout is coming anyway
+		if( ! mNeedsMeasuring && TextAttributes::differOnlyInColor( mTextAttributes, attributes, &mRecolorRanges ) ) {
+			mNeedsRecolor = true;
+		} else {
+			mNeedsMeasuring = true;
+			mNeedsTextRender = true;
+		}
+
+		mTextAttributes = attributes;
+	}
+}
+
+const MarkupPreprocessorRef& CinderPangoCore::getMarkupPreprocessor() const
+{
+	return mMarkupPreprocessor;
+}
+
+void CinderPangoCore::setMarkupPreprocessor( const MarkupPreprocessorRef &preprocessor )
+{
+	if( mMarkupPreprocessor != preprocessor ) {
+		mMarkupPreprocessor = preprocessor ? preprocessor : MarkupPreprocessor::getDefault();
+		mNeedsMarkupDetection = true;
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+	}
+}
+
+const unsigned char* CinderPangoCore::getPixels() const
+{
+	cairo_surface_t *surface = getCairoSurface();
+	return surface ? cairo_image_surface_get_data( surface ) : nullptr;
+}
+
+int CinderPangoCore::getPixelStride() const
+{
+	cairo_surface_t *surface = getCairoSurface();
+	return surface ? cairo_image_surface_get_stride( surface ) : 0;
+}
+
+void CinderPangoCore::setSurfaceFlipped( bool flipped )
+{
+	if( mSurfaceFlipped != flipped ) {
+		mSurfaceFlipped = flipped;
+		// The transform lives in the Cairo context, which comes with a new surface
+		mNeedsSurfaceResize = true;
+		mNeedsTextRender = true;
+	}
+}
+
+void CinderPangoCore::setDefaultTextStyle( const std::string &font, 
+									   float size, 
+									   const ColorA &color,
+									   TextWeight weight, 
+									   TextAlignment alignment )
+{
+	this->setDefaultTextFont( font );
+	this->setDefaultTextSize( size );
+	this->setDefaultTextColor( color );
+	this->setDefaultTextWeight( weight );
+	this->setTextAlignment( alignment );
+}
+
+TextWeight CinderPangoCore::getDefaultTextWeight() const
+{
+	return mDefaultTextWeight;
+}
+
+void CinderPangoCore::setDefaultTextWeight( TextWeight weight )
+{
+	if( mDefaultTextWeight != weight ) {
+		mDefaultTextWeight = weight;
+		mNeedsFontUpdate = true;
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+	}
+}
+
+const FontAxes& CinderPangoCore::getDefaultTextAxes() const
+{
+	return mDefaultTextAxes;
+}
+
+void CinderPangoCore::setDefaultTextAxes( const FontAxes &axes )
+{
+	if( mDefaultTextAxes != axes ) {
+		mDefaultTextAxes = axes;
+		// An animated axis mostly stays within a quantization step, and then the font doesn't change
+		if( resolveVariationFamilies() ) {
+			mNeedsFontUpdate = true;
+			mNeedsMeasuring = true;
+			mNeedsTextRender = true;
+		}
+	}
+}
+
+void CinderPangoCore::setDefaultTextAxis( const std::string &tag, float value )
+{
+	FontAxes axes = mDefaultTextAxes;
+	axes[ tag ] = value;
+	setDefaultTextAxes( axes );
+}
+
+bool CinderPangoCore::resolveVariationFamilies()
+{
+	std::string families;
+	if( ! mDefaultTextAxes.empty() ) {
+		PangoFontDescription *fontDescription = pango_font_description_from_string( mDefaultTextFont.c_str() );
+		const char *family = pango_font_description_get_family( fontDescription );
+		families = family ? family : "";
+		pango_font_description_free( fontDescription );
+
+		// Only the first family is the variable font, the rest stay as fallbacks
+		const size_t separator = families.find( ',' );
+		const std::string firstFamily = families.substr( 0, separator );
+		const std::string instance = FontVariations::resolve( firstFamily, mDefaultTextAxes, &mVariationsDeferred );
+		families = ( instance == firstFamily ) ? "" : instance + ( ( separator == std::string::npos ) ? "" : families.substr( separator ) );
+	} else {
+		mVariationsDeferred = false;
+	}
+
+	if( families == mDefaultTextVariationFamilies ) {
+		return false;
+	}
+	mDefaultTextVariationFamilies = families;
+	return true;
+}
+
+TextAlignment CinderPangoCore::getTextAlignment() const
+{
+	return mTextAlignment;
+}
+
+void CinderPangoCore::setTextAlignment( TextAlignment alignment )
+{
+	if( mTextAlignment != alignment ) {
+		mTextAlignment = alignment;
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+	}
+}
+
+float CinderPangoCore::getSpacing() const
+{
+	return mSpacing;
+}
+
+void CinderPangoCore::setSpacing( float spacing )
+{
+	if( mSpacing != spacing ) {
+		mSpacing = spacing;
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+	}
+}
+
+TextAntialias CinderPangoCore::getTextAntialias() const
+{
+	return mTextQuality.antialias;
+}
+
+void CinderPangoCore::setTextAntialias( TextAntialias mode )
+{
+	if( mTextQuality.antialias != mode ) {
+		mTextQuality.antialias = mode;
+		mNeedsFontOptionUpdate = true;
+		// TODO does this ever change metrics?
+		mNeedsTextRender = true;
+	}
+}
+
+const TextQuality& CinderPangoCore::getTextQuality() const
+{
+	return mTextQuality;
+}
+
+void CinderPangoCore::setTextQuality( const TextQuality &quality )
+{
+	if( mTextQuality != quality ) {
+		// Hinting changes advances, and hint metrics whether they're rounded
+		mNeedsMeasuring = mNeedsMeasuring || ( mTextQuality.hintStyle != quality.hintStyle ) || ( mTextQuality.hintMetrics != quality.hintMetrics );
+		mTextQuality = quality;
+		mNeedsFontOptionUpdate = true;
+		mNeedsTextRender = true;
+	}
+}
+
+ivec2 CinderPangoCore::getMinSize() const
+{
+	return mMinSize;
+}
+
+void CinderPangoCore::setMinSize( int minWidth, int minHeight )
+{
+	setMinSize( ivec2( minWidth, minHeight ) );
+}
+
+void CinderPangoCore::setMinSize( const ivec2 &minSize )
+{
+	if( mMinSize != minSize ) {
+		mMinSize = minSize;
+		mNeedsMeasuring = true;
+		// Might not need re-rendering
+	}
+}
+
+ivec2 CinderPangoCore::getMaxSize() const
+{
+	return mMaxSize;
+}
+
+void CinderPangoCore::setMaxSize( int maxWidth, int maxHeight )
+{
+	setMaxSize( ivec2( maxWidth, maxHeight ) );
+}
+
+void CinderPangoCore::setMaxSize( const ivec2 &maxSize )
+{
+	if( mMaxSize != maxSize ) {
+		mMaxSize = maxSize;
+		mNeedsMeasuring = true;
+		// Might not need re-rendering
+	}
+}
+
+const ColorA& CinderPangoCore::getDefaultTextColor() const
+{
+	return mDefaultTextColor;
+}
+
+void CinderPangoCore::setDefaultTextColor( const ColorA &color )
+{
+	if( mDefaultTextColor != color ) {
+		mDefaultTextColor = color;
+		mNeedsTextRender = true;
+	}
+}
+
+const ColorA& CinderPangoCore::getBackgroundColor() const
+{
+	return mBackgroundColor;
+}
+
+void CinderPangoCore::setBackgroundColor( const ColorA &color )
+{
+	if( mBackgroundColor != color ) {
+		mBackgroundColor = color;
+		mNeedsTextRender = true;
+	}
+}
+
+bool CinderPangoCore::getDefaultTextSmallCapsEnabled() const
+{
+	return mDefaultTextSmallCapsEnabled;
+}
+
+void CinderPangoCore::setDefaultTextSmallCapsEnabled( bool value )
+{
+	if( mDefaultTextSmallCapsEnabled != value ) {
+		mDefaultTextSmallCapsEnabled = value;
+		mNeedsFontUpdate = true;
+		mNeedsMeasuring = true;
+	}
+}
+
+bool CinderPangoCore::getDefaultTextItalicsEnabled() const
+{
+	return mDefaultTextItalicsEnabled;
+}
+
+void CinderPangoCore::setDefaultTextItalicsEnabled( bool value )
+{
+	if( mDefaultTextItalicsEnabled != value ) {
+		mDefaultTextItalicsEnabled = value;
+		mNeedsFontUpdate = true;
+		mNeedsMeasuring = true;
+	}
+}
+
+float CinderPangoCore::getDefaultTextSize() const
+{
+	return mDefaultTextSize;
+}
+
+void CinderPangoCore::setDefaultTextSize( float size )
+{
+	if( mDefaultTextSize != size ) {
+		mDefaultTextSize = size;
+		mNeedsFontUpdate = true;
+		mNeedsMeasuring = true;
+	}
+}
+
+const std::string& CinderPangoCore::getDefaultTextFont() const
+{
+	return mDefaultTextFont;
+}
+
+void CinderPangoCore::setDefaultTextFont( const std::string &font )
+{
+	if( mDefaultTextFont != font ) {
+		mDefaultTextFont = font;
+		resolveVariationFamilies();
+		mNeedsFontUpdate = true;
+		mNeedsMeasuring = true;
+	}
+}
+
+TextMetrics CinderPangoCore::measure()
+{
+	checkFontChanges();
+	updateMarkup( false );
+	updateFontOptions( false );
+	updateFont( false );
+	updateLayout( false );
+	return mMetrics;
+}
+
+int CinderPangoCore::hitTest( const vec2 &position, int *trailing )
+{
+	updateLayoutIndex();
+
+	return mLayoutIndex.hitTest( position, trailing );
+}
+
+Rectf CinderPangoCore::getCaretRect( int charIndex )
+{
+	updateLayoutIndex();
+
+	return mLayoutIndex.getCaretRect( charIndex );
+}
+
+FitResult CinderPangoCore::fitTextSize( float minSize, float maxSize, float precision )
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	if( minSize > maxSize ) {
+		CI_LOG_E( "fitTextSize called with a min size of " << minSize << " above the max size of " << maxSize << ", swapping them." );
+		std::swap( minSize, maxSize );
+	}
+	// Below what a font description can hold the search would never narrow down
+	precision = std::max( precision, 1.0f / PANGO_SCALE );
+
+	// Get text, options and layout parameters up to date at the current size
+	measure();
+
+	PangoFontDescription *probeDescription = ResourceLedger::track( Resource::FONT_DESCRIPTION, pango_font_description_copy( pFontDescription ) );
+
+	FitResult result;
+	auto fitsAtSize = [&]( float size ) {
+		pango_font_description_set_size( probeDescription, static_cast<gint>( size * PANGO_SCALE ) );
+		pango_layout_set_font_description( pPangoLayout, probeDescription );
+		result.iterations++;
+
+		int width = 0;
+		int height = 0;
+		pango_layout_get_pixel_size( pPangoLayout, &width, &height );
+		return ( width <= mMaxSize.x ) && ( height <= mMaxSize.y );
+	};
+
+	if( fitsAtSize( maxSize ) ) {
+		result.size = maxSize;
+		result.fits = true;
+	} else if( ! fitsAtSize( minSize ) ) {
+		result.size = minSize;
+	} else {
+		// Invariant: low fits, high doesn't
+		float low = minSize;
+		float high = maxSize;
+		while( ( high - low ) > precision ) {
+			const float mid = ( low + high ) * 0.5f;
+			if( ( mid <= low ) || ( mid >= high ) ) {
+				// No float between them, e.g. for huge sizes
+				break;
+			}
+			if( fitsAtSize( mid ) ) {
+				low = mid;
+			} else {
+				high = mid;
+			}
+		}
+		result.size = low;
+		result.fits = true;
+	}
+
+	ResourceLedger::untrack( Resource::FONT_DESCRIPTION, probeDescription );
+	pango_font_description_free( probeDescription );
+
+	// Put the real description back, the layout has to be redone at the chosen size either way
+	pango_layout_set_font_description( pPangoLayout, pFontDescription );
+	setDefaultTextSize( result.size );
+	mNeedsMeasuring = true;
+	mNeedsTextRender = true;
+	render();
+
+	result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+	return result;
+}
+
+PangoLayout* CinderPangoCore::getPangoLayout( bool currentAttributes )
+{
+	// In place recolors only touch the glyph runs, laying out again brings the attribute list up to date
+	if( currentAttributes && ( mLayoutAttributesStale || mNeedsRecolor ) ) {
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+	}
+
+	measure();
+	return pPangoLayout;
+}
+
+const LayoutIndex& CinderPangoCore::getLayoutIndex()
+{
+	updateLayoutIndex();
+	return mLayoutIndex;
+}
+
+void CinderPangoCore::updateColors()
+{
+	if( ! mNeedsRecolor ) {
+		return;
+	}
+
+	if( mTextAttributes.recolorLayout( pPangoLayout, pMarkupAttributes, mRecolorScratch ) ) {
+		const Rectf bounds = TextAttributes::getRangeBounds( pPangoLayout, mRecolorRanges );
+		if( mNeedsPartialRender ) {
+			// Several recolors since the last render
+			mPartialRenderBounds.include( bounds );
+		} else {
+			mPartialRenderBounds = bounds;
+		}
+		mNeedsPartialRender = true;
+		mLayoutAttributesStale = true;
+	} else {
+		// A color boundary falls inside a run, only a new layout can split it
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+		updateLayout( false );
+	}
+
+	mNeedsRecolor = false;
+	mRecolorRanges.clear();
+}
+
+void CinderPangoCore::updateLayoutIndex()
+{
+	measure();
+
+	if( mNeedsLayoutIndexUpdate ) {
+		mLayoutIndex.build( pPangoLayout );
+		mNeedsLayoutIndexUpdate = false;
+	}
+}
+
+void CinderPangoCore::updateMarkup( bool force )
+{
+	if( force || mNeedsMarkupDetection ) {
+		// Line breaks, custom tags, and deciding whether the markup parser is needed at all, in one pass.
+		// Faster to use pango_layout_set_text than pango_layout_set_markup later on if there's no markup to bother with.
+		mProbablyHasMarkup = mMarkupPreprocessor->process( mText, mProcessedText );
+		mNeedsMarkupDetection = false;
+	}
+}
+
+void CinderPangoCore::updateFontOptions( bool force )
+{
+	// First run, and then if the fonts change
+	if( force || mNeedsFontOptionUpdate ) {
+		// Changing the context makes Pango lay out again from the layout's attribute list, which misses in place recolors
+		if( mLayoutAttributesStale ) {
+			mNeedsMeasuring = true;
+		}
+
+		applyFontOptions( pPangoContext, pCairoFontOptions, mTextQuality );
+		mNeedsFontOptionUpdate = false;
+	}
+}
+
+void CinderPangoCore::updateFont( bool force )
+{
+	if( force || mNeedsFontUpdate ) {
+		if( pFontDescription != nullptr ) {
+			ResourceLedger::untrack( Resource::FONT_DESCRIPTION, pFontDescription );
+			pango_font_description_free( pFontDescription );
+		}
+
+		pFontDescription = createFontDescription( mDefaultTextFont, mDefaultTextSize, mDefaultTextWeight, mDefaultTextItalicsEnabled, mDefaultTextSmallCapsEnabled );
+		if( ! mDefaultTextVariationFamilies.empty() ) {
+			pango_font_description_set_family( pFontDescription, mDefaultTextVariationFamilies.c_str() );
+		}
+		pango_layout_set_font_description( pPangoLayout, pFontDescription );
+		pango_font_map_load_font( pFontMap, pPangoContext, pFontDescription );
+		Metrics::increment( Counter::FONT_LOADS );
+
+		mNeedsFontUpdate = false;
+	}
+}
+
+void CinderPangoCore::checkFontChanges()
+{
+	// The instance couldn't be created while background workers were matching fonts, until then the plain family is used
+	if( mVariationsDeferred && resolveVariationFamilies() ) {
+		mNeedsFontUpdate = true;
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+	}
+
+	const uint64_t serial = FontFallback::getChangeSerial();
+	if( serial == mFontChangeSerial ) {
+		return;
+	}
+	if( ! pPangoLayout || ( mLayoutGeneration == 0 ) ) {
+		// Nothing laid out yet, the first layout sees the current fonts
+		mFontChangeSerial = serial;
+		return;
+	}
+
+	std::vector<std::string> families;
+	addLayoutFamilies( pPangoLayout, families );
+
+	const bool hasMissingGlyphs = ( pango_layout_get_unknown_glyphs_count( pPangoLayout ) > 0 );
+	if( FontFallback::isAffected( mFontChangeSerial, families, hasMissingGlyphs ) ) {
+		// Pango can only drop all of a font map's cached fonts. Instances sharing it keep the fonts their layouts hold.
+		detail::clearFontMapCache( pFontMap );
+		if( resolveVariationFamilies() ) {
+			CI_LOG_V( "Variable font instance changed with the installed fonts" );
+		}
+		mNeedsFontUpdate = true;
+		mNeedsMeasuring = true;
+		mNeedsTextRender = true;
+		Metrics::increment( Counter::FONT_CHANGE_RELAYOUTS );
+	}
+	mFontChangeSerial = serial;
+}
+
+void CinderPangoCore::updateLayout( bool force )
+{
+	// If the text or the bounds change
+	if( force || mNeedsMeasuring ) {
+
+		const int lastPixelWidth = mPixelWidth;
+		const int lastPixelHeight = mPixelHeight;
+
+		pango_layout_set_width( pPangoLayout, mMaxSize.x * PANGO_SCALE );
+		pango_layout_set_height( pPangoLayout, mMaxSize.y * PANGO_SCALE );
+		applyAlignment( pPangoLayout, mTextAlignment );
+
+		// pango_layout_set_wrap(pPangoLayout, PANGO_WRAP_CHAR);
+		pango_layout_set_spacing( pPangoLayout, mSpacing * PANGO_SCALE );
+
+		// Set text, use the fastest method depending on what we found in the text
+		// Typed attributes go on top of whatever the markup produced, or replace any stale ones from earlier markup
+		if( pMarkupAttributes ) {
+			ResourceLedger::untrack( Resource::ATTRIBUTE_LIST, pMarkupAttributes );
+			pango_attr_list_unref( pMarkupAttributes );
+			pMarkupAttributes = nullptr;
+		}
+
+		if( mProbablyHasMarkup ) {
+			pango_layout_set_markup( pPangoLayout, mProcessedText.c_str(), -1 );
+			Metrics::increment( Counter::SET_MARKUP_CALLS );
+
+			// Keep the markup's own attributes around for recoloring later
+			pMarkupAttributes = pango_layout_get_attributes( pPangoLayout );
+			if( pMarkupAttributes ) {
+				ResourceLedger::track( Resource::ATTRIBUTE_LIST, pango_attr_list_ref( pMarkupAttributes ) );
+			}
+
+			mTextAttributes.applyTo( pPangoLayout, true );
+		} else {
+			pango_layout_set_text( pPangoLayout, mProcessedText.c_str(), -1 );
+			mTextAttributes.applyTo( pPangoLayout, false );
+		}
+
+		// A full layout picks up every attribute change
+		mNeedsRecolor = false;
+		mLayoutAttributesStale = false;
+		mRecolorRanges.clear();
+
+		// Measure text
+		mMetrics = getLayoutMetrics( pPangoLayout, mMaxSize );
+
+		mPixelWidth = glm::clamp( mMetrics.logicalSize.x, mMinSize.x, mMaxSize.x );
+		mPixelHeight = glm::clamp( mMetrics.logicalSize.y, mMinSize.y, mMaxSize.y );
+
+		// Check for change, need to re-render if there's a change
+		if( ( mPixelWidth != lastPixelWidth ) || ( mPixelHeight != lastPixelHeight ) ) {
+			// Dimensions changed, re-draw text
+			mNeedsSurfaceResize = true;
+		}
+
+		mNeedsMeasuring = false;
+		mNeedsLayoutIndexUpdate = true;
+		mLayoutGeneration++;
+	}
+}
+
+void CinderPangoCore::setStatsEnabled( bool enabled )
+{
+	if( enabled && ! mStatsHistory ) {
+		mStatsHistory.reset( new RenderStatsHistory() );
+	} else if( ! enabled ) {
+		mStatsHistory.reset();
+	}
+}
+
+bool CinderPangoCore::render( bool force )
+{
+	checkFontChanges();
+	if( force || mNeedsFontUpdate || mNeedsMeasuring || mNeedsTextRender || mNeedsMarkupDetection || mNeedsSurfaceResize || mNeedsRecolor ) {
+		Metrics::increment( Counter::RENDERS );
+
+		// Records on every return below, does nothing unless stats or tracing are enabled
+		RenderStatsScope stats( mStatsHistory.get(), this );
+		if( stats.isEnabled() ) {
+			RenderStats &s = stats.getStats();
+			s.forced = force;
+			s.markupChanged = mNeedsMarkupDetection;
+			s.fontOptionsChanged = mNeedsFontOptionUpdate;
+			s.fontChanged = mNeedsFontUpdate;
+			s.layoutChanged = mNeedsMeasuring;
+			s.textRenderNeeded = mNeedsTextRender;
+			s.recolorNeeded = mNeedsRecolor;
+			s.surfaceResized = mNeedsSurfaceResize;
+		}
+
+		// Set options
+		stats.beginStage( RenderStage::MARKUP );
+		updateMarkup( force );
+		stats.beginStage( RenderStage::FONT_OPTIONS );
+		updateFontOptions( force );
+		stats.beginStage( RenderStage::FONT );
+		updateFont( force );
+		stats.beginStage( RenderStage::LAYOUT );
+		updateLayout( force );
+		stats.beginStage( RenderStage::RECOLOR );
+		updateColors();
+		stats.endStage();
+
+		// Create Cairo surface buffer to draw glyphs into
+		// Force this is we need to render but don't have a surface yet
+		bool freshCairoSurface = false;
+
+		if( force || mNeedsSurfaceResize || ( mNeedsTextRender && ! pCairoSurface ) ) {
+			stats.beginStage( RenderStage::SURFACE );
+			mNeedsSurfaceResize = false;
+
+			// Create appropriately sized cairo surface
+			const bool grayscale = false; // Not really supported
+			_cairo_format cairoFormat = grayscale ? CAIRO_FORMAT_A8 : CAIRO_FORMAT_ARGB32;	//	TODO: investigate CAIRO_FORMAT_A8 unreachable on MSW
+
+			// clean up any existing surfaces
+			if( pCairoSurface != nullptr ) {
+				ResourceLedger::untrack( Resource::SURFACE, pCairoSurface );
+				cairo_surface_destroy( pCairoSurface );
+			}
+
+#if CAIRO_HAS_WIN32_SURFACE
+			pCairoSurface = cairo_win32_surface_create_with_dib( cairoFormat, mPixelWidth, mPixelHeight );
+#else
+			pCairoSurface = cairo_image_surface_create(cairoFormat, mPixelWidth, mPixelHeight);
+#endif
+			ResourceLedger::track( Resource::SURFACE, pCairoSurface );
+
+			if( CAIRO_STATUS_SUCCESS != cairo_surface_status( pCairoSurface ) ) {
+				CI_LOG_E("Error creating Cairo surface.");
+				return true;
+			}
+			Metrics::increment( Counter::SURFACES_ALLOCATED );
+
+			// Create context
+			/* create our cairo context object that tracks state. */
+			if( pCairoContext != nullptr ) {
+				ResourceLedger::untrack( Resource::CAIRO_CONTEXT, pCairoContext );
+				cairo_destroy( pCairoContext );
+			}
+
+			pCairoContext = ResourceLedger::track( Resource::CAIRO_CONTEXT, cairo_create( pCairoSurface ) );
+
+			if( CAIRO_STATUS_NO_MEMORY == cairo_status( pCairoContext ) ) {
+				CI_LOG_E("Out of memory, error creating Cairo context");
+				return true;
+			}
+
+			// Flip vertically
+			if( mSurfaceFlipped ) {
+				cairo_scale( pCairoContext, 1.0f, -1.0f );
+				cairo_translate( pCairoContext, 0.0f, -mPixelHeight );
+			}
+			cairo_move_to( pCairoContext, 0, 0 ); // needed?
+
+			mNeedsTextRender = true;
+			freshCairoSurface = true;
+			stats.endStage();
+		}
+
+		if( force || mNeedsTextRender || mNeedsPartialRender ) {
+			// Render text
+			stats.beginStage( RenderStage::RASTER );
+			// If colors in part of the text were all that changed, only redraw the runs they cover
+			const bool partialRender = ! force && ! mNeedsTextRender && ! freshCairoSurface;
+			if( partialRender ) {
+				cairo_save( pCairoContext );
+				cairo_rectangle( pCairoContext, mPartialRenderBounds.x1, mPartialRenderBounds.y1, mPartialRenderBounds.getWidth(), mPartialRenderBounds.getHeight() );
+				cairo_clip( pCairoContext );
+			}
+
+			if( ( mBackgroundColor == ColorA::zero() ) && ! freshCairoSurface ) {
+				// Clear the context... if the background is clear and it's not a brand-new surface buffer
+				cairo_save( pCairoContext );
+				cairo_set_operator( pCairoContext, CAIRO_OPERATOR_CLEAR );
+				cairo_paint( pCairoContext );
+				cairo_restore( pCairoContext );
+			} else {
+				// Fill the context with the background color
+				cairo_save( pCairoContext );
+				cairo_set_source_rgba( pCairoContext, mBackgroundColor.r, mBackgroundColor.g, mBackgroundColor.b, mBackgroundColor.a );
+				cairo_paint( pCairoContext );
+				cairo_restore( pCairoContext );
+			}
+
+			// Draw the text into the buffer
+			cairo_set_source_rgba( pCairoContext, mDefaultTextColor.r, mDefaultTextColor.g, mDefaultTextColor.b, mDefaultTextColor.a );
+			pango_cairo_update_layout( pCairoContext, pPangoLayout );
+			pango_cairo_show_layout( pCairoContext, pPangoLayout );
+
+			if( partialRender ) {
+				cairo_restore( pCairoContext );
+			} else if( UsageRecorder::isEnabled() ) {
+				UsageRecorder::record( pPangoLayout, mTextQuality );
+			}
+			mNeedsPartialRender = false;
+
+			if( stats.isEnabled() ) {
+				const size_t area = partialRender ? static_cast<size_t>( mPartialRenderBounds.getWidth() * mPartialRenderBounds.getHeight() ) : static_cast<size_t>( mPixelWidth ) * mPixelHeight;
+				stats.getStats().bytesRasterized = area * 4;
+			}
+			stats.endStage();
+
+			// Hand the pixels to the layer above, e.g. CinderPango copies them out to a texture
+#ifdef CAIRO_HAS_WIN32_SURFACE
+			pCairoImageSurface = cairo_win32_surface_get_image( pCairoSurface );
+#endif
+			cairo_surface_flush( getCairoSurface() );
+
+			stats.beginStage( RenderStage::UPLOAD );
+			const size_t bytesUploaded = uploadPixels( getPixels() );
+			if( bytesUploaded > 0 ) {
+				stats.getStats().bytesUploaded = bytesUploaded;
+				Metrics::increment( Counter::BYTES_UPLOADED, bytesUploaded );
+			}
+			stats.endStage();
+
+			mNeedsTextRender = false;
+		}
+
+		return true;
+	} else {
+		Metrics::increment( Counter::RENDER_CACHE_HITS );
+		return false;
+	}
+}
+
+void CinderPangoCore::setTextRenderer( TextRenderer renderer )
+{
+	std::string rendererName = "";
+
+	switch( renderer ) {
+		case TextRenderer::PLATFORM_NATIVE:
+#if defined(CINDER_MSW)
+			rendererName = "win32";
+#elif defined(CINDER_MAC)
+			rendererName = "coretext";
+#else
+			CI_LOG_E( "Setting Pango text renderer not supported on this platform." );
+#endif
+			break;
+		case TextRenderer::FREETYPE:
+		{
+			rendererName = "fontconfig";
+		}
+			break;
+	}
+
+	if( rendererName != "" ) {
+#ifdef CINDER_MSW
+		auto status = _putenv_s( "PANGOCAIRO_BACKEND", rendererName.c_str() );
+#else
+		auto status = setenv( "PANGOCAIRO_BACKEND", rendererName.c_str(), 1 ); // this fixes some font issues on  mac
+#endif
+		if( status == 0 ) {
+			CI_LOG_V( "Set Pango Cairo backend renderer to: " << rendererName );
+		} else {
+			CI_LOG_E( "Error setting Pango Cairo backend environment variable. Code: " + status );
+		}
+	}
+}
+
+TextRenderer CinderPangoCore::getTextRenderer()
+{
+	const char *rendererName = std::getenv( "PANGOCAIRO_BACKEND" );
+
+	if( rendererName == nullptr ) {
+		CI_LOG_E( "Could not read Pango Cairo backend environment variable. Assuming native renderer." );
+		return TextRenderer::PLATFORM_NATIVE;
+	}
+
+	std::string rendererNameString( rendererName );
+
+	if( ( rendererNameString == "win32" ) || ( rendererNameString == "coretext" ) ) {
+		return TextRenderer::PLATFORM_NATIVE;
+	}
+
+	if( ( rendererNameString == "fontconfig" ) || ( rendererNameString == "fc" ) ) {
+		return TextRenderer::FREETYPE;
+	}
+
+	CI_LOG_E( "Unknown Pango Cairo backend environment variable: " << rendererNameString << ". Assuming native renderer." );
+	return TextRenderer::PLATFORM_NATIVE;
+}
+
+void CinderPangoCore::loadFont( const fs::path &path )
+{
+	TraceScope trace( "loadFont" );
+	auto fcPath = reinterpret_cast<const FcChar8 *>( path.c_str() );
+	auto fontAddStatus = FcConfigAppFontAddFile( FcConfigGetCurrent(), fcPath );
+
+	if( ! fontAddStatus ) {
+		CI_LOG_E( "Pango failed to load font from file \"" << path << "\"" );
+	} else {
+		CI_LOG_V( "Pango thinks it loaded font " << path << " with status " << fontAddStatus );
+		Metrics::increment( Counter::FONT_FILES_LOADED );
+		FontFallback::clear();
+	}
+}
+
+std::vector<std::string> CinderPangoCore::getFontList( bool verbose )
+{
+	TraceScope trace( "getFontList" );
+	std::vector<std::string> fontList;
+
+	// http: // www.lemoda.net/pango/list-fonts/
+	// https://code.google.com/p/serif/source/browse/fontview/trunk/src/font-model.c
+	int i;
+	PangoFontFamily **families;
+	int n_families;
+	PangoFontMap *fontmap;
+
+	fontmap = pango_cairo_font_map_get_default();
+	pango_font_map_list_families( fontmap, &families, &n_families );
+	// printf("There are %d families\n", n_families);
+	for( i = 0; i < n_families; i++ ) {
+		PangoFontFamily *family = families[ i ];
+
+		const char *family_name;
+		family_name = pango_font_family_get_name( family );
+		fontList.push_back( family_name );
+
+		if( verbose ) {
+			CI_LOG_I( "Family " << i << ": " << family_name );
+
+			// Also interrogate individual fonts in the family
+			// Useful if something isn't rendering correctly
+			PangoFontFace **pFontFaces = nullptr;
+			int numFontFaces = 0;
+			pango_font_family_list_faces( family, &pFontFaces, &numFontFaces );
+
+			// Get a description of each weight
+			for( int j = 0; j < numFontFaces; j++ ) {
+				PangoFontFace *face = pFontFaces[ j ];
+
+				const char *face_name = pango_font_face_get_face_name( face );
+				PangoFontDescription *description = pango_font_face_describe( face );
+				char *description_string = pango_font_description_to_string( description );
+				PangoWeight weight = pango_font_description_get_weight( description );
+				uint32_t hash = pango_font_description_hash( description );
+
+				CI_LOG_I( "\tFace " << j << ": " << face_name );
+				CI_LOG_I( "\t\tDescription: " << description_string );
+				CI_LOG_I( "\t\tWeight: " << weight );
+				CI_LOG_I( "\t\tHash: " << hash );
+				// TODO more stuff?
+
+				g_free( description_string );
+				pango_font_description_free( description );
+			}
+
+			g_free( pFontFaces );
+		}
+	}
+	g_free( families );
+
+	return fontList;
+}
+
+void CinderPangoCore::logFontList( bool verbose )
+{
+	auto fontList = getFontList( verbose );
+
+	auto i { 0 };
+	for( auto &fontName : fontList ) {
+		CI_LOG_I( "Font " << i << ": " << fontName );
+		i++;
+	}
+}
+
+std::vector<TextMetrics> CinderPangoCore::measureBatch( const std::vector<MeasureJob> &jobs, size_t numThreads )
+{
+	std::vector<TextMetrics> results( jobs.size() );
+
+	if( numThreads == 0 ) {
+		numThreads = std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+	}
+	numThreads = std::min( numThreads, jobs.size() );
+
+	// Workers pull job indices until they run out, each one holding a single pooled layout for the whole batch
+	std::atomic<size_t> nextJob( 0 );
+	auto worker = [&]() {
+		TraceScope trace( "measureBatch" );
+		detail::FontSetReadScope fontSetScope;
+		auto pooledLayout = getLayoutPool().acquire();
+		for( size_t i = nextJob++; i < jobs.size(); i = nextJob++ ) {
+			results[ i ] = pooledLayout->measure( jobs[ i ] );
+		}
+		getLayoutPool().release( std::move( pooledLayout ) );
+	};
+
+	std::vector<std::thread> threads;
+	for( size_t i = 1; i < numThreads; i++ ) {
+		threads.emplace_back( worker );
+	}
+
+	// The calling thread does its share as well
+	if( numThreads > 0 ) {
+		worker();
+	}
+
+	for( auto &thread : threads ) {
+		thread.join();
+	}
+
+	return results;
+}
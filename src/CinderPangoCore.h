@@ -0,0 +1,390 @@
+// CinderPangoCore.h
+// PangoBasic
+//
+// Created by Eric Mika on 1/6/16.
+//
+
+#pragma once
+
+#include "CinderPangoTypes.h"
+
+#if defined( CINDER_MSW ) && ! defined( CINDER_PANGO_HEADLESS )
+#include "cinder/cairo/Cairo.h"
+#endif
+
+#include "CinderPangoAttributes.h"
+#include "CinderPangoLayoutIndex.h"
+#include "CinderPangoMarkup.h"
+#include "CinderPangoStats.h"
+#include "CinderPangoVariations.h"
+
+#include <fontconfig/fontconfig.h>
+#include <pango/pangocairo.h>
+
+#include <memory>
+#include <vector>
+
+namespace kp { namespace pango {
+
+// TODO wrap these up?
+const bool grayscale = false;
+const bool native = false;
+
+enum class TextAlignment : int {
+	LEFT,
+	CENTER,
+	RIGHT,
+	JUSTIFY,
+};
+
+enum class TextRenderer {
+	FREETYPE,
+	PLATFORM_NATIVE,
+};
+
+enum class TextWeight : int {
+	THIN = 100,
+	ULTRALIGHT = 200,
+	LIGHT = 300,
+	SEMILIGHT = 350,
+	BOOK = 380,
+	NORMAL = 400,
+	MEDIUM = 500,
+	SEMIBOLD = 600,
+	BOLD = 700,
+	ULTRABOLD = 800,
+	HEAVY = 900,
+	ULTRAHEAVY = 1000
+};
+
+enum class TextAntialias : int {
+	DEFAULT,
+	NONE,
+	GRAY,
+	SUBPIXEL,
+};
+
+// Same order as Cairo's
+enum class TextHintStyle : int {
+	DEFAULT,
+	NONE,
+	SLIGHT,
+	MEDIUM,
+	FULL,
+};
+
+enum class TextHintMetrics : int {
+	DEFAULT,
+	OFF, // fractional advances, glyph positions don't snap to whole pixels in the layout
+	ON,
+};
+
+enum class TextSubpixelOrder : int {
+	DEFAULT,
+	RGB,
+	BGR,
+	VRGB,
+	VBGR,
+};
+
+// How glyphs are rasterized and positioned. Cairo keeps scaled fonts and rasterized glyphs per set of these options, and
+// Pango its fonts per font options, so every combination in use gets cache entries of its own and switching an
+// instance between presets doesn't evict another's glyphs. Changing the quality lays the text out again.
+struct TextQuality {
+	TextAntialias antialias = TextAntialias::DEFAULT;
+	TextHintStyle hintStyle = TextHintStyle::FULL;
+	TextHintMetrics hintMetrics = TextHintMetrics::ON;
+	TextSubpixelOrder subpixelOrder = TextSubpixelOrder::DEFAULT; // only used with TextAntialias::SUBPIXEL
+
+	// Fully hinted outlines on whole pixel advances, for static UI text. The default, what render() always did.
+	static TextQuality crisp() { return TextQuality(); }
+	// Unhinted outlines and fractional advances, so text that moves or scales doesn't jitter as hinting and rounding
+	// snap it differently every frame. The block's Cairo still draws each glyph at a whole pixel.
+	static TextQuality smooth() { return { TextAntialias::GRAY, TextHintStyle::NONE, TextHintMetrics::OFF, TextSubpixelOrder::DEFAULT }; }
+	// Aliased and unhinted, the cheapest to rasterize, for throwaway previews
+	static TextQuality preview() { return { TextAntialias::NONE, TextHintStyle::NONE, TextHintMetrics::ON, TextSubpixelOrder::DEFAULT }; }
+
+	bool operator==( const TextQuality &rhs ) const
+	{
+		return ( antialias == rhs.antialias ) && ( hintStyle == rhs.hintStyle ) && ( hintMetrics == rhs.hintMetrics ) && ( subpixelOrder == rhs.subpixelOrder );
+	}
+	bool operator!=( const TextQuality &rhs ) const { return ! ( *this == rhs ); }
+};
+
+// Default style bundle, used where styles are passed around by value (e.g. batch measurement)
+struct TextStyle {
+	std::string font = "Sans";
+	float size = 12.0f;
+	TextWeight weight = TextWeight::NORMAL;
+	TextAlignment alignment = TextAlignment::LEFT;
+	bool italicsEnabled = false;
+	bool smallCapsEnabled = false;
+	float spacing = 0.0f;
+	TextQuality quality; // hint style and metrics change advances, match the instance the text will render with
+};
+
+// Result of laying out text without rasterizing it
+struct TextMetrics {
+	ci::ivec2 logicalSize; // unclamped layout size, what the text would like to occupy
+	ci::ivec2 inkSize;	 // size of the actual glyph outlines
+	int lineCount = 0;
+	int baseline = 0; // baseline of the first line, in pixels from the top
+	bool overflowed = false; // true if the logical size exceeds the max size
+};
+
+// One unit of work for CinderPangoCore::measureBatch
+struct MeasureJob {
+	std::string text; // may contain markup
+	TextStyle style;
+	ci::ivec2 maxSize = ci::ivec2( 320, 240 );
+};
+
+// Result of CinderPangoCore::fitTextSize
+struct FitResult {
+	float size = 0.0f;
+	bool fits = false; // false if even the smallest size overflows
+	int iterations = 0;
+	double seconds = 0.0;
+};
+
+using CinderPangoCoreRef = std::shared_ptr<class CinderPangoCore>;
+
+// Text state, dirty tracking, layout and rasterization into a Cairo surface, without Cinder's GL layer.
+// CinderPango adds the texture on top. Builds headless with CINDER_PANGO_HEADLESS, see CinderPangoTypes.h.
+class CinderPangoCore : public std::enable_shared_from_this<CinderPangoCore>
+{
+public:
+	static CinderPangoCoreRef create();
+	virtual ~CinderPangoCore();
+
+	// Globals
+	static std::vector<std::string> getFontList( bool verbose = false );
+	static void logFontList( bool verbose = false );
+	// Adds a font file to fontconfig's application fonts, for the FREETYPE renderer.
+	// For fonts in memory or a mapped asset pack, see FontPack.
+	static void loadFont( const ci::fs::path &path );
+	static TextRenderer getTextRenderer();
+	static void setTextRenderer( TextRenderer renderer );
+
+	// Measures many jobs in parallel without touching Cairo surfaces or GL.
+	// Layouts are pooled and reused across calls, one per worker thread.
+	// Pass 0 threads to use all available cores. Results are in the same order as the jobs.
+	// Font set changes from FontWatcher and FontVariations are deferred until the batch is done, FontPack waits for it.
+	static std::vector<TextMetrics> measureBatch( const std::vector<MeasureJob> &jobs, size_t numThreads = 0 );
+
+	// Rendering
+
+	const std::string& getText() const;
+
+	// setText can take inline markup to override the default text settings
+	// See here for full list of supported tags:
+	// https://developer.gnome.org/pango/stable/PangoMarkupFormat.html
+	void setText( const std::string &text );
+
+	// Handles <br> tags and custom tag expansions before the text reaches Pango, see MarkupPreprocessor.
+	// Defaults to the shared MarkupPreprocessor::getDefault(), register custom tags there to use them everywhere.
+	const MarkupPreprocessorRef& getMarkupPreprocessor() const;
+	void setMarkupPreprocessor( const MarkupPreprocessorRef &preprocessor );
+
+	// Typed per-range styling applied on top of the text (and any markup in it), without building or parsing markup.
+	// See TextAttributes. If only colors changed since the last layout the existing lines are kept and only
+	// the affected runs are rasterized again (e.g. for hover highlights or ticking prices).
+	const TextAttributes& getTextAttributes() const;
+	void setTextAttributes( const TextAttributes &attributes );
+
+	// The rasterized text, premultiplied ARGB32 (BGRA bytes on little endian) rows of getPixelStride() bytes.
+	// Rows are bottom up unless the surface isn't flipped, see setSurfaceFlipped. Null before the first render.
+	const unsigned char* getPixels() const;
+	int getPixelStride() const;
+
+	// Text is drawn upside down by default, which is what a GL texture expects. Turn it off for top down rows.
+	bool isSurfaceFlipped() const { return mSurfaceFlipped; }
+	void setSurfaceFlipped( bool flipped );
+
+#ifdef CAIRO_HAS_WIN32_SURFACE
+	cairo_surface_t* getCairoSurface() const { return pCairoImageSurface; }
+#else
+	cairo_surface_t* getCairoSurface() const { return pCairoSurface; }
+#endif
+
+
+	// Text smaller than the min size will be clipped
+	ci::ivec2 getMinSize() const;
+	void setMinSize( int minWidth, int minHeight );
+	void setMinSize( const ci::ivec2 &minSize );
+
+	// Text can grow up to this size before a line breaks or clipping begins
+	ci::ivec2 getMaxSize() const;
+	void setMaxSize( int maxWidth, int maxHeight );
+	void setMaxSize( const ci::ivec2 &maxSize );
+
+	// Setting default font styles is more efficient than passing markup via the text string
+
+	void setDefaultTextStyle( const std::string &font = "Sans", 
+							  float size = 12.0, 
+							  const ci::ColorA &color = ci::Color::black(), 
+							  TextWeight weight = TextWeight::NORMAL,
+	                          TextAlignment alignment = TextAlignment::LEFT ); // convenience
+
+	const ci::ColorA& getDefaultTextColor() const;
+	void setDefaultTextColor( const ci::ColorA &color );
+
+	const ci::ColorA& getBackgroundColor() const;
+	void setBackgroundColor( const ci::ColorA &color );
+
+	float getDefaultTextSize() const;
+	void setDefaultTextSize( float size );
+
+	const std::string& getDefaultTextFont() const;
+	void setDefaultTextFont( const std::string &font );
+
+	TextWeight getDefaultTextWeight() const;
+	void setDefaultTextWeight( TextWeight weight );
+
+	// Continuous axes for a variable default font, e.g. { { "wght", 650.0f } }, applied to its first family through
+	// FontVariations. Values are quantized, so changes within a step don't invalidate anything. Keep the TextWeight at
+	// NORMAL when setting wght, bolder weights are emboldened on top.
+	const FontAxes& getDefaultTextAxes() const;
+	void setDefaultTextAxes( const FontAxes &axes );
+	void setDefaultTextAxis( const std::string &tag, float value );
+
+	TextAntialias getTextAntialias() const;
+	void setTextAntialias( TextAntialias mode ); // keeps the rest of the quality
+
+	const TextQuality& getTextQuality() const;
+	void setTextQuality( const TextQuality &quality ); // e.g. TextQuality::smooth()
+
+	TextAlignment getTextAlignment() const;
+	void setTextAlignment( TextAlignment alignment );
+
+	bool getDefaultTextSmallCapsEnabled() const;
+	void setDefaultTextSmallCapsEnabled( bool value );
+
+	bool getDefaultTextItalicsEnabled() const;
+	void setDefaultTextItalicsEnabled( bool value );
+
+	float getSpacing() const;
+	void setSpacing( float spacing );
+
+	ci::ivec2 getPixelSize() const { return ci::ivec2( mPixelWidth, mPixelHeight ); };
+
+	// Lays out the text (if anything changed) and returns its metrics without rasterizing.
+	// A subsequent render() reuses the layout and only does the raster work.
+	TextMetrics measure();
+
+	// Character index under a position relative to the top left of the texture as drawn. Trailing is set to the number of
+	// characters to add for a caret position (0 on the leading half of a glyph). Both queries are binary searches
+	// over an index that's built once per layout pass, see LayoutIndex.
+	int hitTest( const ci::vec2 &position, int *trailing = nullptr );
+	ci::Rectf getCaretRect( int charIndex );
+
+	// Finds the largest default text size in [minSize, maxSize] at which the text fits the max size, sets it, and renders once.
+	// Candidate sizes are tried by binary search down to the given precision (at least 1 / PANGO_SCALE), measuring only,
+	// with the font description copied once and resized in place. Sizes set explicitly in markup don't scale. Swapped
+	// bounds are logged and swapped back.
+	FitResult fitTextSize( float minSize, float maxSize, float precision = 0.25f );
+
+	// Direct access for helpers that draw the layout themselves (e.g. CinderPangoDocument).
+	// Both bring the layout up to date first. The generation increments every time the text is laid out again.
+	// In place recolors leave the layout's attribute list behind its glyphs, pass currentAttributes to lay out
+	// again in that case if you're copying the attributes (e.g. PagedExport).
+	PangoLayout* getPangoLayout( bool currentAttributes = false );
+	const LayoutIndex& getLayoutIndex();
+	uint64_t getLayoutGeneration() const { return mLayoutGeneration; }
+
+	// Per-stage timing of render(), off by default. When enabled, every render() that does work is recorded into this
+	// instance's history and the global one (RenderStatsHistory::getGlobalSnapshot). Returns null while disabled.
+	void setStatsEnabled( bool enabled );
+	bool isStatsEnabled() const { return mStatsHistory != nullptr; }
+	const RenderStatsHistory* getStats() const { return mStatsHistory.get(); }
+
+	// Renders text into the texture.
+	// Returns true if the pixels were actually updated, false if nothing had to change
+	// It's reasonable (and more efficient) to just run this in an update loop rather than calling it
+	// explicitly after every change to the text state. It will coalesce all invalidations since the
+	// last frame and only rebuild what needs to be rebuilt to render the diff.
+	// Set force to true to render even if the system thinks state wasn't invalidated.
+	bool render( bool force = false );
+
+  protected:
+	CinderPangoCore();
+
+	// Called after every raster with the updated pixels, e.g. to upload them. Returns the number of bytes consumed.
+	virtual size_t uploadPixels( const unsigned char * /*pixels*/ ) { return 0; }
+
+  private:
+	// Render stages, each one only does work if its flag (or force) is set
+	void updateMarkup( bool force );
+	void updateFontOptions( bool force );
+	void updateFont( bool force );
+	void updateLayout( bool force );
+	void updateColors(); // in place recolor for color-only attribute changes, see setTextAttributes
+	void updateLayoutIndex(); // built lazily, the first query after a layout pays for it
+	bool resolveVariationFamilies(); // true if the default font's instance changed
+	void checkFontChanges(); // lays out again if fonts this layout uses were added, replaced or removed
+
+	std::string mText;
+	std::string mProcessedText; // stores text after newline filtering
+	TextAttributes mTextAttributes;
+	bool mProbablyHasMarkup;
+	MarkupPreprocessorRef mMarkupPreprocessor;
+	ci::ivec2 mMinSize;
+	ci::ivec2 mMaxSize;
+
+	// TODO wrap these up...
+	std::string mDefaultTextFont;
+	bool mDefaultTextItalicsEnabled;
+	bool mDefaultTextSmallCapsEnabled;
+	ci::ColorA mDefaultTextColor;
+	ci::ColorA mBackgroundColor;
+	float mDefaultTextSize;
+	TextAlignment mTextAlignment;
+	TextWeight mDefaultTextWeight;
+	FontAxes mDefaultTextAxes;
+	std::string mDefaultTextVariationFamilies; // mDefaultTextFont's families with the instance first, empty without one
+	bool mVariationsDeferred; // the instance has yet to be created, see FontVariations
+	TextQuality mTextQuality;
+	float mSpacing;
+
+	// Internal flags for state invalidation
+	// Used by render method
+	bool mNeedsFontUpdate;
+	bool mNeedsMeasuring;
+	bool mNeedsTextRender;
+	bool mNeedsFontOptionUpdate;
+	bool mNeedsMarkupDetection;
+	bool mNeedsSurfaceResize;
+	bool mNeedsLayoutIndexUpdate;
+	bool mNeedsRecolor;
+	bool mLayoutAttributesStale; // runs were recolored in place, the layout's own attribute list is out of date
+
+	bool mSurfaceFlipped;
+
+	// simply stored to check for change across renders
+	int mPixelWidth;
+	int mPixelHeight;
+	TextMetrics mMetrics;
+	LayoutIndex mLayoutIndex;
+	TextAttributes::RangeList mRecolorRanges;
+	TextAttributes::RecolorScratch mRecolorScratch;
+	ci::Rectf mPartialRenderBounds;
+	bool mNeedsPartialRender;
+	uint64_t mLayoutGeneration;
+	uint64_t mFontChangeSerial; // FontFallback's, as of the last check
+	std::unique_ptr<RenderStatsHistory> mStatsHistory;
+
+	// Pango references
+	PangoFontMap *pFontMap;
+	PangoContext *pPangoContext;
+	PangoLayout *pPangoLayout;
+	PangoFontDescription *pFontDescription;
+	PangoAttrList *pMarkupAttributes; // attributes parsed from markup, before typed attributes are merged on top
+	cairo_surface_t *pCairoSurface;
+	cairo_t *pCairoContext;
+	cairo_font_options_t *pCairoFontOptions;
+
+#ifdef CAIRO_HAS_WIN32_SURFACE
+	cairo_surface_t *pCairoImageSurface;
+#endif
+};
+}} // namespace kp::pango
@@ -0,0 +1,252 @@
+// CinderPangoDocument.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoDocument.h"
+#include "CinderPangoLedger.h"
+#include "CinderPangoTrace.h"
+
+#include "cinder/Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace kp::pango;
+using namespace ci;
+
+namespace {
+
+// Tile heights are rounded up so lines of slightly different height can share recycled tiles
+const int kTileHeightStep = 8;
+
+} // anonymous namespace
+
+CinderPangoDocumentRef CinderPangoDocument::create()
+{
+	return CinderPangoDocumentRef( new CinderPangoDocument() );
+}
+
+CinderPangoDocument::CinderPangoDocument() :
+	mPango( CinderPango::create() ),
+	mWidth( 640.0f ),
+	mScrollPosition( 0.0f ),
+	mViewportHeight( 480.0f ),
+	mPrefetchMargin( 240.0f ),
+	mLayoutGeneration( 0 ),
+	mTextColor( ColorA::black() ),
+	mBackgroundColor( ColorA::zero() )
+{
+	mPango->setMaxSize( static_cast<int>( mWidth ), std::numeric_limits<int>::max() / PANGO_SCALE );
+}
+
+CinderPangoDocument::~CinderPangoDocument()
+{
+	recycleAllTiles();
+
+	for( Tile *tile : mTilePool ) {
+		destroyTile( tile );
+	}
+}
+
+void CinderPangoDocument::setText( const std::string &text )
+{
+	mPango->setText( text );
+}
+
+const std::string& CinderPangoDocument::getText() const
+{
+	return mPango->getText();
+}
+
+void CinderPangoDocument::setWidth( float width )
+{
+	if( mWidth != width ) {
+		mWidth = width;
+		mPango->setMaxSize( static_cast<int>( mWidth ), std::numeric_limits<int>::max() / PANGO_SCALE );
+	}
+}
+
+float CinderPangoDocument::getHeight()
+{
+	return static_cast<float>( mPango->measure().logicalSize.y );
+}
+
+void CinderPangoDocument::setScrollPosition( float scrollPosition )
+{
+	mScrollPosition = scrollPosition;
+}
+
+void CinderPangoDocument::setViewportHeight( float height )
+{
+	mViewportHeight = height;
+}
+
+void CinderPangoDocument::setPrefetchMargin( float margin )
+{
+	mPrefetchMargin = margin;
+}
+
+bool CinderPangoDocument::update()
+{
+	TraceScope trace( "CinderPangoDocument::update", this );
+	// Tiles draw straight from the layout, so color-only attribute changes (which render() would apply in place) have to
+	// lay out again here, that also bumps the generation below
+	PangoLayout *layout = mPango->getPangoLayout( true );
+	const LayoutIndex &index = mPango->getLayoutIndex();
+
+	// Anything that changed the layout or the colors invalidates every tile
+	if( ( mLayoutGeneration != mPango->getLayoutGeneration() ) || ( mTextColor != mPango->getDefaultTextColor() ) ||
+		( mBackgroundColor != mPango->getBackgroundColor() ) ) {
+		recycleAllTiles();
+		mLayoutGeneration = mPango->getLayoutGeneration();
+		mTextColor = mPango->getDefaultTextColor();
+		mBackgroundColor = mPango->getBackgroundColor();
+	}
+
+	size_t firstLine = 0;
+	size_t lastLine = 0;
+	index.getLineRange( mScrollPosition - mPrefetchMargin, mScrollPosition + mViewportHeight + mPrefetchMargin, &firstLine, &lastLine );
+
+	// Recycle tiles that fell out of range
+	auto outOfRange = std::stable_partition( mTiles.begin(), mTiles.end(), [=]( const Tile *tile ) { return ( tile->line >= firstLine ) && ( tile->line < lastLine ); } );
+	for( auto it = outOfRange; it != mTiles.end(); ++it ) {
+		recycleTile( *it );
+	}
+	mTiles.erase( outOfRange, mTiles.end() );
+
+	// Rasterize lines that came into range, tiles stay sorted by line so existing ones are found by binary search
+	const int tileWidth = std::max( static_cast<int>( std::ceil( mWidth ) ), 1 );
+	bool rendered = false;
+
+	for( size_t i = firstLine; i < lastLine; i++ ) {
+		auto it = std::lower_bound( mTiles.begin(), mTiles.end(), i, []( const Tile *tile, size_t line ) { return tile->line < line; } );
+		if( ( it != mTiles.end() ) && ( ( *it )->line == i ) ) {
+			continue;
+		}
+
+		const LayoutIndex::Line &line = index.getLines()[ i ];
+		const int lineHeight = std::max( static_cast<int>( std::ceil( line.bottom - line.top ) ), 1 );
+		const int tileHeight = ( ( lineHeight + kTileHeightStep - 1 ) / kTileHeightStep ) * kTileHeightStep;
+
+		Tile *tile = acquireTile( tileWidth, tileHeight );
+		if( ! tile ) {
+			break;
+		}
+
+		tile->line = i;
+		renderTile( tile, layout, line );
+		mTiles.insert( it, tile );
+		rendered = true;
+	}
+
+	return rendered;
+}
+
+void CinderPangoDocument::draw( const vec2 &origin )
+{
+	const auto &lines = mPango->getLayoutIndex().getLines();
+
+	for( const Tile *tile : mTiles ) {
+		const float top = origin.y + std::floor( lines[ tile->line ].top ) - mScrollPosition;
+		gl::draw( tile->texture, Rectf( origin.x, top, origin.x + tile->width, top + tile->height ) );
+	}
+}
+
+CinderPangoDocument::Tile* CinderPangoDocument::acquireTile( int width, int height )
+{
+	auto it = std::find_if( mTilePool.begin(), mTilePool.end(), [=]( const Tile *tile ) { return ( tile->width == width ) && ( tile->height == height ); } );
+	if( it != mTilePool.end() ) {
+		Tile *tile = *it;
+		mTilePool.erase( it );
+		return tile;
+	}
+
+	// Sizes changed (e.g. new width), pooled tiles of the old size won't come back
+	if( ! mTilePool.empty() && ( mTilePool.front()->width != width ) ) {
+		for( Tile *tile : mTilePool ) {
+			destroyTile( tile );
+		}
+		mTilePool.clear();
+	}
+
+	cairo_surface_t *surface = ResourceLedger::track( Resource::SURFACE, cairo_image_surface_create( CAIRO_FORMAT_ARGB32, width, height ) );
+	if( CAIRO_STATUS_SUCCESS != cairo_surface_status( surface ) ) {
+		CI_LOG_E( "Error creating Cairo surface for document tile." );
+		ResourceLedger::untrack( Resource::SURFACE, surface );
+		cairo_surface_destroy( surface );
+		return nullptr;
+	}
+
+	cairo_t *context = ResourceLedger::track( Resource::CAIRO_CONTEXT, cairo_create( surface ) );
+	if( CAIRO_STATUS_NO_MEMORY == cairo_status( context ) ) {
+		CI_LOG_E( "Out of memory, error creating Cairo context for document tile." );
+		ResourceLedger::untrack( Resource::CAIRO_CONTEXT, context );
+		cairo_destroy( context );
+		ResourceLedger::untrack( Resource::SURFACE, surface );
+		cairo_surface_destroy( surface );
+		return nullptr;
+	}
+
+	// Flip vertically, same as CinderPango
+	cairo_scale( context, 1.0f, -1.0f );
+	cairo_translate( context, 0.0f, -height );
+
+	Tile *tile = new Tile();
+	tile->line = 0;
+	tile->width = width;
+	tile->height = height;
+	tile->surface = surface;
+	tile->context = context;
+	return tile;
+}
+
+void CinderPangoDocument::recycleTile( Tile *tile )
+{
+	// Textures stay attached, a recycled tile updates in place
+	mTilePool.push_back( tile );
+}
+
+void CinderPangoDocument::recycleAllTiles()
+{
+	for( Tile *tile : mTiles ) {
+		recycleTile( tile );
+	}
+	mTiles.clear();
+}
+
+void CinderPangoDocument::destroyTile( Tile *tile )
+{
+	ResourceLedger::untrack( Resource::CAIRO_CONTEXT, tile->context );
+	cairo_destroy( tile->context );
+	ResourceLedger::untrack( Resource::SURFACE, tile->surface );
+	cairo_surface_destroy( tile->surface );
+	delete tile;
+}
+
+void CinderPangoDocument::renderTile( Tile *tile, PangoLayout *layout, const LayoutIndex::Line &line )
+{
+	TraceScope trace( "renderTile", this );
+	cairo_t *context = tile->context;
+
+	cairo_save( context );
+	cairo_set_operator( context, CAIRO_OPERATOR_SOURCE );
+	cairo_set_source_rgba( context, mBackgroundColor.r, mBackgroundColor.g, mBackgroundColor.b, mBackgroundColor.a );
+	cairo_paint( context );
+	cairo_restore( context );
+
+	// Lines draw from their baseline, relative to the top of the tile
+	cairo_set_source_rgba( context, mTextColor.r, mTextColor.g, mTextColor.b, mTextColor.a );
+	pango_cairo_update_layout( context, layout );
+	cairo_move_to( context, line.left, line.baseline - std::floor( line.top ) );
+	pango_cairo_show_layout_line( context, pango_layout_get_line_readonly( layout, static_cast<int>( tile->line ) ) );
+
+	cairo_surface_flush( tile->surface );
+	auto pixels = cairo_image_surface_get_data( tile->surface );
+
+	if( ! tile->texture ) {
+		tile->texture = gl::Texture2d::create( pixels, GL_BGRA, tile->width, tile->height );
+	} else {
+		tile->texture->update( pixels, GL_BGRA, GL_UNSIGNED_BYTE, 0, tile->width, tile->height );
+	}
+}
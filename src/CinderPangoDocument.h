@@ -0,0 +1,121 @@
+// CinderPangoDocument.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPango.h"
+
+#include <vector>
+
+namespace kp { namespace pango {
+
+using CinderPangoDocumentRef = std::shared_ptr<class CinderPangoDocument>;
+
+// Scrollable view onto a long piece of text (logs, terms, manuals...).
+// The text is laid out once at the document width, but only the lines intersecting the viewport (plus a
+// prefetch margin) are rasterized, each into its own line tile. Tiles that scroll out of range are recycled
+// for the lines scrolling in, so scrolling only costs the newly visible lines.
+class CinderPangoDocument {
+  public:
+	static CinderPangoDocumentRef create();
+	virtual ~CinderPangoDocument();
+
+	void setText( const std::string &text );
+	const std::string& getText() const;
+
+	// Styling, passed through to the instance that lays the text out. That instance is as tall as the whole document
+	// and only ever rasterized line by line, so it isn't exposed.
+	const MarkupPreprocessorRef& getMarkupPreprocessor() const { return mPango->getMarkupPreprocessor(); }
+	void setMarkupPreprocessor( const MarkupPreprocessorRef &preprocessor ) { mPango->setMarkupPreprocessor( preprocessor ); }
+	const TextAttributes& getTextAttributes() const { return mPango->getTextAttributes(); }
+	void setTextAttributes( const TextAttributes &attributes ) { mPango->setTextAttributes( attributes ); }
+
+	void setDefaultTextStyle( const std::string &font = "Sans", float size = 12.0, const ci::ColorA &color = ci::Color::black(), TextWeight weight = TextWeight::NORMAL,
+		TextAlignment alignment = TextAlignment::LEFT )
+	{
+		mPango->setDefaultTextStyle( font, size, color, weight, alignment );
+	}
+	const ci::ColorA& getDefaultTextColor() const { return mPango->getDefaultTextColor(); }
+	void setDefaultTextColor( const ci::ColorA &color ) { mPango->setDefaultTextColor( color ); }
+	const ci::ColorA& getBackgroundColor() const { return mPango->getBackgroundColor(); }
+	void setBackgroundColor( const ci::ColorA &color ) { mPango->setBackgroundColor( color ); }
+	float getDefaultTextSize() const { return mPango->getDefaultTextSize(); }
+	void setDefaultTextSize( float size ) { mPango->setDefaultTextSize( size ); }
+	const std::string& getDefaultTextFont() const { return mPango->getDefaultTextFont(); }
+	void setDefaultTextFont( const std::string &font ) { mPango->setDefaultTextFont( font ); }
+	TextWeight getDefaultTextWeight() const { return mPango->getDefaultTextWeight(); }
+	void setDefaultTextWeight( TextWeight weight ) { mPango->setDefaultTextWeight( weight ); }
+	const FontAxes& getDefaultTextAxes() const { return mPango->getDefaultTextAxes(); }
+	void setDefaultTextAxes( const FontAxes &axes ) { mPango->setDefaultTextAxes( axes ); }
+	const TextQuality& getTextQuality() const { return mPango->getTextQuality(); }
+	void setTextQuality( const TextQuality &quality ) { mPango->setTextQuality( quality ); }
+	TextAlignment getTextAlignment() const { return mPango->getTextAlignment(); }
+	void setTextAlignment( TextAlignment alignment ) { mPango->setTextAlignment( alignment ); }
+	bool getDefaultTextSmallCapsEnabled() const { return mPango->getDefaultTextSmallCapsEnabled(); }
+	void setDefaultTextSmallCapsEnabled( bool value ) { mPango->setDefaultTextSmallCapsEnabled( value ); }
+	bool getDefaultTextItalicsEnabled() const { return mPango->getDefaultTextItalicsEnabled(); }
+	void setDefaultTextItalicsEnabled( bool value ) { mPango->setDefaultTextItalicsEnabled( value ); }
+	float getSpacing() const { return mPango->getSpacing(); }
+	void setSpacing( float spacing ) { mPango->setSpacing( spacing ); }
+
+	float getWidth() const { return mWidth; }
+	void setWidth( float width );
+
+	// Total height of the laid out document
+	float getHeight();
+
+	// Visible window in document coordinates
+	float getScrollPosition() const { return mScrollPosition; }
+	void setScrollPosition( float scrollPosition );
+	float getViewportHeight() const { return mViewportHeight; }
+	void setViewportHeight( float height );
+
+	// Extra distance above and below the viewport to rasterize ahead of time
+	float getPrefetchMargin() const { return mPrefetchMargin; }
+	void setPrefetchMargin( float margin );
+
+	// Lays out if needed and brings the tiles in line with the viewport.
+	// Returns true if any tile was rasterized.
+	bool update();
+
+	// Draws the visible tiles with the top of the viewport at origin
+	void draw( const ci::vec2 &origin = ci::vec2( 0, 0 ) );
+
+	size_t getNumTiles() const { return mTiles.size(); }
+	size_t getNumPooledTiles() const { return mTilePool.size(); }
+
+  protected:
+	CinderPangoDocument();
+
+  private:
+	struct Tile {
+		size_t line;
+		int width;
+		int height;
+		cairo_surface_t *surface;
+		cairo_t *context;
+		ci::gl::TextureRef texture;
+	};
+
+	Tile* acquireTile( int width, int height );
+	void recycleTile( Tile *tile );
+	void recycleAllTiles();
+	static void destroyTile( Tile *tile );
+	void renderTile( Tile *tile, PangoLayout *layout, const LayoutIndex::Line &line );
+
+	CinderPangoRef mPango;
+	float mWidth;
+	float mScrollPosition;
+	float mViewportHeight;
+	float mPrefetchMargin;
+
+	uint64_t mLayoutGeneration;
+	ci::ColorA mTextColor;
+	ci::ColorA mBackgroundColor;
+
+	std::vector<Tile *> mTiles; // sorted by line
+	std::vector<Tile *> mTilePool;
+};
+
+}} // namespace kp::pango
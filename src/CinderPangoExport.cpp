@@ -0,0 +1,379 @@
+// CinderPangoExport.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoExport.h"
+#include "CinderPangoCore.h"
+#include "CinderPangoFreeType.h"
+#include "CinderPangoInternal.h"
+#include "CinderPangoLedger.h"
+#include "CinderPangoTrace.h"
+
+#include <cairo-pdf.h>
+#include <cairo-svg.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+using namespace kp::pango;
+using namespace ci;
+
+namespace {
+
+// Copied off the instance's layout on the calling thread, enough for a worker to build an equivalent layout of its own
+struct LayoutSettings {
+	const PangoFontDescription *fontDescription;
+	PangoAlignment alignment;
+	bool justify;
+	bool autoDir;
+	int spacing; // Pango units
+	int width;	 // Pango units
+	double resolution;
+};
+
+// A font map, context and layout of its own, none of them can be shared between threads
+class ExportLayout {
+  public:
+	explicit ExportLayout( const LayoutSettings &settings )
+	{
+		pFontMap = ResourceLedger::track( Resource::FONT_MAP, detail::createFontMap() );
+		pContext = ResourceLedger::track( Resource::PANGO_CONTEXT, pango_font_map_create_context( pFontMap ) );
+		pango_cairo_context_set_resolution( pContext, settings.resolution );
+
+		// Unhinted, so glyph positions scale with the page instead of snapping to a screen's pixel grid
+		cairo_font_options_t *fontOptions = cairo_font_options_create();
+		cairo_font_options_set_hint_style( fontOptions, CAIRO_HINT_STYLE_NONE );
+		cairo_font_options_set_hint_metrics( fontOptions, CAIRO_HINT_METRICS_OFF );
+		pango_cairo_context_set_font_options( pContext, fontOptions );
+		cairo_font_options_destroy( fontOptions );
+
+		pLayout = ResourceLedger::track( Resource::LAYOUT, pango_layout_new( pContext ) );
+		pango_layout_set_font_description( pLayout, settings.fontDescription );
+		pango_layout_set_alignment( pLayout, settings.alignment );
+		pango_layout_set_justify( pLayout, settings.justify );
+		pango_layout_set_auto_dir( pLayout, settings.autoDir );
+		pango_layout_set_spacing( pLayout, settings.spacing );
+		pango_layout_set_width( pLayout, settings.width );
+	}
+
+	~ExportLayout()
+	{
+		ResourceLedger::untrack( Resource::LAYOUT, pLayout );
+		g_object_unref( pLayout );
+		ResourceLedger::untrack( Resource::PANGO_CONTEXT, pContext );
+		g_object_unref( pContext );
+		ResourceLedger::untrack( Resource::FONT_MAP, pFontMap );
+		g_object_unref( pFontMap );
+	}
+
+	ExportLayout( const ExportLayout & ) = delete;
+	ExportLayout& operator=( const ExportLayout & ) = delete;
+
+	void setText( const char *text, int length, PangoAttrList *attributes )
+	{
+		pango_layout_set_text( pLayout, text, length );
+		pango_layout_set_attributes( pLayout, attributes );
+	}
+
+	PangoLayout* get() const { return pLayout; }
+
+  private:
+	PangoFontMap *pFontMap;
+	PangoContext *pContext;
+	PangoLayout *pLayout;
+};
+
+// One worker's share: a contiguous run of pages and the paragraphs they touch
+struct Chunk {
+	size_t firstPage;
+	size_t lastPage;
+	int textStart; // bytes, at a paragraph start
+	int textEnd;
+	size_t lineOffset; // global index of the slice's first line
+	PangoAttrList *attributes;
+};
+
+// Line geometry plus where each line starts in the text and whether it starts a paragraph
+void collectLines( PangoLayout *layout, std::vector<LayoutIndex::Line> &lines, std::vector<int> &startIndices, std::vector<bool> &paragraphStarts )
+{
+	PangoLayoutIter *iter = pango_layout_get_iter( layout );
+	do {
+		PangoLayoutLine *layoutLine = pango_layout_iter_get_line_readonly( iter );
+
+		int y0 = 0;
+		int y1 = 0;
+		pango_layout_iter_get_line_yrange( iter, &y0, &y1 );
+		PangoRectangle lineRect;
+		pango_layout_iter_get_line_extents( iter, nullptr, &lineRect );
+
+		LayoutIndex::Line line;
+		line.left = lineRect.x / static_cast<float>( PANGO_SCALE );
+		line.top = y0 / static_cast<float>( PANGO_SCALE );
+		line.bottom = y1 / static_cast<float>( PANGO_SCALE );
+		line.baseline = pango_layout_iter_get_baseline( iter ) / static_cast<float>( PANGO_SCALE );
+		line.clusterBegin = 0;
+		line.clusterEnd = 0;
+		lines.push_back( line );
+
+		startIndices.push_back( layoutLine->start_index );
+		paragraphStarts.push_back( layoutLine->is_paragraph_start );
+	} while( pango_layout_iter_next_line( iter ) );
+	pango_layout_iter_free( iter );
+}
+
+// Copies of the attributes overlapping [start, end), shifted so the slice starts at 0
+PangoAttrList* sliceAttributes( PangoAttrList *attributes, int start, int end )
+{
+	struct Slice {
+		PangoAttrList *attributes;
+		guint start;
+		guint end;
+	} slice = { ResourceLedger::track( Resource::ATTRIBUTE_LIST, pango_attr_list_new() ), static_cast<guint>( start ), static_cast<guint>( end ) };
+
+	if( attributes ) {
+		// Returning false leaves the source list as it is, the filter is only used to visit every attribute
+		pango_attr_list_filter( attributes,
+			[]( PangoAttribute *attribute, gpointer data ) -> gboolean {
+				Slice *slice = static_cast<Slice *>( data );
+				if( ( attribute->end_index > slice->start ) && ( attribute->start_index < slice->end ) ) {
+					PangoAttribute *copy = pango_attribute_copy( attribute );
+					copy->start_index = std::max( attribute->start_index, slice->start ) - slice->start;
+					copy->end_index = std::min( attribute->end_index, slice->end ) - slice->start;
+					pango_attr_list_insert( slice->attributes, copy );
+				}
+				return FALSE;
+			},
+			&slice );
+	}
+
+	return slice.attributes;
+}
+
+std::string getPagePath( const std::string &path, size_t page, size_t numPages )
+{
+	if( numPages == 1 ) {
+		return path;
+	}
+
+	char number[ 16 ];
+	std::snprintf( number, sizeof( number ), "-%03zu", page + 1 );
+
+	const size_t slash = path.find_last_of( "/\\" );
+	const size_t dot = path.find_last_of( '.' );
+	if( ( dot == std::string::npos ) || ( ( slash != std::string::npos ) && ( dot < slash ) ) ) {
+		return path + number;
+	}
+	return path.substr( 0, dot ) + number + path.substr( dot );
+}
+
+} // anonymous namespace
+
+std::vector<PagedExport::PageRange> PagedExport::paginate( const std::vector<LayoutIndex::Line> &lines, float pageHeight )
+{
+	std::vector<PageRange> pages;
+
+	size_t first = 0;
+	while( first < lines.size() ) {
+		const float top = lines[ first ].top;
+		size_t last = first + 1;
+		while( ( last < lines.size() ) && ( lines[ last ].bottom - top <= pageHeight ) ) {
+			last++;
+		}
+		pages.push_back( { first, last } );
+		first = last;
+	}
+
+	return pages;
+}
+
+ExportResult PagedExport::exportPages( CinderPangoCore &pango, const std::string &path, const ExportOptions &options )
+{
+	ExportResult result;
+	const vec2 contentSize( options.pageSize.x - 2.0f * options.margin, options.pageSize.y - 2.0f * options.margin );
+	if( ( contentSize.x <= 0.0f ) || ( contentSize.y <= 0.0f ) ) {
+		CI_LOG_E( "Page margins leave no room for text." );
+		return result;
+	}
+
+	// Paginate with a layout of the whole text at the content width
+	auto startTime = std::chrono::steady_clock::now();
+
+	PangoLayout *source = pango.getPangoLayout( true );
+	const char *text = pango_layout_get_text( source );
+	PangoAttrList *attributes = pango_layout_get_attributes( source );
+	const ColorA textColor = pango.getDefaultTextColor();
+	const ColorA backgroundColor = pango.getBackgroundColor();
+
+	LayoutSettings settings;
+	settings.fontDescription = pango_layout_get_font_description( source );
+	settings.alignment = pango_layout_get_alignment( source );
+	settings.justify = pango_layout_get_justify( source );
+	settings.autoDir = pango_layout_get_auto_dir( source );
+	settings.spacing = pango_layout_get_spacing( source );
+	settings.width = static_cast<int>( contentSize.x * PANGO_SCALE );
+	settings.resolution = options.resolution;
+
+	std::vector<LayoutIndex::Line> lines;
+	std::vector<int> startIndices;
+	std::vector<bool> paragraphStarts;
+	{
+		TraceScope trace( "PagedExport::paginate" );
+		ExportLayout layout( settings );
+		layout.setText( text, -1, attributes );
+		collectLines( layout.get(), lines, startIndices, paragraphStarts );
+	}
+
+	const std::vector<PageRange> pages = paginate( lines, contentSize.y );
+	result.numPages = pages.size();
+
+	// Contiguous runs of pages, one per worker. Paragraphs are laid out independently of each other, so a slice
+	// from a paragraph start breaks into the same lines as the whole text did.
+	size_t numThreads = ( options.numThreads > 0 ) ? options.numThreads : std::max<size_t>( std::thread::hardware_concurrency(), 1 );
+	numThreads = std::min( numThreads, pages.size() );
+
+	const int textLength = static_cast<int>( strlen( text ) );
+	std::vector<Chunk> chunks;
+	for( size_t i = 0; i < numThreads; i++ ) {
+		Chunk chunk;
+		chunk.firstPage = pages.size() * i / numThreads;
+		chunk.lastPage = pages.size() * ( i + 1 ) / numThreads;
+
+		size_t firstLine = pages[ chunk.firstPage ].firstLine;
+		while( ! paragraphStarts[ firstLine ] ) {
+			firstLine--;
+		}
+		size_t endLine = pages[ chunk.lastPage - 1 ].lastLine;
+		while( ( endLine < lines.size() ) && ! paragraphStarts[ endLine ] ) {
+			endLine++;
+		}
+
+		chunk.lineOffset = firstLine;
+		chunk.textStart = startIndices[ firstLine ];
+		chunk.textEnd = ( endLine < lines.size() ) ? startIndices[ endLine ] : textLength;
+		chunk.attributes = sliceAttributes( attributes, chunk.textStart, chunk.textEnd );
+		chunks.push_back( chunk );
+	}
+
+	result.layoutSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+	startTime = std::chrono::steady_clock::now();
+
+	// Render the pages, into recordings for the PDF to replay or straight into their own SVG files
+	std::vector<cairo_surface_t *> recordings( pages.size(), nullptr );
+	std::vector<std::string> pagePaths( pages.size() );
+	std::vector<char> pageWritten( pages.size(), 0 );
+
+	auto renderChunk = [&]( const Chunk &chunk ) {
+		TraceScope trace( "PagedExport::renderPages" );
+		detail::FontSetReadScope fontSetScope;
+		ExportLayout layout( settings );
+		layout.setText( text + chunk.textStart, chunk.textEnd - chunk.textStart, chunk.attributes );
+
+		// Walk the slice's lines once, getting each by index would be quadratic
+		GSList *layoutLines = pango_layout_get_lines_readonly( layout.get() );
+		for( size_t i = chunk.lineOffset; i < pages[ chunk.firstPage ].firstLine; i++ ) {
+			layoutLines = layoutLines ? layoutLines->next : nullptr;
+		}
+
+		for( size_t p = chunk.firstPage; p < chunk.lastPage; p++ ) {
+			cairo_surface_t *surface = nullptr;
+			if( options.format == ExportFormat::PDF ) {
+				const cairo_rectangle_t extents = { 0.0, 0.0, options.pageSize.x, options.pageSize.y };
+				surface = cairo_recording_surface_create( CAIRO_CONTENT_COLOR_ALPHA, &extents );
+			} else {
+				pagePaths[ p ] = getPagePath( path, p, pages.size() );
+				surface = cairo_svg_surface_create( pagePaths[ p ].c_str(), options.pageSize.x, options.pageSize.y );
+			}
+			ResourceLedger::track( Resource::SURFACE, surface );
+
+			cairo_t *context = ResourceLedger::track( Resource::CAIRO_CONTEXT, cairo_create( surface ) );
+			if( backgroundColor.a > 0.0f ) {
+				cairo_set_source_rgba( context, backgroundColor.r, backgroundColor.g, backgroundColor.b, backgroundColor.a );
+				cairo_paint( context );
+			}
+
+			// Positions come from the paginating layout, the slice's lines are the same lines
+			cairo_set_source_rgba( context, textColor.r, textColor.g, textColor.b, textColor.a );
+			const float pageTop = lines[ pages[ p ].firstLine ].top;
+			for( size_t i = pages[ p ].firstLine; ( i < pages[ p ].lastLine ) && layoutLines; i++ ) {
+				const LayoutIndex::Line &line = lines[ i ];
+				cairo_move_to( context, options.margin + line.left, options.margin + line.baseline - pageTop );
+				pango_cairo_show_layout_line( context, static_cast<PangoLayoutLine *>( layoutLines->data ) );
+				layoutLines = layoutLines->next;
+			}
+
+			ResourceLedger::untrack( Resource::CAIRO_CONTEXT, context );
+			cairo_destroy( context );
+
+			if( options.format == ExportFormat::PDF ) {
+				recordings[ p ] = surface;
+				pageWritten[ p ] = ( cairo_surface_status( surface ) == CAIRO_STATUS_SUCCESS );
+			} else {
+				cairo_surface_finish( surface );
+				pageWritten[ p ] = ( cairo_surface_status( surface ) == CAIRO_STATUS_SUCCESS );
+				ResourceLedger::untrack( Resource::SURFACE, surface );
+				cairo_surface_destroy( surface );
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for( size_t i = 1; i < chunks.size(); i++ ) {
+		threads.emplace_back( renderChunk, std::cref( chunks[ i ] ) );
+	}
+	if( ! chunks.empty() ) {
+		renderChunk( chunks[ 0 ] );
+	}
+	for( auto &thread : threads ) {
+		thread.join();
+	}
+
+	for( Chunk &chunk : chunks ) {
+		ResourceLedger::untrack( Resource::ATTRIBUTE_LIST, chunk.attributes );
+		pango_attr_list_unref( chunk.attributes );
+	}
+
+	result.renderSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+	startTime = std::chrono::steady_clock::now();
+
+	result.success = std::all_of( pageWritten.begin(), pageWritten.end(), []( char written ) { return written != 0; } );
+
+	if( options.format == ExportFormat::PDF ) {
+		TraceScope trace( "PagedExport::write" );
+
+		// Replaying a recording keeps it vector, text stays text
+		cairo_surface_t *pdf = ResourceLedger::track( Resource::SURFACE, cairo_pdf_surface_create( path.c_str(), options.pageSize.x, options.pageSize.y ) );
+		cairo_t *context = ResourceLedger::track( Resource::CAIRO_CONTEXT, cairo_create( pdf ) );
+		for( cairo_surface_t *recording : recordings ) {
+			cairo_set_source_surface( context, recording, 0.0, 0.0 );
+			cairo_paint( context );
+			cairo_show_page( context );
+		}
+		ResourceLedger::untrack( Resource::CAIRO_CONTEXT, context );
+		cairo_destroy( context );
+
+		cairo_surface_finish( pdf );
+		result.success = result.success && ( cairo_surface_status( pdf ) == CAIRO_STATUS_SUCCESS );
+		ResourceLedger::untrack( Resource::SURFACE, pdf );
+		cairo_surface_destroy( pdf );
+
+		for( cairo_surface_t *recording : recordings ) {
+			ResourceLedger::untrack( Resource::SURFACE, recording );
+			cairo_surface_destroy( recording );
+		}
+
+		result.paths.push_back( path );
+	} else {
+		result.paths = pagePaths;
+	}
+
+	result.writeSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+
+	if( ! result.success ) {
+		CI_LOG_E( "Error exporting pages to " << path );
+	}
+
+	return result;
+}
@@ -0,0 +1,58 @@
+// CinderPangoExport.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPangoLayoutIndex.h"
+
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+class CinderPangoCore;
+
+enum class ExportFormat {
+	PDF, // one file, one page after another
+	SVG, // one file per page, numbered before the extension when there's more than one (page-001.svg, ...)
+};
+
+struct ExportOptions {
+	ExportFormat format = ExportFormat::PDF;
+	ci::vec2 pageSize = ci::vec2( 595.0f, 842.0f ); // points, A4 portrait
+	float margin = 56.0f;							// points, all four sides
+	float resolution = 72.0f; // dpi the font sizes are read at, 72 makes size 12 text 12pt on paper (the screen uses Pango's 96)
+	size_t numThreads = 0;	  // 0 for all cores
+};
+
+struct ExportResult {
+	bool success = false;
+	size_t numPages = 0;
+	std::vector<std::string> paths;
+	double layoutSeconds = 0.0; // laying out the whole text once to paginate
+	double renderSeconds = 0.0; // the pages, in parallel
+	double writeSeconds = 0.0;	// assembling the PDF
+};
+
+// Vector export of a CinderPangoCore's text across as many pages as it takes, without rasterizing anything.
+// The text is laid out once at the page's content width and split into pages between lines. The pages are then
+// divided into one contiguous run per worker thread. Each worker lays out just the paragraphs its pages touch with
+// its own font map (Pango objects can't be shared across threads) and draws them into recording surfaces (PDF) or
+// straight into SVG files. The PDF is assembled from the recordings in page order at the end. While the workers run,
+// FontWatcher and FontVariations defer changes to fontconfig's font sets and FontPack waits.
+class PagedExport {
+  public:
+	struct PageRange {
+		size_t firstLine;
+		size_t lastLine; // one past the end
+	};
+
+	// Breaks only between lines. Every page gets at least one line, even one taller than the page.
+	static std::vector<PageRange> paginate( const std::vector<LayoutIndex::Line> &lines, float pageHeight );
+
+	// Uses the instance's text, markup, typed attributes, font, alignment, spacing and colors. Its max size is ignored.
+	static ExportResult exportPages( CinderPangoCore &pango, const std::string &path, const ExportOptions &options = ExportOptions() );
+};
+
+}} // namespace kp::pango
@@ -0,0 +1,524 @@
+// CinderPangoFallback.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoFallback.h"
+#include "CinderPangoInternal.h"
+#include "CinderPangoLedger.h"
+#include "CinderPangoMetrics.h"
+#include "CinderPangoTrace.h"
+
+#include <fontconfig/fontconfig.h>
+#include <pango/pangofc-fontmap.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace kp::pango;
+
+namespace {
+
+// Characters every script uses (digits, punctuation, symbols, combining marks) are cached per code point block instead
+const uint32_t kBlockKey = 0x80000000;
+
+// One request's fontconfig match, sorted the way Pango walks it
+struct FallbackEntry {
+	FcFontSet *fonts = nullptr;
+	std::vector<FcCharSet *> charsets; // owned by the patterns in fonts
+	std::vector<std::string> families;
+	std::vector<std::string> requestedFamilies;
+	bool familyAvailable = false;
+	std::unordered_map<uint32_t, int> resolved; // cache key -> index of the fallback font last found for it
+
+	~FallbackEntry()
+	{
+		if( fonts ) {
+			FcFontSetDestroy( fonts );
+		}
+	}
+};
+
+std::mutex sMutex;
+std::unordered_map<std::string, std::unique_ptr<FallbackEntry>> sEntries;
+std::atomic<uint64_t> sGeneration( 0 );
+
+// What invalidate() was told, the most recent ones. Instances further behind than that treat themselves as affected.
+struct FontChangeRecord {
+	uint64_t serial;
+	std::vector<std::string> families;
+	bool addsCoverage;
+};
+
+const size_t kMaxFontChanges = 64;
+std::mutex sChangesMutex;
+std::vector<FontChangeRecord> sChanges;
+std::atomic<uint64_t> sChangeSerial( 0 );
+
+// Every font map the library created that's still alive, with the change serial it last dropped its cached fonts at
+std::mutex sFontMapCachesMutex;
+std::unordered_map<const PangoFontMap *, uint64_t> sFontMapCaches;
+
+void forgetFontMap( gpointer, GObject *fontMap )
+{
+	std::lock_guard<std::mutex> lock( sFontMapCachesMutex );
+	sFontMapCaches.erase( reinterpret_cast<const PangoFontMap *>( fontMap ) );
+}
+
+std::atomic<bool> sSharedFontMapEnabled( false );
+std::mutex sSharedFontMapsMutex;
+std::unordered_set<const PangoFontMap *> sSharedFontMaps;
+
+// Owned by the thread, instances only add references. Tracked once here rather than by every instance sharing it.
+struct ThreadFontMap {
+	PangoFontMap *fontMap = nullptr;
+	uint64_t generation = 0;
+
+	~ThreadFontMap()
+	{
+		if( fontMap ) {
+			{
+				std::lock_guard<std::mutex> lock( sSharedFontMapsMutex );
+				sSharedFontMaps.erase( fontMap );
+			}
+			ResourceLedger::untrack( Resource::FONT_MAP, fontMap );
+			g_object_unref( fontMap );
+		}
+	}
+};
+
+thread_local ThreadFontMap tThreadFontMap;
+
+int toFcWeight( PangoWeight weight )
+{
+	// Same steps Pango uses when it builds its own patterns
+	if( weight <= ( PANGO_WEIGHT_THIN + PANGO_WEIGHT_ULTRALIGHT ) / 2 ) return FC_WEIGHT_THIN;
+	if( weight <= ( PANGO_WEIGHT_ULTRALIGHT + PANGO_WEIGHT_LIGHT ) / 2 ) return FC_WEIGHT_ULTRALIGHT;
+	if( weight <= ( PANGO_WEIGHT_LIGHT + PANGO_WEIGHT_BOOK ) / 2 ) return FC_WEIGHT_LIGHT;
+	if( weight <= ( PANGO_WEIGHT_BOOK + PANGO_WEIGHT_NORMAL ) / 2 ) return FC_WEIGHT_BOOK;
+	if( weight <= ( PANGO_WEIGHT_NORMAL + PANGO_WEIGHT_MEDIUM ) / 2 ) return FC_WEIGHT_NORMAL;
+	if( weight <= ( PANGO_WEIGHT_MEDIUM + PANGO_WEIGHT_SEMIBOLD ) / 2 ) return FC_WEIGHT_MEDIUM;
+	if( weight <= ( PANGO_WEIGHT_SEMIBOLD + PANGO_WEIGHT_BOLD ) / 2 ) return FC_WEIGHT_DEMIBOLD;
+	if( weight <= ( PANGO_WEIGHT_BOLD + PANGO_WEIGHT_ULTRABOLD ) / 2 ) return FC_WEIGHT_BOLD;
+	if( weight <= ( PANGO_WEIGHT_ULTRABOLD + PANGO_WEIGHT_HEAVY ) / 2 ) return FC_WEIGHT_ULTRABOLD;
+	return FC_WEIGHT_BLACK;
+}
+
+std::string getFamily( FcPattern *pattern )
+{
+	FcChar8 *family = nullptr;
+	return ( FcPatternGetString( pattern, FC_FAMILY, 0, &family ) == FcResultMatch ) ? reinterpret_cast<const char *>( family ) : "";
+}
+
+std::unique_ptr<FallbackEntry> createEntry( const std::string &font )
+{
+	TraceScope trace( "fallback.sort" );
+	std::unique_ptr<FallbackEntry> entry( new FallbackEntry() );
+
+	PangoFontDescription *description = pango_font_description_from_string( font.c_str() );
+	FcPattern *pattern = FcPatternCreate();
+
+	std::vector<std::string> requestedFamilies;
+	if( const char *families = pango_font_description_get_family( description ) ) {
+		gchar **names = g_strsplit( families, ",", -1 );
+		for( gchar **name = names; *name; name++ ) {
+			g_strstrip( *name );
+			if( **name ) {
+				requestedFamilies.push_back( *name );
+				FcPatternAddString( pattern, FC_FAMILY, reinterpret_cast<const FcChar8 *>( *name ) );
+			}
+		}
+		g_strfreev( names );
+	}
+
+	const PangoStyle style = pango_font_description_get_style( description );
+	FcPatternAddInteger( pattern, FC_WEIGHT, toFcWeight( pango_font_description_get_weight( description ) ) );
+	FcPatternAddInteger( pattern, FC_SLANT, ( style == PANGO_STYLE_ITALIC ) ? FC_SLANT_ITALIC : ( style == PANGO_STYLE_OBLIQUE ) ? FC_SLANT_OBLIQUE : FC_SLANT_ROMAN );
+	FcPatternAddString( pattern, FC_LANG, reinterpret_cast<const FcChar8 *>( pango_language_to_string( pango_language_get_default() ) ) );
+	pango_font_description_free( description );
+
+	FcConfigSubstitute( nullptr, pattern, FcMatchPattern );
+	FcDefaultSubstitute( pattern );
+
+	FcResult result;
+	entry->fonts = FcFontSort( nullptr, pattern, FcTrue, nullptr, &result );
+	FcPatternDestroy( pattern );
+
+	if( ! entry->fonts || ( entry->fonts->nfont == 0 ) ) {
+		CI_LOG_E( "Fontconfig has no fonts for \"" << font << "\"" );
+		return entry;
+	}
+
+	for( int i = 0; i < entry->fonts->nfont; i++ ) {
+		FcCharSet *charset = nullptr;
+		FcPatternGetCharSet( entry->fonts->fonts[ i ], FC_CHARSET, 0, &charset );
+		entry->charsets.push_back( charset );
+		entry->families.push_back( getFamily( entry->fonts->fonts[ i ] ) );
+	}
+
+	entry->requestedFamilies = requestedFamilies;
+
+	// Any of the primary font's family names (they can be localized) matching the first family asked for
+	entry->familyAvailable = requestedFamilies.empty();
+	FcChar8 *family = nullptr;
+	for( int n = 0; ! entry->familyAvailable && ( FcPatternGetString( entry->fonts->fonts[ 0 ], FC_FAMILY, n, &family ) == FcResultMatch ); n++ ) {
+		entry->familyAvailable = ( g_ascii_strcasecmp( reinterpret_cast<const char *>( family ), requestedFamilies[ 0 ].c_str() ) == 0 );
+	}
+
+	return entry;
+}
+
+FallbackEntry& getEntry( const std::string &font )
+{
+	auto found = sEntries.find( font );
+	if( found == sEntries.end() ) {
+		found = sEntries.emplace( font, createEntry( font ) ).first;
+	}
+	return *found->second;
+}
+
+uint32_t getCacheKey( gunichar character )
+{
+	const GUnicodeScript script = g_unichar_get_script( character );
+	if( ( script == G_UNICODE_SCRIPT_COMMON ) || ( script == G_UNICODE_SCRIPT_INHERITED ) || ( script == G_UNICODE_SCRIPT_UNKNOWN ) ) {
+		return kBlockKey | ( character >> 7 );
+	}
+	return static_cast<uint32_t>( script );
+}
+
+bool hasCharacter( const FallbackEntry &entry, int index, gunichar character )
+{
+	return entry.charsets[ index ] && FcCharSetHasChar( entry.charsets[ index ], character );
+}
+
+// Index of the font that draws the character, -1 if none does. The primary font always wins when it has the character.
+// Otherwise the font found for the script before is tried, and only a miss walks the list. That skips fonts between the
+// primary and the cached one that might also have the character, which within one script is rare.
+int findFont( FallbackEntry &entry, gunichar character )
+{
+	if( entry.charsets.empty() ) {
+		return -1;
+	}
+
+	if( hasCharacter( entry, 0, character ) ) {
+		Metrics::increment( Counter::FALLBACK_CACHE_HITS );
+		return 0;
+	}
+
+	const uint32_t key = getCacheKey( character );
+	auto cached = entry.resolved.find( key );
+	if( ( cached != entry.resolved.end() ) && ( cached->second > 0 ) && hasCharacter( entry, cached->second, character ) ) {
+		Metrics::increment( Counter::FALLBACK_CACHE_HITS );
+		return cached->second;
+	}
+
+	Metrics::increment( Counter::FALLBACK_CACHE_MISSES );
+	for( int i = 1; i < static_cast<int>( entry.charsets.size() ); i++ ) {
+		if( hasCharacter( entry, i, character ) ) {
+			entry.resolved[ key ] = i;
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool containsFamily( const std::vector<std::string> &families, const std::vector<std::string> &candidates )
+{
+	for( const std::string &family : families ) {
+		for( const std::string &candidate : candidates ) {
+			if( g_ascii_strcasecmp( family.c_str(), candidate.c_str() ) == 0 ) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Whether the coverage has characters none of the entry's fonts has. The sorted list is trimmed to fonts that add
+// characters, so this is everything the request could draw.
+bool addsCoverage( const FallbackEntry &entry, const FcCharSet *coverage )
+{
+	FcCharSet *remaining = FcCharSetCopy( const_cast<FcCharSet *>( coverage ) );
+	for( FcCharSet *charset : entry.charsets ) {
+		if( ! charset ) {
+			continue;
+		}
+		FcCharSet *next = FcCharSetSubtract( remaining, charset );
+		FcCharSetDestroy( remaining );
+		remaining = next;
+		if( FcCharSetCount( remaining ) == 0 ) {
+			break;
+		}
+	}
+	const bool adds = ( FcCharSetCount( remaining ) > 0 );
+	FcCharSetDestroy( remaining );
+	return adds;
+}
+
+} // anonymous namespace
+
+PangoFontMap* detail::createFontMap()
+{
+	PangoFontMap *fontMap = pango_cairo_font_map_new();
+	if( fontMap ) {
+		std::lock_guard<std::mutex> lock( sFontMapCachesMutex );
+		sFontMapCaches[ fontMap ] = FontFallback::getChangeSerial();
+		g_object_weak_ref( G_OBJECT( fontMap ), forgetFontMap, nullptr );
+	}
+	return fontMap;
+}
+
+void detail::clearFontMapCache( PangoFontMap *fontMap )
+{
+	// Read before clearing, a change made meanwhile is one the map may still have fonts from
+	const uint64_t serial = FontFallback::getChangeSerial();
+	if( PANGO_IS_FC_FONT_MAP( fontMap ) ) {
+		pango_fc_font_map_cache_clear( PANGO_FC_FONT_MAP( fontMap ) );
+	}
+
+	std::lock_guard<std::mutex> lock( sFontMapCachesMutex );
+	auto found = sFontMapCaches.find( fontMap );
+	if( found != sFontMapCaches.end() ) {
+		found->second = serial;
+	}
+}
+
+uint64_t detail::getOldestFontMapCache()
+{
+	uint64_t oldest = FontFallback::getChangeSerial();
+	std::lock_guard<std::mutex> lock( sFontMapCachesMutex );
+	for( const auto &fontMap : sFontMapCaches ) {
+		oldest = std::min( oldest, fontMap.second );
+	}
+	return oldest;
+}
+
+std::string FontFallback::resolve( const std::string &font, uint32_t character )
+{
+	std::lock_guard<std::mutex> lock( sMutex );
+	FallbackEntry &entry = getEntry( font );
+	const int index = findFont( entry, character );
+	return ( index >= 0 ) ? entry.families[ index ] : "";
+}
+
+CoverageReport FontFallback::getCoverage( const std::string &font, const std::string &text )
+{
+	TraceScope trace( "fallback.getCoverage" );
+	CoverageReport report;
+
+	if( ! g_utf8_validate( text.c_str(), text.size(), nullptr ) ) {
+		CI_LOG_E( "Coverage text is not valid UTF-8." );
+		return report;
+	}
+
+	std::lock_guard<std::mutex> lock( sMutex );
+	FallbackEntry &entry = getEntry( font );
+	if( entry.families.empty() ) {
+		report.hasMissingGlyphs = ! text.empty();
+		return report;
+	}
+
+	report.primaryFamily = entry.families[ 0 ];
+	report.familyAvailable = entry.familyAvailable;
+
+	const char *begin = text.c_str();
+	const char *end = begin + text.size();
+	for( const char *position = begin; position < end; position = g_utf8_next_char( position ) ) {
+		const size_t start = position - begin;
+		const size_t next = g_utf8_next_char( position ) - begin;
+		const gunichar character = g_utf8_get_char( position );
+
+		if( ! report.runs.empty() && ( g_unichar_isspace( character ) || g_unichar_iscntrl( character ) ) ) {
+			report.runs.back().end = next;
+			continue;
+		}
+
+		const int index = findFont( entry, character );
+		const std::string &family = ( index >= 0 ) ? entry.families[ index ] : "";
+		if( ! report.runs.empty() && ( report.runs.back().family == family ) ) {
+			report.runs.back().end = next;
+			continue;
+		}
+
+		const bool isFallback = ( index >= 0 ) && ( family != report.primaryFamily );
+		report.runs.push_back( { start, next, family, isFallback } );
+
+		if( index < 0 ) {
+			report.hasMissingGlyphs = true;
+		} else if( isFallback && ( std::find( report.fallbackFamilies.begin(), report.fallbackFamilies.end(), family ) == report.fallbackFamilies.end() ) ) {
+			report.fallbackFamilies.push_back( family );
+		}
+	}
+
+	report.covered = report.familyAvailable && ! report.hasMissingGlyphs && report.fallbackFamilies.empty();
+	return report;
+}
+
+bool FontFallback::covers( const std::string &font, const std::string &text )
+{
+	return getCoverage( font, text ).covered;
+}
+
+void FontFallback::preResolve( const std::string &font, const std::string &text, float size )
+{
+	TraceScope trace( "fallback.preResolve" );
+	getCoverage( font, text );
+
+	if( ! isSharedFontMapEnabled() ) {
+		return;
+	}
+
+	// Itemizing and shaping once loads every fallback font into the shared map. Pango's caches are keyed by the
+	// context's font options too, this matches instances left at the default quality.
+	PangoFontMap *fontMap = acquireFontMap();
+	if( ! fontMap ) {
+		return;
+	}
+	PangoContext *context = ResourceLedger::track( Resource::PANGO_CONTEXT, pango_font_map_create_context( fontMap ) );
+	cairo_font_options_t *fontOptions = ResourceLedger::track( Resource::FONT_OPTIONS, cairo_font_options_create() );
+	detail::applyFontOptions( context, fontOptions, TextQuality() );
+	PangoLayout *layout = ResourceLedger::track( Resource::LAYOUT, pango_layout_new( context ) );
+	PangoFontDescription *fontDescription = detail::createFontDescription( font, size, TextWeight::NORMAL, false, false );
+
+	pango_layout_set_font_description( layout, fontDescription );
+	pango_layout_set_text( layout, text.c_str(), static_cast<int>( text.size() ) );
+	pango_layout_get_extents( layout, nullptr, nullptr );
+
+	ResourceLedger::untrack( Resource::FONT_DESCRIPTION, fontDescription );
+	pango_font_description_free( fontDescription );
+	ResourceLedger::untrack( Resource::LAYOUT, layout );
+	g_object_unref( layout );
+	ResourceLedger::untrack( Resource::FONT_OPTIONS, fontOptions );
+	cairo_font_options_destroy( fontOptions );
+	ResourceLedger::untrack( Resource::PANGO_CONTEXT, context );
+	g_object_unref( context );
+	releaseFontMap( fontMap );
+}
+
+void FontFallback::setSharedFontMapEnabled( bool enabled )
+{
+	sSharedFontMapEnabled = enabled;
+}
+
+bool FontFallback::isSharedFontMapEnabled()
+{
+	return sSharedFontMapEnabled;
+}
+
+PangoFontMap* FontFallback::acquireFontMap()
+{
+	if( ! isSharedFontMapEnabled() ) {
+		return ResourceLedger::track( Resource::FONT_MAP, detail::createFontMap() );
+	}
+
+	ThreadFontMap &shared = tThreadFontMap;
+	const uint64_t generation = getGeneration();
+
+	if( ! shared.fontMap ) {
+		shared.fontMap = ResourceLedger::track( Resource::FONT_MAP, detail::createFontMap() );
+		if( ! shared.fontMap ) {
+			return nullptr;
+		}
+		std::lock_guard<std::mutex> lock( sSharedFontMapsMutex );
+		sSharedFontMaps.insert( shared.fontMap );
+	} else if( shared.generation != generation ) {
+		detail::clearFontMapCache( shared.fontMap );
+	}
+
+	shared.generation = generation;
+	return static_cast<PangoFontMap *>( g_object_ref( shared.fontMap ) );
+}
+
+void FontFallback::releaseFontMap( PangoFontMap *fontMap )
+{
+	if( ! fontMap ) {
+		return;
+	}
+
+	bool shared;
+	{
+		std::lock_guard<std::mutex> lock( sSharedFontMapsMutex );
+		shared = ( sSharedFontMaps.count( fontMap ) > 0 );
+	}
+
+	if( ! shared ) {
+		ResourceLedger::untrack( Resource::FONT_MAP, fontMap );
+	}
+	g_object_unref( fontMap );
+}
+
+void FontFallback::clear()
+{
+	{
+		std::lock_guard<std::mutex> lock( sMutex );
+		sEntries.clear();
+		sGeneration++;
+	}
+
+	// Other threads' shared maps catch up when they're next acquired, the calling thread's can be cleared right away.
+	// So can its default map, which getFontList lists families from.
+	if( tThreadFontMap.fontMap ) {
+		detail::clearFontMapCache( tThreadFontMap.fontMap );
+		tThreadFontMap.generation = getGeneration();
+	}
+	detail::clearFontMapCache( pango_cairo_font_map_get_default() );
+}
+
+uint64_t FontFallback::getGeneration()
+{
+	return sGeneration;
+}
+
+void FontFallback::invalidate( const std::vector<std::string> &families, const FcCharSet *coverage )
+{
+	TraceScope trace( "fallback.invalidate" );
+	const bool hasCoverage = coverage && ( FcCharSetCount( const_cast<FcCharSet *>( coverage ) ) > 0 );
+	{
+		std::lock_guard<std::mutex> lock( sMutex );
+		for( auto entry = sEntries.begin(); entry != sEntries.end(); ) {
+			const FallbackEntry &fallback = *entry->second;
+			if( containsFamily( fallback.requestedFamilies, families ) || containsFamily( fallback.families, families ) ||
+				( hasCoverage && addsCoverage( fallback, coverage ) ) ) {
+				entry = sEntries.erase( entry );
+			} else {
+				++entry;
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( sChangesMutex );
+		sChanges.push_back( { sChangeSerial + 1, families, hasCoverage } );
+		if( sChanges.size() > kMaxFontChanges ) {
+			sChanges.erase( sChanges.begin() );
+		}
+		sChangeSerial++;
+	}
+
+	// Lists families, nothing lays out with it
+	detail::clearFontMapCache( pango_cairo_font_map_get_default() );
+}
+
+uint64_t FontFallback::getChangeSerial()
+{
+	return sChangeSerial;
+}
+
+bool FontFallback::isAffected( uint64_t sinceSerial, const std::vector<std::string> &families, bool hasMissingGlyphs )
+{
+	std::lock_guard<std::mutex> lock( sChangesMutex );
+	if( sChanges.empty() || ( sChanges.front().serial > sinceSerial + 1 ) ) {
+		// Older changes were dropped from the log
+		return sinceSerial < sChangeSerial;
+	}
+
+	for( const FontChangeRecord &change : sChanges ) {
+		if( ( change.serial > sinceSerial ) && ( containsFamily( change.families, families ) || ( hasMissingGlyphs && change.addsCoverage ) ) ) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,77 @@
+// CinderPangoFallback.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <fontconfig/fontconfig.h>
+#include <pango/pangocairo.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+struct CoverageRun {
+	size_t start; // byte offsets into the text
+	size_t end;	  // one past the end
+	std::string family; // empty when no installed font has these characters
+	bool isFallback;
+};
+
+struct CoverageReport {
+	std::string primaryFamily;		// what the request resolves to before any fallback
+	bool familyAvailable = false;	// primaryFamily is the requested family, not a substitute for a missing one
+	bool covered = false;			// familyAvailable and every character is drawn from it
+	bool hasMissingGlyphs = false;	// some characters aren't in any font and will show as boxes
+	std::vector<CoverageRun> runs;	// whitespace and control characters join the run they're in
+	std::vector<std::string> fallbackFamilies; // in order of first use
+};
+
+// Which font ends up drawing which characters, answered ahead of time from fontconfig's sorted match for the request,
+// the same list Pango walks during itemization. Each request's sorted list is kept for the life of the process together
+// with the font picked per (request, script), or per 128 code point block for characters shared between scripts, so
+// asking again about text in a script that's been seen before is a couple of charset lookups.
+// Answers follow fontconfig, i.e. the FREETYPE renderer, and are thread safe.
+//
+// The cache only helps the queries: every CinderPangoCore has its own font map, and Pango caches the fallback fonts it
+// finds per font map. With the shared font map enabled, instances created on the same thread share one, and preResolve
+// can do that first, slow itemization up front. Only enable it if instances stay on the thread they were created on.
+class FontFallback {
+  public:
+	// font is a Pango font description string, e.g. "Noto Sans Bold" or "Serif, Noto Sans CJK JP"
+	static std::string resolve( const std::string &font, uint32_t character );
+	static CoverageReport getCoverage( const std::string &font, const std::string &text );
+	static bool covers( const std::string &font, const std::string &text );
+
+	// Fills the cache for the text's scripts and, with the shared font map enabled, lays it out once on this thread's
+	// map so Pango has the fallback fonts loaded. Pango keys those by size, so pass the sizes the text is rendered at.
+	static void preResolve( const std::string &font, const std::string &text, float size = 12.0f );
+
+	static void setSharedFontMapEnabled( bool enabled );
+	static bool isSharedFontMapEnabled();
+
+	// A new font map, or a reference to this thread's shared one. Give it back with releaseFontMap.
+	static PangoFontMap* acquireFontMap();
+	static void releaseFontMap( PangoFontMap *fontMap );
+
+	// Forgets everything resolved so far, for when the installed fonts change (loadFont calls this). Shared font maps
+	// drop their Pango caches the next time they're acquired.
+	static void clear();
+	static uint64_t getGeneration();
+
+	// The selective counterpart of clear(), for fonts added, replaced or removed while instances are alive (see
+	// FontWatcher). families are those of the faces involved, coverage the characters the new faces have, if any.
+	// Forgets the entries that ask for or fall back to one of the families, and the ones missing characters the new
+	// faces have, the rest stay cached. Instances check the change on their next render or measure, and only lay out
+	// again if their text uses one of the families or has characters no font had. A new font that would merely
+	// outrank a fallback already drawing the characters isn't noticed until the next clear().
+	static void invalidate( const std::vector<std::string> &families, const FcCharSet *coverage = nullptr );
+	// Increases with every invalidate()
+	static uint64_t getChangeSerial();
+	// Whether any change after sinceSerial involves one of the families, or added characters when hasMissingGlyphs
+	static bool isAffected( uint64_t sinceSerial, const std::vector<std::string> &families, bool hasMissingGlyphs );
+};
+
+}} // namespace kp::pango
@@ -0,0 +1,210 @@
+// CinderPangoFontPack.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoFontPack.h"
+#include "CinderPangoFallback.h"
+#include "CinderPangoFreeType.h"
+#include "CinderPangoMetrics.h"
+#include "CinderPangoTrace.h"
+
+#include <memory>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace kp::pango;
+
+namespace {
+
+// Everything the registered faces point into. Never destroyed, fontconfig's patterns keep referencing the faces until
+// the process exits.
+struct Registry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<std::vector<unsigned char>>> buffers;
+	std::vector<FT_Face> faces;
+	size_t mappedBytes = 0;
+};
+
+Registry& getRegistry()
+{
+	static Registry *registry = new Registry();
+	return *registry;
+}
+
+// Called with the registry locked. The data has to outlive the process' use of the faces.
+std::vector<std::string> registerFaces( Registry &registry, const unsigned char *data, size_t size, const std::string &name )
+{
+	TraceScope trace( "fontPack.register" );
+	std::vector<std::string> families;
+	detail::FontSetWriteLock fontSetLock( true );
+	std::lock_guard<std::mutex> lock( detail::getFreeTypeMutex() );
+
+	FT_Long numFaces = 1;
+	for( FT_Long index = 0; index < numFaces; index++ ) {
+		FT_Face face = nullptr;
+		if( detail::newMemoryFace( data, static_cast<FT_Long>( size ), index, &face ) != 0 ) {
+			CI_LOG_E( "FreeType could not open face " << index << " of \"" << name << "\"" );
+			continue;
+		}
+		numFaces = face->num_faces;
+
+		const std::string family = detail::registerFace( face, name, static_cast<int>( index ) );
+		if( family.empty() ) {
+			detail::doneFace( face );
+			continue;
+		}
+		families.push_back( family );
+		registry.faces.push_back( face );
+	}
+
+	if( ! families.empty() ) {
+		Metrics::increment( Counter::FONT_FILES_LOADED );
+	}
+	return families;
+}
+
+const unsigned char* mapFile( const ci::fs::path &path, size_t &size )
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileW( path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE ) {
+		return nullptr;
+	}
+
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = GetFileSizeEx( file, &fileSize ) && ( fileSize.QuadPart > 0 ) ? CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr ) : nullptr;
+	CloseHandle( file );
+	if( ! mapping ) {
+		return nullptr;
+	}
+
+	// The view keeps the mapping alive after its handle is closed
+	const void *view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	size = static_cast<size_t>( fileSize.QuadPart );
+	return static_cast<const unsigned char *>( view );
+#else
+	const int fileDescriptor = open( path.c_str(), O_RDONLY );
+	if( fileDescriptor < 0 ) {
+		return nullptr;
+	}
+
+	struct stat status;
+	void *view = MAP_FAILED;
+	if( ( fstat( fileDescriptor, &status ) == 0 ) && ( status.st_size > 0 ) ) {
+		view = mmap( nullptr, static_cast<size_t>( status.st_size ), PROT_READ, MAP_PRIVATE, fileDescriptor, 0 );
+	}
+	close( fileDescriptor );
+
+	if( view == MAP_FAILED ) {
+		return nullptr;
+	}
+	size = static_cast<size_t>( status.st_size );
+	return static_cast<const unsigned char *>( view );
+#endif
+}
+
+void unmapFile( const unsigned char *view, size_t size )
+{
+#ifdef _WIN32
+	UnmapViewOfFile( view );
+#else
+	munmap( const_cast<unsigned char *>( view ), size );
+#endif
+}
+
+} // anonymous namespace
+
+std::vector<std::string> FontPack::loadFont( const void *data, size_t size, const std::string &name )
+{
+	const unsigned char *bytes = static_cast<const unsigned char *>( data );
+	return loadFont( std::vector<unsigned char>( bytes, bytes + size ), name );
+}
+
+std::vector<std::string> FontPack::loadFont( std::vector<unsigned char> &&data, const std::string &name )
+{
+	TraceScope trace( "fontPack.loadFont" );
+	if( data.empty() ) {
+		CI_LOG_E( "No font data for \"" << name << "\"" );
+		return {};
+	}
+
+	Registry &registry = getRegistry();
+	std::vector<std::string> families;
+	{
+		std::lock_guard<std::mutex> lock( registry.mutex );
+		std::unique_ptr<std::vector<unsigned char>> buffer( new std::vector<unsigned char>( std::move( data ) ) );
+		families = registerFaces( registry, buffer->data(), buffer->size(), name );
+		if( families.empty() ) {
+			return families;
+		}
+		registry.buffers.push_back( std::move( buffer ) );
+	}
+
+	// Font maps cache what they matched, they only see the new faces once they're told the fonts changed
+	FontFallback::clear();
+	return families;
+}
+
+std::vector<std::string> FontPack::loadMapped( const ci::fs::path &path, const std::vector<FontPackEntry> &entries )
+{
+	TraceScope trace( "fontPack.loadMapped" );
+	size_t size = 0;
+	const unsigned char *view = mapFile( path, size );
+	if( ! view ) {
+		CI_LOG_E( "Could not map font pack \"" << path << "\"" );
+		return {};
+	}
+
+	Registry &registry = getRegistry();
+	std::vector<std::string> families;
+	{
+		std::lock_guard<std::mutex> lock( registry.mutex );
+		if( entries.empty() ) {
+			families = registerFaces( registry, view, size, path.string() );
+		}
+
+		for( const FontPackEntry &entry : entries ) {
+			if( ( entry.offset >= size ) || ( entry.size == 0 ) || ( entry.size > size - entry.offset ) ) {
+				CI_LOG_E( "Font \"" << entry.name << "\" is outside of \"" << path << "\"" );
+				continue;
+			}
+			const std::vector<std::string> entryFamilies = registerFaces( registry, view + entry.offset, static_cast<size_t>( entry.size ), entry.name.empty() ? path.string() : entry.name );
+			families.insert( families.end(), entryFamilies.begin(), entryFamilies.end() );
+		}
+
+		if( families.empty() ) {
+			unmapFile( view, size );
+			return families;
+		}
+		registry.mappedBytes += size;
+	}
+
+	FontFallback::clear();
+	return families;
+}
+
+size_t FontPack::getFaceCount()
+{
+	Registry &registry = getRegistry();
+	std::lock_guard<std::mutex> lock( registry.mutex );
+	return registry.faces.size();
+}
+
+size_t FontPack::getMappedBytes()
+{
+	Registry &registry = getRegistry();
+	std::lock_guard<std::mutex> lock( registry.mutex );
+	return registry.mappedBytes;
+}
@@ -0,0 +1,46 @@
+// CinderPangoFontPack.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPangoTypes.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+// A font file stored inside a larger file, e.g. an uncompressed entry of an asset pack
+struct FontPackEntry {
+	uint64_t offset;
+	uint64_t size;
+	std::string name; // listed as the face's file by fontconfig, e.g. "fonts/NotoSans-Regular.ttf"
+};
+
+// Registers fonts straight from memory, without extracting anything to disk. Every face in the data (TrueType and
+// OpenType collections hold several) is opened with FreeType and added to fontconfig's application fonts, so font maps
+// see it like a font loaded from a file with CinderPangoCore::loadFont. That includes shared font maps and the fallback
+// cache, which are invalidated the same way (see FontFallback). Uses the FREETYPE renderer's font stack, so the fonts
+// aren't visible to the native renderer. Fonts and the memory behind them stay registered for the life of the process.
+// Like loadFont, register fonts before other threads render. fontconfig's font sets can't change while background work
+// matches fonts (FontWarmUp::warmUpAsync, CinderPangoCore::measureBatch, PagedExport), loading waits for it to finish.
+//
+// Each call returns the family of every face it registered, empty on failure.
+class FontPack {
+  public:
+	// Copies the data once, for fonts that were decompressed into a temporary buffer
+	static std::vector<std::string> loadFont( const void *data, size_t size, const std::string &name = "memory" );
+	// Takes the buffer over without copying
+	static std::vector<std::string> loadFont( std::vector<unsigned char> &&data, const std::string &name = "memory" );
+
+	// Maps the file read only and registers the fonts at the given ranges. Pages are only read as FreeType touches
+	// them, so a large pack costs little more than the fonts actually used. Without entries the whole file is one font.
+	static std::vector<std::string> loadMapped( const ci::fs::path &path, const std::vector<FontPackEntry> &entries = {} );
+
+	static size_t getFaceCount();	 // registered through FontPack so far
+	static size_t getMappedBytes(); // address space held by mapped packs
+};
+
+}} // namespace kp::pango
@@ -0,0 +1,378 @@
+// CinderPangoFontWatcher.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoFontWatcher.h"
+#include "CinderPangoFallback.h"
+#include "CinderPangoFreeType.h"
+#include "CinderPangoInternal.h"
+#include "CinderPangoMetrics.h"
+#include "CinderPangoTrace.h"
+
+#include <fontconfig/fontconfig.h>
+#include <fontconfig/fcfreetype.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined( __linux__ )
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace kp::pango;
+
+struct FontWatcher::WatchedFile {
+	int64_t modified = 0;
+	int64_t size = 0;
+	std::unique_ptr<std::vector<unsigned char>> data;
+	std::vector<FT_Face> faces;
+	std::vector<std::string> families;
+};
+
+namespace {
+
+// A replaced or removed file's data, unregistered at changeSerial
+struct RetiredData {
+	std::unique_ptr<std::vector<unsigned char>> data;
+	uint64_t changeSerial;
+};
+
+// What replaced or removed files' faces point into. Never destroyed, like FontPack's registry.
+struct Retired {
+	std::mutex mutex;
+	std::vector<RetiredData> buffers;
+	std::vector<std::unique_ptr<std::vector<unsigned char>>> keptBuffers; // of watchers that are gone, still registered
+	// Never freed. Cairo knows faces by address and keeps unused fonts around for a while, a new face allocated at the
+	// same address could pick up glyphs cached for the old one.
+	std::vector<FT_Face> faces;
+};
+
+Retired& getRetired()
+{
+	static Retired *retired = new Retired();
+	return *retired;
+}
+
+// Called with the faces unregistered, before FontFallback::invalidate() tells the font maps
+void retire( std::unique_ptr<std::vector<unsigned char>> data, const std::vector<FT_Face> &faces )
+{
+	Retired &retired = getRetired();
+	std::lock_guard<std::mutex> lock( retired.mutex );
+	if( data ) {
+		Metrics::increment( Counter::FONT_BYTES_RETIRED, static_cast<int64_t>( data->size() ) );
+		retired.buffers.push_back( { std::move( data ), FontFallback::getChangeSerial() } );
+	}
+	retired.faces.insert( retired.faces.end(), faces.begin(), faces.end() );
+}
+
+// The data no font map can reach anymore: every one of them has dropped its cached fonts since the faces were
+// unregistered, and fonts still held by layouts belong to instances that lay out again before drawing
+void freeRetired()
+{
+	Retired &retired = getRetired();
+	std::lock_guard<std::mutex> lock( retired.mutex );
+	if( retired.buffers.empty() ) {
+		return;
+	}
+
+	const uint64_t oldestFontMapCache = detail::getOldestFontMapCache();
+	for( auto buffer = retired.buffers.begin(); buffer != retired.buffers.end(); ) {
+		if( buffer->changeSerial < oldestFontMapCache ) {
+			Metrics::decrement( Counter::FONT_BYTES_RETIRED, static_cast<int64_t>( buffer->data->size() ) );
+			buffer = retired.buffers.erase( buffer );
+		} else {
+			++buffer;
+		}
+	}
+}
+
+// Without the filesystem library, which throws when a file goes away between listing and reading it
+bool getFileStatus( const ci::fs::path &path, int64_t &modified, int64_t &size )
+{
+#ifdef _WIN32
+	struct _stat64 status;
+	if( ( _wstat64( path.wstring().c_str(), &status ) != 0 ) || ! ( status.st_mode & _S_IFREG ) ) {
+		return false;
+	}
+	modified = static_cast<int64_t>( status.st_mtime );
+#else
+	struct stat status;
+	if( ( stat( path.c_str(), &status ) != 0 ) || ! S_ISREG( status.st_mode ) ) {
+		return false;
+	}
+#if defined( __linux__ )
+	modified = static_cast<int64_t>( status.st_mtim.tv_sec ) * 1000000000 + status.st_mtim.tv_nsec;
+#else
+	modified = static_cast<int64_t>( status.st_mtime );
+#endif
+#endif
+	size = static_cast<int64_t>( status.st_size );
+	return true;
+}
+
+bool isFontFile( const ci::fs::path &path )
+{
+	std::string extension = path.extension().string();
+	std::transform( extension.begin(), extension.end(), extension.begin(), []( unsigned char c ) { return static_cast<char>( std::tolower( c ) ); } );
+	return ( extension == ".ttf" ) || ( extension == ".otf" ) || ( extension == ".ttc" ) || ( extension == ".otc" ) || ( extension == ".woff" );
+}
+
+} // anonymous namespace
+
+FontWatcherRef FontWatcher::create( const ci::fs::path &directory, double pollInterval )
+{
+	return FontWatcherRef( new FontWatcher( directory, pollInterval ) );
+}
+
+FontWatcher::FontWatcher( const ci::fs::path &directory, double pollInterval ) :
+	mDirectory( directory ),
+	mPollInterval( std::max( pollInterval, 0.0 ) ),
+	mScanned( false ),
+	mNotifyDescriptor( -1 )
+{
+#if defined( __linux__ )
+	mNotifyDescriptor = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( ( mNotifyDescriptor >= 0 ) && ( inotify_add_watch( mNotifyDescriptor, mDirectory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE ) < 0 ) ) {
+		// Most likely the directory doesn't exist yet, polling picks it up once it does
+		close( mNotifyDescriptor );
+		mNotifyDescriptor = -1;
+	}
+#endif
+	if( mNotifyDescriptor < 0 ) {
+		CI_LOG_V( "Polling font directory " << mDirectory << " every " << mPollInterval.count() << " seconds" );
+	}
+}
+
+FontWatcher::~FontWatcher()
+{
+#if defined( __linux__ )
+	if( mNotifyDescriptor >= 0 ) {
+		close( mNotifyDescriptor );
+	}
+#endif
+	// The faces stay registered
+	Retired &retired = getRetired();
+	std::lock_guard<std::mutex> lock( retired.mutex );
+	for( auto &file : mFiles ) {
+		if( file.second->data ) {
+			retired.keptBuffers.push_back( std::move( file.second->data ) );
+		}
+		retired.faces.insert( retired.faces.end(), file.second->faces.begin(), file.second->faces.end() );
+	}
+}
+
+std::vector<std::string> FontWatcher::update()
+{
+	freeRetired();
+
+	// Changes deferred by an earlier call come first, found again by a scan they aren't added twice
+	std::vector<ci::fs::path> changedPaths;
+	changedPaths.swap( mPendingPaths );
+	const auto now = std::chrono::steady_clock::now();
+
+	if( ! mScanned || ( ( mNotifyDescriptor >= 0 ) && ! readNotifications( changedPaths ) ) ) {
+		scan( changedPaths );
+	} else if( ( mNotifyDescriptor < 0 ) && ( now - mLastPoll >= mPollInterval ) ) {
+		scan( changedPaths );
+	}
+	if( changedPaths.empty() ) {
+		return {};
+	}
+
+	// Background workers are matching against the font sets, changing them now would pull the arrays out from under them
+	detail::FontSetWriteLock fontSetLock( false );
+	if( ! fontSetLock.isLocked() ) {
+		mPendingPaths.swap( changedPaths );
+		return {};
+	}
+
+	TraceScope trace( "fontWatcher.update" );
+	std::vector<std::string> families;
+	FcCharSet *coverage = FcCharSetCreate();
+	for( const ci::fs::path &path : changedPaths ) {
+		applyChange( path, families, coverage );
+	}
+
+	std::sort( families.begin(), families.end() );
+	families.erase( std::unique( families.begin(), families.end() ), families.end() );
+	if( ! families.empty() ) {
+		// Instances of variable fonts made from the old faces would keep drawing them
+		detail::dropVariationInstances( families );
+		FontFallback::invalidate( families, coverage );
+	}
+	FcCharSetDestroy( coverage );
+	return families;
+}
+
+size_t FontWatcher::getFaceCount() const
+{
+	size_t count = 0;
+	for( const auto &file : mFiles ) {
+		count += file.second->faces.size();
+	}
+	return count;
+}
+
+void FontWatcher::scan( std::vector<ci::fs::path> &changedPaths )
+{
+	TraceScope trace( "fontWatcher.scan" );
+	mScanned = true;
+	mLastPoll = std::chrono::steady_clock::now();
+
+	std::vector<std::string> present;
+	if( ci::fs::is_directory( mDirectory ) ) {
+		for( ci::fs::directory_iterator entry( mDirectory ), end; entry != end; ++entry ) {
+			const ci::fs::path &path = entry->path();
+			int64_t modified;
+			int64_t size;
+			if( ! isFontFile( path ) || ! getFileStatus( path, modified, size ) ) {
+				continue;
+			}
+			present.push_back( path.string() );
+
+			auto known = mFiles.find( path.string() );
+			if( ( ( known == mFiles.end() ) || ( known->second->modified != modified ) || ( known->second->size != size ) ) &&
+				( std::find( changedPaths.begin(), changedPaths.end(), path ) == changedPaths.end() ) ) {
+				changedPaths.push_back( path );
+			}
+		}
+	}
+
+	for( const auto &file : mFiles ) {
+		const ci::fs::path path = file.first;
+		if( ( std::find( present.begin(), present.end(), file.first ) == present.end() ) &&
+			( std::find( changedPaths.begin(), changedPaths.end(), path ) == changedPaths.end() ) ) {
+			changedPaths.push_back( path );
+		}
+	}
+}
+
+bool FontWatcher::readNotifications( std::vector<ci::fs::path> &changedPaths )
+{
+#if defined( __linux__ )
+	alignas( inotify_event ) char buffer[ 4096 ];
+	bool complete = true;
+	for( ;; ) {
+		const ssize_t length = read( mNotifyDescriptor, buffer, sizeof( buffer ) );
+		if( length <= 0 ) {
+			if( ( length < 0 ) && ( errno != EAGAIN ) && ( errno != EINTR ) ) {
+				CI_LOG_E( "Could not read font directory notifications for " << mDirectory );
+				complete = false;
+			}
+			break;
+		}
+
+		for( const char *position = buffer; position < buffer + length; ) {
+			const inotify_event *event = reinterpret_cast<const inotify_event *>( position );
+			position += sizeof( inotify_event ) + event->len;
+
+			if( event->mask & IN_Q_OVERFLOW ) {
+				complete = false;
+			} else if( event->mask & IN_IGNORED ) {
+				// The directory itself was removed or moved, from now on polling notices when it's back
+				close( mNotifyDescriptor );
+				mNotifyDescriptor = -1;
+				return false;
+			} else if( event->len > 0 ) {
+				const ci::fs::path path = mDirectory / event->name;
+				if( isFontFile( path ) && ( std::find( changedPaths.begin(), changedPaths.end(), path ) == changedPaths.end() ) ) {
+					changedPaths.push_back( path );
+				}
+			}
+		}
+	}
+	return complete;
+#else
+	return false;
+#endif
+}
+
+void FontWatcher::applyChange( const ci::fs::path &path, std::vector<std::string> &families, FcCharSet *coverage )
+{
+	auto known = mFiles.find( path.string() );
+	std::unique_ptr<WatchedFile> file( new WatchedFile() );
+
+	if( ! getFileStatus( path, file->modified, file->size ) ) {
+		if( known != mFiles.end() ) {
+			CI_LOG_V( "Font file removed: " << path );
+			for( FT_Face face : known->second->faces ) {
+				detail::unregisterFace( face );
+			}
+			families.insert( families.end(), known->second->families.begin(), known->second->families.end() );
+			retire( std::move( known->second->data ), known->second->faces );
+			mFiles.erase( known );
+		}
+		return;
+	}
+
+	if( ( known != mFiles.end() ) && ( known->second->modified == file->modified ) && ( known->second->size == file->size ) ) {
+		return;
+	}
+
+	std::ifstream input( path.string(), std::ios::binary );
+	file->data.reset( new std::vector<unsigned char>( ( std::istreambuf_iterator<char>( input ) ), std::istreambuf_iterator<char>() ) );
+	if( ! input.good() && ! input.eof() ) {
+		CI_LOG_E( "Could not read font file " << path );
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( detail::getFreeTypeMutex() );
+		FT_Long numFaces = 1;
+		for( FT_Long index = 0; ! file->data->empty() && ( index < numFaces ); index++ ) {
+			FT_Face face = nullptr;
+			if( detail::newMemoryFace( file->data->data(), static_cast<FT_Long>( file->data->size() ), index, &face ) != 0 ) {
+				break;
+			}
+			numFaces = face->num_faces;
+
+			const std::string family = detail::registerFace( face, path.string(), static_cast<int>( index ) );
+			if( family.empty() ) {
+				detail::doneFace( face );
+				continue;
+			}
+			file->faces.push_back( face );
+			file->families.push_back( family );
+
+			FcCharSet *charset = FcFreeTypeCharSet( face, nullptr );
+			if( charset ) {
+				FcCharSetMerge( coverage, charset, nullptr );
+				FcCharSetDestroy( charset );
+			}
+		}
+	}
+
+	if( file->faces.empty() ) {
+		// Possibly still being copied when polling found it. The file's previous faces, if any, stay registered until
+		// it changes again.
+		CI_LOG_E( "No usable font faces in " << path );
+		if( known != mFiles.end() ) {
+			known->second->modified = file->modified;
+			known->second->size = file->size;
+		} else {
+			file->data.reset();
+			mFiles[ path.string() ] = std::move( file );
+		}
+		return;
+	}
+
+	CI_LOG_V( "Font file " << ( ( known != mFiles.end() ) ? "changed: " : "added: " ) << path );
+	Metrics::increment( Counter::FONT_FILES_LOADED );
+	families.insert( families.end(), file->families.begin(), file->families.end() );
+	if( known != mFiles.end() ) {
+		for( FT_Face face : known->second->faces ) {
+			detail::unregisterFace( face );
+		}
+		families.insert( families.end(), known->second->families.begin(), known->second->families.end() );
+		retire( std::move( known->second->data ), known->second->faces );
+	}
+	mFiles[ path.string() ] = std::move( file );
+}
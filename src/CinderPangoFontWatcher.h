@@ -0,0 +1,76 @@
+// CinderPangoFontWatcher.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPangoTypes.h"
+
+#include <fontconfig/fontconfig.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+using FontWatcherRef = std::shared_ptr<class FontWatcher>;
+
+// Keeps the fonts in a directory registered while the application runs, for fonts dropped in or replaced at runtime.
+// Files are read into memory and registered like FontPack fonts, so a file overwritten in place can't change under
+// FreeType. A new or changed file registers its faces in place of the ones from its previous contents, a removed file
+// unregisters them. Each update passes the families involved to FontFallback::invalidate(), which forgets only the
+// fallback entries they affect, and instances only lay out again (on their next render) if their text uses them.
+//
+// Changes are noticed with inotify on Linux, and by listing the directory every pollInterval seconds elsewhere or when
+// inotify isn't available. Nothing happens in the background, call update() from the thread that renders, e.g. in the
+// app's update(). Subdirectories aren't watched. Fonts stay registered after the watcher is gone.
+//
+// A replaced or removed file's data, as large as the file, stays in memory while fonts created from it may still be in
+// use, i.e. until every font map the library created has dropped its cached fonts since. Instances drop theirs when they
+// lay out again because of the change, shared font maps after FontFallback::clear(), measureBatch() layouts on their next
+// job. An idle instance with a font map of its own holds the data until it's destroyed, so files replaced over and over
+// add up: Counter::FONT_BYTES_RETIRED tracks what's held. update() frees what has become unreachable. The FreeType face
+// records themselves, a few kilobytes each, are never freed. FontVariations instances of the families are dropped and
+// their families are invalidated too.
+//
+// fontconfig's font sets can't change while other threads match against them. While FontWarmUp::warmUpAsync(),
+// CinderPangoCore::measureBatch() or PagedExport workers are running, update() leaves the font sets alone, returns
+// nothing and applies the changes it found on a later call once they're done.
+class FontWatcher {
+  public:
+	static FontWatcherRef create( const ci::fs::path &directory, double pollInterval = 1.0 );
+	~FontWatcher();
+
+	// Registers the fonts added or changed since the last call and unregisters removed ones. The first call registers
+	// every font already in the directory. Returns the families of the faces involved and of the variable font instances
+	// dropped with them, empty if nothing changed or the changes were deferred, see above.
+	std::vector<std::string> update();
+
+	const ci::fs::path& getDirectory() const { return mDirectory; }
+	bool isUsingNotifications() const { return mNotifyDescriptor >= 0; } // otherwise polling
+	bool hasPendingChanges() const { return ! mPendingPaths.empty(); } // deferred while workers were matching fonts
+	size_t getFaceCount() const; // registered from the directory's current files
+
+  protected:
+	FontWatcher( const ci::fs::path &directory, double pollInterval );
+
+  private:
+	struct WatchedFile;
+
+	void scan( std::vector<ci::fs::path> &changedPaths );
+	bool readNotifications( std::vector<ci::fs::path> &changedPaths ); // false if events were lost
+	void applyChange( const ci::fs::path &path, std::vector<std::string> &families, FcCharSet *coverage );
+
+	ci::fs::path mDirectory;
+	std::chrono::duration<double> mPollInterval;
+	std::chrono::steady_clock::time_point mLastPoll;
+	bool mScanned;
+	int mNotifyDescriptor;
+	std::map<std::string, std::unique_ptr<WatchedFile>> mFiles;
+	std::vector<ci::fs::path> mPendingPaths;
+};
+
+}} // namespace kp::pango
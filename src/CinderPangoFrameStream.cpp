@@ -0,0 +1,190 @@
+// CinderPangoFrameStream.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoFrameStream.h"
+#include "CinderPangoCore.h"
+#include "CinderPangoTrace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace kp::pango;
+
+FrameStreamRef FrameStream::create( int fileDescriptor, int width, int height, FrameFormat format )
+{
+	return FrameStreamRef( new FrameStream( fileDescriptor, width, height, format ) );
+}
+
+FrameStream::FrameStream( int fileDescriptor, int width, int height, FrameFormat format ) :
+	mFileDescriptor( fileDescriptor ),
+	mWidth( std::max( width, 1 ) ),
+	mHeight( std::max( height, 1 ) ),
+	mFormat( format ),
+	mFrameBytes( static_cast<size_t>( mWidth ) * mHeight * ( ( format == FrameFormat::BGRA ) ? 4 : 1 ) ),
+	mFillIndex( 0 ),
+	mFramePending( false ),
+	mPendingIndex( 0 ),
+	mStopRequested( false ),
+	mFailed( false ),
+	mFramesWritten( 0 ),
+	mStallSeconds( 0.0 )
+{
+	mBuffers[ 0 ].resize( mFrameBytes );
+	mBuffers[ 1 ].resize( mFrameBytes );
+	mWriterThread = std::thread( &FrameStream::runWriter, this );
+}
+
+FrameStream::~FrameStream()
+{
+	finish();
+}
+
+bool FrameStream::writeFrame( const CinderPangoCore &pango )
+{
+	const ci::ivec2 size = pango.getPixelSize();
+	return writeFrame( pango.getPixels(), size.x, size.y, pango.getPixelStride(), pango.isSurfaceFlipped() );
+}
+
+bool FrameStream::writeFrame( const unsigned char *pixels, int width, int height, int stride, bool bottomUp )
+{
+	unsigned char *frame = mBuffers[ mFillIndex ].data();
+	std::memset( frame, 0, mFrameBytes );
+
+	const int copyWidth = pixels ? std::min( width, mWidth ) : 0;
+	const int copyHeight = pixels ? std::min( height, mHeight ) : 0;
+
+	for( int y = 0; y < copyHeight; y++ ) {
+		const unsigned char *source = pixels + static_cast<size_t>( bottomUp ? ( height - 1 - y ) : y ) * stride;
+		if( mFormat == FrameFormat::BGRA ) {
+			std::memcpy( frame + static_cast<size_t>( y ) * mWidth * 4, source, static_cast<size_t>( copyWidth ) * 4 );
+		} else {
+			// Alpha is the high byte of each native endian ARGB32 pixel
+			const uint32_t *sourcePixels = reinterpret_cast<const uint32_t *>( source );
+			unsigned char *destination = frame + static_cast<size_t>( y ) * mWidth;
+			for( int x = 0; x < copyWidth; x++ ) {
+				destination[ x ] = static_cast<unsigned char>( sourcePixels[ x ] >> 24 );
+			}
+		}
+	}
+
+	return queueFrame();
+}
+
+bool FrameStream::queueFrame()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+
+	// The writer may still be busy with the frame before, that's the only time the caller waits
+	if( mFramePending ) {
+		const auto start = std::chrono::steady_clock::now();
+		mCondition.wait( lock, [this] { return ! mFramePending; } );
+		mStallSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	}
+
+	if( mFailed || mStopRequested ) {
+		return false;
+	}
+
+	mPendingIndex = mFillIndex;
+	mFramePending = true;
+	mFillIndex = 1 - mFillIndex;
+	mCondition.notify_all();
+	return true;
+}
+
+void FrameStream::finish()
+{
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		mCondition.wait( lock, [this] { return ! mFramePending; } );
+		mStopRequested = true;
+		mCondition.notify_all();
+	}
+
+	if( mWriterThread.joinable() ) {
+		mWriterThread.join();
+	}
+}
+
+uint64_t FrameStream::getFramesWritten() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mFramesWritten;
+}
+
+bool FrameStream::hasFailed() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mFailed;
+}
+
+double FrameStream::getStallSeconds() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mStallSeconds;
+}
+
+void FrameStream::runWriter()
+{
+	Trace::setThreadName( "FrameStream" );
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	while( true ) {
+		mCondition.wait( lock, [this] { return mFramePending || mStopRequested; } );
+		if( ! mFramePending ) {
+			return;
+		}
+
+		// The caller only touches the other buffer until this one is released
+		const unsigned char *frame = mBuffers[ mPendingIndex ].data();
+		lock.unlock();
+		bool written;
+		{
+			TraceScope trace( "frameStream.write", this );
+			written = writeAll( frame, mFrameBytes );
+		}
+		lock.lock();
+
+		if( written ) {
+			mFramesWritten++;
+		} else {
+			mFailed = true;
+		}
+		mFramePending = false;
+		mCondition.notify_all();
+
+		if( mFailed ) {
+			return;
+		}
+	}
+}
+
+bool FrameStream::writeAll( const unsigned char *data, size_t size )
+{
+	// Pipes take partial writes
+	while( size > 0 ) {
+#ifdef _WIN32
+		const int written = _write( mFileDescriptor, data, static_cast<unsigned int>( std::min<size_t>( size, 1 << 30 ) ) );
+#else
+		const ssize_t written = ::write( mFileDescriptor, data, size );
+#endif
+		if( written < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			return false;
+		}
+		data += written;
+		size -= static_cast<size_t>( written );
+	}
+	return true;
+}
@@ -0,0 +1,83 @@
+// CinderPangoFrameStream.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kp { namespace pango {
+
+class CinderPangoCore;
+
+enum class FrameFormat {
+	BGRA, // 4 bytes per pixel, premultiplied, what ffmpeg calls bgra
+	A8,	  // alpha only, 1 byte per pixel (gray), e.g. for a subtitle matte
+};
+
+using FrameStreamRef = std::shared_ptr<class FrameStream>;
+
+// Writes fixed size raw frames, top row first, to a file descriptor (a pipe into an encoder, a FIFO, a file) from a
+// background thread. Frames are double buffered: while the writer thread drains one buffer the caller renders and
+// copies the next frame into the other, and writeFrame() only blocks when the reader falls a whole frame behind.
+// Both buffers are allocated once up front. Doesn't close the file descriptor.
+class FrameStream {
+  public:
+	static FrameStreamRef create( int fileDescriptor, int width, int height, FrameFormat format = FrameFormat::BGRA );
+	~FrameStream(); // finishes first
+
+	// Copies pango's current pixels into the next frame and queues it. Text smaller than the frame is placed at the
+	// top left on a transparent background, larger text is cropped; set the min and max size to the frame size to
+	// fill it exactly. Flipped surfaces are written top down as well. Returns false once a write has failed.
+	bool writeFrame( const CinderPangoCore &pango );
+
+	// Same for premultiplied ARGB32 pixels from anywhere else
+	bool writeFrame( const unsigned char *pixels, int width, int height, int stride, bool bottomUp = false );
+
+	// Waits for the queued frame to be written and stops the writer thread. Later frames are dropped.
+	void finish();
+
+	int getWidth() const { return mWidth; }
+	int getHeight() const { return mHeight; }
+	FrameFormat getFormat() const { return mFormat; }
+	size_t getFrameBytes() const { return mFrameBytes; }
+	uint64_t getFramesWritten() const;
+	bool hasFailed() const;
+
+	// Total time writeFrame() spent waiting on the writer, i.e. how far the consumer is from keeping up
+	double getStallSeconds() const;
+
+  protected:
+	FrameStream( int fileDescriptor, int width, int height, FrameFormat format );
+
+  private:
+	void runWriter();
+	bool writeAll( const unsigned char *data, size_t size );
+	bool queueFrame();
+
+	int mFileDescriptor;
+	int mWidth;
+	int mHeight;
+	FrameFormat mFormat;
+	size_t mFrameBytes;
+
+	std::vector<unsigned char> mBuffers[ 2 ];
+	int mFillIndex; // owned by the caller's thread
+
+	mutable std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mFramePending; // mBuffers[ mPendingIndex ] is queued or being written
+	int mPendingIndex;
+	bool mStopRequested;
+	bool mFailed;
+	uint64_t mFramesWritten;
+	double mStallSeconds;
+	std::thread mWriterThread;
+};
+
+}} // namespace kp::pango
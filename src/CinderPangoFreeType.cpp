@@ -0,0 +1,216 @@
+// CinderPangoFreeType.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoFreeType.h"
+#include "CinderPangoTypes.h"
+
+#include <fontconfig/fontconfig.h>
+#include <fontconfig/fcfreetype.h>
+
+#include <cstdlib>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+using namespace kp::pango;
+
+namespace {
+
+#ifdef _WIN32
+template <typename Function>
+Function lookUp( const char *name )
+{
+	static HMODULE module = LoadLibraryA( "libfreetype-6.dll" );
+	return module ? reinterpret_cast<Function>( GetProcAddress( module, name ) ) : nullptr;
+}
+
+#define FREETYPE_FUNCTION( name ) static const auto name##Function = lookUp<decltype( &name )>( #name )
+#define FREETYPE_CALL( name, fallback, ... ) ( name##Function ? name##Function( __VA_ARGS__ ) : fallback )
+#else
+#define FREETYPE_FUNCTION( name )
+#define FREETYPE_CALL( name, fallback, ... ) name( __VA_ARGS__ )
+#endif
+
+FcFontSet* getApplicationFonts()
+{
+	// fontconfig only creates the application set when a file or directory is added, and has no public call to create
+	// it otherwise. Before that the system set takes the fonts, it's matched the same way.
+	FcConfig *config = FcConfigGetCurrent();
+	FcFontSet *fonts = FcConfigGetFonts( config, FcSetApplication );
+	return fonts ? fonts : FcConfigGetFonts( config, FcSetSystem );
+}
+
+struct FontSetLock {
+	std::mutex mutex;
+	std::condition_variable released;
+	int numReaders = 0;
+};
+
+FontSetLock& getFontSetLock()
+{
+	static FontSetLock *lock = new FontSetLock();
+	return *lock;
+}
+
+} // anonymous namespace
+
+std::mutex& detail::getFreeTypeMutex()
+{
+	static std::mutex *mutex = new std::mutex();
+	return *mutex;
+}
+
+detail::FontSetReadScope::FontSetReadScope()
+{
+	FontSetLock &lock = getFontSetLock();
+	std::lock_guard<std::mutex> guard( lock.mutex );
+	lock.numReaders++;
+}
+
+detail::FontSetReadScope::~FontSetReadScope()
+{
+	FontSetLock &lock = getFontSetLock();
+	std::lock_guard<std::mutex> guard( lock.mutex );
+	if( --lock.numReaders == 0 ) {
+		lock.released.notify_all();
+	}
+}
+
+detail::FontSetWriteLock::FontSetWriteLock( bool wait ) :
+	mLock( getFontSetLock().mutex )
+{
+	// Holding the mutex keeps new readers out until the change is done
+	FontSetLock &lock = getFontSetLock();
+	if( wait ) {
+		lock.released.wait( mLock, [&lock] { return lock.numReaders == 0; } );
+	} else if( lock.numReaders > 0 ) {
+		mLock.unlock();
+	}
+}
+
+FT_Library detail::getFreeTypeLibrary()
+{
+	// Never destroyed, fontconfig's patterns keep pointing at faces from it until the process exits
+	static FT_Library library = [] {
+		FREETYPE_FUNCTION( FT_Init_FreeType );
+		FT_Library newLibrary = nullptr;
+		if( FREETYPE_CALL( FT_Init_FreeType, FT_Err_Cannot_Open_Resource, &newLibrary ) != 0 ) {
+			CI_LOG_E( "Could not initialize FreeType." );
+			return static_cast<FT_Library>( nullptr );
+		}
+		return newLibrary;
+	}();
+	return library;
+}
+
+FT_Error detail::newMemoryFace( const FT_Byte *data, FT_Long size, FT_Long index, FT_Face *face )
+{
+	FREETYPE_FUNCTION( FT_New_Memory_Face );
+	FT_Library library = getFreeTypeLibrary();
+	return library ? FREETYPE_CALL( FT_New_Memory_Face, FT_Err_Cannot_Open_Resource, library, data, size, index, face ) : FT_Err_Cannot_Open_Resource;
+}
+
+FT_Error detail::newFace( const char *path, FT_Long index, FT_Face *face )
+{
+	FREETYPE_FUNCTION( FT_New_Face );
+	FT_Library library = getFreeTypeLibrary();
+	return library ? FREETYPE_CALL( FT_New_Face, FT_Err_Cannot_Open_Resource, library, path, index, face ) : FT_Err_Cannot_Open_Resource;
+}
+
+void detail::doneFace( FT_Face face )
+{
+	FREETYPE_FUNCTION( FT_Done_Face );
+	FREETYPE_CALL( FT_Done_Face, 0, face );
+}
+
+FT_Error detail::getMMVar( FT_Face face, FT_MM_Var **variations )
+{
+	FREETYPE_FUNCTION( FT_Get_MM_Var );
+	return FREETYPE_CALL( FT_Get_MM_Var, FT_Err_Unimplemented_Feature, face, variations );
+}
+
+void detail::doneMMVar( FT_MM_Var *variations )
+{
+#if defined( _WIN32 )
+	// Only FreeType 2.9 and later have FT_Done_MM_Var. Freeing with this CRT could mismatch the DLL's, so older
+	// DLLs keep the (small, once per font) description.
+	using DoneMMVar = FT_Error ( * )( FT_Library, FT_MM_Var * );
+	static const auto doneMMVarFunction = lookUp<DoneMMVar>( "FT_Done_MM_Var" );
+	if( doneMMVarFunction ) {
+		doneMMVarFunction( getFreeTypeLibrary(), variations );
+	}
+#elif ( FREETYPE_MAJOR > 2 ) || ( ( FREETYPE_MAJOR == 2 ) && ( FREETYPE_MINOR >= 9 ) )
+	FT_Done_MM_Var( getFreeTypeLibrary(), variations );
+#else
+	// Allocated with the default memory functions, i.e. malloc
+	std::free( variations );
+#endif
+}
+
+FT_Error detail::setVarDesignCoordinates( FT_Face face, FT_UInt count, FT_Fixed *coordinates )
+{
+	FREETYPE_FUNCTION( FT_Set_Var_Design_Coordinates );
+	return FREETYPE_CALL( FT_Set_Var_Design_Coordinates, FT_Err_Unimplemented_Feature, face, count, coordinates );
+}
+
+std::string detail::registerFace( FT_Face face, const std::string &name, int index, const std::string &family )
+{
+	FcFontSet *fonts = getApplicationFonts();
+	if( ! fonts ) {
+		CI_LOG_E( "Fontconfig has no font set to add \"" << name << "\" to." );
+		return "";
+	}
+
+	// The face goes into the pattern, so Cairo renders from it instead of trying to open the file name
+	FcPattern *pattern = FcFreeTypeQueryFace( face, reinterpret_cast<const FcChar8 *>( name.c_str() ), index, nullptr );
+	if( ! pattern ) {
+		CI_LOG_E( "Fontconfig could not describe face " << index << " of \"" << name << "\"" );
+		return "";
+	}
+
+	if( ! family.empty() ) {
+		FcPatternDel( pattern, FC_FAMILY );
+		FcPatternDel( pattern, FC_FAMILYLANG );
+		FcPatternAddString( pattern, FC_FAMILY, reinterpret_cast<const FcChar8 *>( family.c_str() ) );
+	}
+
+	if( ! FcPatternAddFTFace( pattern, FC_FT_FACE, face ) || ! FcFontSetAdd( fonts, pattern ) ) {
+		CI_LOG_E( "Fontconfig could not register face " << index << " of \"" << name << "\"" );
+		FcPatternDestroy( pattern );
+		return "";
+	}
+
+	FcChar8 *registeredFamily = nullptr;
+	return ( FcPatternGetString( pattern, FC_FAMILY, 0, &registeredFamily ) == FcResultMatch ) ? reinterpret_cast<const char *>( registeredFamily ) : name;
+}
+
+bool detail::unregisterFace( FT_Face face )
+{
+	bool removed = false;
+	FcConfig *config = FcConfigGetCurrent();
+	for( FcSetName setName : { FcSetApplication, FcSetSystem } ) {
+		// fontconfig has no call to remove a font, but the set's layout is public
+		FcFontSet *fonts = FcConfigGetFonts( config, setName );
+		if( ! fonts ) {
+			continue;
+		}
+
+		int kept = 0;
+		for( int i = 0; i < fonts->nfont; i++ ) {
+			FT_Face registeredFace = nullptr;
+			if( ( FcPatternGetFTFace( fonts->fonts[ i ], FC_FT_FACE, 0, &registeredFace ) == FcResultMatch ) && ( registeredFace == face ) ) {
+				FcPatternDestroy( fonts->fonts[ i ] );
+				removed = true;
+			} else {
+				fonts->fonts[ kept++ ] = fonts->fonts[ i ];
+			}
+		}
+		fonts->nfont = kept;
+	}
+	return removed;
+}
@@ -0,0 +1,75 @@
+// CinderPangoFreeType.h
+// Cinder-Pango
+//
+// FreeType calls shared by FontPack, FontVariations and FontWatcher, and the font set lock they share with the threads
+// that match fonts in the background. Not part of the public API.
+
+#pragma once
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_MULTIPLE_MASTERS_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango { namespace detail {
+
+// FreeType libraries aren't thread safe, hold this while creating or destroying faces. The faces themselves are
+// only ever used by Cairo, which locks them on its own.
+std::mutex& getFreeTypeMutex();
+
+// The process' library, created on first use and kept until exit. Null if FreeType couldn't be loaded.
+FT_Library getFreeTypeLibrary();
+
+// The block ships FreeType's DLL but no import library on Windows, so there these are looked up at runtime
+FT_Error newMemoryFace( const FT_Byte *data, FT_Long size, FT_Long index, FT_Face *face );
+FT_Error newFace( const char *path, FT_Long index, FT_Face *face );
+void doneFace( FT_Face face );
+FT_Error getMMVar( FT_Face face, FT_MM_Var **variations );
+void doneMMVar( FT_MM_Var *variations );
+FT_Error setVarDesignCoordinates( FT_Face face, FT_UInt count, FT_Fixed *coordinates );
+
+// fontconfig's font sets are plain arrays that registerFace() reallocates and unregisterFace() compacts, while matching
+// (FcFontSort, FcFontMatch) walks them without any locking. Threads that lay out or match fonts next to the render thread
+// (warm-up, batch measurement, paged export) hold a read scope for as long as they work, and the font sets are only
+// changed under a write lock. Readers never wait for each other.
+class FontSetReadScope {
+  public:
+	FontSetReadScope();
+	~FontSetReadScope();
+
+	FontSetReadScope( const FontSetReadScope & ) = delete;
+	FontSetReadScope& operator=( const FontSetReadScope & ) = delete;
+};
+
+// With wait, blocks until no reader is left. Otherwise only locks if there's no reader right now, callers check
+// isLocked() and try again later. Take it before the FreeType mutex.
+class FontSetWriteLock {
+  public:
+	explicit FontSetWriteLock( bool wait );
+
+	bool isLocked() const { return mLock.owns_lock(); }
+
+  private:
+	std::unique_lock<std::mutex> mLock;
+};
+
+// Describes the face with fontconfig and adds it to the application fonts, under family instead of its own name unless
+// family is empty. The face has to stay alive for the life of the process. Returns the registered family, empty on failure.
+// Called with the font set write locked.
+std::string registerFace( FT_Face face, const std::string &name, int index, const std::string &family = std::string() );
+
+// Takes a registered face's pattern out of fontconfig's font sets, so new matches stop finding it. Fonts Pango or Cairo
+// already created hold their own references, the face has to stay alive anyway. Returns false if it wasn't registered.
+// Called with the font set write locked.
+bool unregisterFace( FT_Face face );
+
+// Unregisters the FontVariations instances made from the families' faces and forgets the families' axes, so the next
+// resolve() builds them again from whatever faces the families have now. Adds the dropped instances' families to
+// families. For faces replaced or removed at runtime (see FontWatcher), called with the font set write locked.
+void dropVariationInstances( std::vector<std::string> &families );
+
+}}} // namespace kp::pango::detail
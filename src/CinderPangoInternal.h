@@ -0,0 +1,26 @@
+// CinderPangoInternal.h
+// Cinder-Pango
+//
+// Helpers shared between the CinderPango translation units, not part of the public API.
+
+#pragma once
+
+#include "CinderPangoCore.h"
+
+namespace kp { namespace pango { namespace detail {
+
+void applyFontOptions( PangoContext *context, cairo_font_options_t *fontOptions, const TextQuality &quality );
+PangoFontDescription* createFontDescription( const std::string &font, float size, TextWeight weight, bool italicsEnabled, bool smallCapsEnabled );
+void applyAlignment( PangoLayout *layout, TextAlignment alignment );
+TextMetrics getLayoutMetrics( PangoLayout *layout, const ci::ivec2 &maxSize );
+// Font maps the library lays out with are created here, so it knows which of them may still hold fonts of faces that
+// were replaced or removed since
+PangoFontMap* createFontMap();
+void clearFontMapCache( PangoFontMap *fontMap ); // Pango's fontsets and fonts, fontconfig fonts only
+// The FontFallback change serial the longest uncleared font map from createFontMap last dropped its fonts at. Faces
+// unregistered before a change with a later serial are in none of them.
+uint64_t getOldestFontMapCache();
+// Requested families, including ones that weren't found and fell back, and the families the runs were drawn with
+void addLayoutFamilies( PangoLayout *layout, std::vector<std::string> &families );
+
+}}} // namespace kp::pango::detail
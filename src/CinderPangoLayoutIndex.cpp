@@ -0,0 +1,212 @@
+// CinderPangoLayoutIndex.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoLayoutIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace kp::pango;
+using namespace ci;
+
+void LayoutIndex::clear()
+{
+	mLines.clear();
+	mClusters.clear();
+	mLogicalOrder.clear();
+	mCharByteOffsets.clear();
+}
+
+void LayoutIndex::build( PangoLayout *layout )
+{
+	clear();
+
+	// Character offsets first, so clusters can store character indices instead of bytes
+	const char *text = pango_layout_get_text( layout );
+	const char *end = text + strlen( text );
+	for( const char *p = text; p < end; p = g_utf8_next_char( p ) ) {
+		mCharByteOffsets.push_back( static_cast<int>( p - text ) );
+	}
+	mCharByteOffsets.push_back( static_cast<int>( end - text ) );
+
+	PangoLayoutIter *iter = pango_layout_get_iter( layout );
+	PangoLayoutLine *currentLine = nullptr;
+
+	do {
+		PangoLayoutLine *line = pango_layout_iter_get_line_readonly( iter );
+
+		if( line != currentLine ) {
+			if( ! mLines.empty() ) {
+				mLines.back().clusterEnd = mClusters.size();
+			}
+
+			int y0 = 0;
+			int y1 = 0;
+			pango_layout_iter_get_line_yrange( iter, &y0, &y1 );
+
+			PangoRectangle lineRect;
+			pango_layout_iter_get_line_extents( iter, nullptr, &lineRect );
+
+			Line entry;
+			entry.left = lineRect.x / static_cast<float>( PANGO_SCALE );
+			entry.top = y0 / static_cast<float>( PANGO_SCALE );
+			entry.bottom = y1 / static_cast<float>( PANGO_SCALE );
+			entry.baseline = pango_layout_iter_get_baseline( iter ) / static_cast<float>( PANGO_SCALE );
+			entry.clusterBegin = mClusters.size();
+			entry.clusterEnd = mClusters.size();
+			mLines.push_back( entry );
+
+			currentLine = line;
+		}
+
+		PangoRectangle logicalRect;
+		pango_layout_iter_get_cluster_extents( iter, nullptr, &logicalRect );
+
+		// The run is null at the end of each line, which still gives us a zero width caret stop there
+		PangoLayoutRun *run = pango_layout_iter_get_run_readonly( iter );
+
+		Cluster cluster;
+		cluster.x = logicalRect.x / static_cast<float>( PANGO_SCALE );
+		cluster.width = logicalRect.width / static_cast<float>( PANGO_SCALE );
+		cluster.charIndex = byteToCharIndex( pango_layout_iter_get_index( iter ) );
+		cluster.charCount = 0;
+		cluster.rightToLeft = run && ( run->item->analysis.level % 2 );
+
+		// Clusters report negative widths in right-to-left runs
+		if( cluster.width < 0.0f ) {
+			cluster.x += cluster.width;
+			cluster.width = -cluster.width;
+		}
+
+		mClusters.push_back( cluster );
+	} while( pango_layout_iter_next_cluster( iter ) );
+
+	pango_layout_iter_free( iter );
+
+	if( ! mLines.empty() ) {
+		mLines.back().clusterEnd = mClusters.size();
+	}
+
+	// Line end stops of right-to-left paragraphs don't sit at the right edge, keep each line in strict visual order
+	for( const Line &line : mLines ) {
+		std::stable_sort( mClusters.begin() + line.clusterBegin, mClusters.begin() + line.clusterEnd, []( const Cluster &a, const Cluster &b ) { return a.x < b.x; } );
+	}
+
+	// Sort clusters logically to find out how many characters each one covers, and to search by character later
+	mLogicalOrder.resize( mClusters.size() );
+	for( size_t i = 0; i < mLogicalOrder.size(); i++ ) {
+		mLogicalOrder[ i ] = i;
+	}
+
+	std::stable_sort( mLogicalOrder.begin(), mLogicalOrder.end(), [this]( size_t a, size_t b ) { return mClusters[ a ].charIndex < mClusters[ b ].charIndex; } );
+
+	const int charCount = static_cast<int>( mCharByteOffsets.size() ) - 1;
+	for( size_t i = 0; i < mLogicalOrder.size(); i++ ) {
+		Cluster &cluster = mClusters[ mLogicalOrder[ i ] ];
+		const int nextCharIndex = ( i + 1 < mLogicalOrder.size() ) ? mClusters[ mLogicalOrder[ i + 1 ] ].charIndex : charCount;
+		cluster.charCount = std::max( nextCharIndex - cluster.charIndex, 0 );
+	}
+}
+
+size_t LayoutIndex::findLine( float y ) const
+{
+	// First line whose bottom is below y, clamped to the last line
+	auto it = std::upper_bound( mLines.begin(), mLines.end(), y, []( float value, const Line &line ) { return value < line.bottom; } );
+	if( it == mLines.end() ) {
+		return mLines.size() - 1;
+	}
+
+	return static_cast<size_t>( it - mLines.begin() );
+}
+
+int LayoutIndex::hitTest( const vec2 &position, int *trailing ) const
+{
+	if( trailing ) {
+		*trailing = 0;
+	}
+
+	if( mLines.empty() ) {
+		return 0;
+	}
+
+	const Line &line = mLines[ findLine( position.y ) ];
+	if( line.clusterBegin == line.clusterEnd ) {
+		return 0;
+	}
+
+	auto begin = mClusters.begin() + line.clusterBegin;
+	auto end = mClusters.begin() + line.clusterEnd;
+
+	// Last cluster starting at or before x, clamped to the line
+	auto it = std::upper_bound( begin, end, position.x, []( float value, const Cluster &cluster ) { return value < cluster.x; } );
+	if( it != begin ) {
+		--it;
+	}
+
+	const Cluster &cluster = *it;
+	if( trailing && cluster.charCount > 0 ) {
+		// Which half of the cluster is "after" depends on the direction of the run
+		const bool rightHalf = position.x >= ( cluster.x + cluster.width * 0.5f );
+		*trailing = ( rightHalf != cluster.rightToLeft ) ? cluster.charCount : 0;
+	}
+
+	return cluster.charIndex;
+}
+
+Rectf LayoutIndex::getCaretRect( int charIndex ) const
+{
+	if( mLines.empty() ) {
+		return Rectf( 0.0f, 0.0f, 1.0f, 0.0f );
+	}
+
+	// Last cluster starting at or before the index
+	auto it = std::upper_bound( mLogicalOrder.begin(), mLogicalOrder.end(), charIndex, [this]( int value, size_t clusterIndex ) { return value < mClusters[ clusterIndex ].charIndex; } );
+	if( it != mLogicalOrder.begin() ) {
+		--it;
+	}
+
+	const size_t clusterIndex = *it;
+	const Cluster &cluster = mClusters[ clusterIndex ];
+
+	// Interpolate inside clusters covering several characters (ligatures, combining marks)
+	float offset = 0.0f;
+	if( cluster.charCount > 1 ) {
+		offset = cluster.width * glm::clamp( charIndex - cluster.charIndex, 0, cluster.charCount ) / static_cast<float>( cluster.charCount );
+	}
+
+	const float x = cluster.rightToLeft ? ( cluster.x + cluster.width - offset ) : ( cluster.x + offset );
+
+	// Clusters are stored line by line, so the owning line can be found by cluster index
+	auto lineIt = std::upper_bound( mLines.begin(), mLines.end(), clusterIndex, []( size_t value, const Line &line ) { return value < line.clusterEnd; } );
+	const Line &line = ( lineIt == mLines.end() ) ? mLines.back() : *lineIt;
+
+	return Rectf( x, line.top, x + 1.0f, line.bottom );
+}
+
+void LayoutIndex::getLineRange( float top, float bottom, size_t *first, size_t *last ) const
+{
+	if( mLines.empty() || bottom <= top ) {
+		*first = *last = 0;
+		return;
+	}
+
+	*first = static_cast<size_t>( std::upper_bound( mLines.begin(), mLines.end(), top, []( float value, const Line &line ) { return value < line.bottom; } ) - mLines.begin() );
+	*last = static_cast<size_t>( std::lower_bound( mLines.begin(), mLines.end(), bottom, []( const Line &line, float value ) { return line.top < value; } ) - mLines.begin() );
+	*last = std::max( *first, *last );
+}
+
+int LayoutIndex::byteToCharIndex( int byteIndex ) const
+{
+	auto it = std::upper_bound( mCharByteOffsets.begin(), mCharByteOffsets.end(), byteIndex );
+	return std::max( static_cast<int>( it - mCharByteOffsets.begin() ) - 1, 0 );
+}
+
+int LayoutIndex::charToByteIndex( int charIndex ) const
+{
+	if( mCharByteOffsets.empty() ) {
+		return 0;
+	}
+
+	return mCharByteOffsets[ glm::clamp( charIndex, 0, static_cast<int>( mCharByteOffsets.size() ) - 1 ) ];
+}
@@ -0,0 +1,72 @@
+// CinderPangoLayoutIndex.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPangoTypes.h"
+
+#include <pango/pango.h>
+
+#include <vector>
+
+namespace kp { namespace pango {
+
+// Flattened copy of a layout's line and cluster geometry, built once per layout pass so hit tests and
+// caret queries can binary search instead of walking the PangoLayout every time.
+//
+// All coordinates are in pixels relative to the top left of the text as drawn. CinderPango flips its
+// Cairo surface vertically (cairo_scale( ..., -1 )) so the texture comes out right side up in GL. Surface
+// row r therefore holds layout y = height - r, use layoutToSurface() if you're poking at raw pixels.
+class LayoutIndex {
+  public:
+	struct Line {
+		float left; // lines can be offset by alignment
+		float top;
+		float bottom;
+		float baseline;
+		size_t clusterBegin; // range into the cluster list, in visual (left to right) order
+		size_t clusterEnd;
+	};
+
+	struct Cluster {
+		float x;
+		float width;
+		int charIndex;
+		int charCount;
+		bool rightToLeft;
+	};
+
+	void build( PangoLayout *layout );
+	void clear();
+	bool isEmpty() const { return mLines.empty(); }
+
+	// Returns the character index nearest to the position, trailing is set to the number of characters
+	// to add to get the caret position (0 on the leading half of a cluster)
+	int hitTest( const ci::vec2 &position, int *trailing = nullptr ) const;
+
+	// Caret for the position in front of the given character index, one pixel wide and the height of the line
+	ci::Rectf getCaretRect( int charIndex ) const;
+
+	// Lines intersecting [top, bottom), returned as a half-open range of line indices
+	void getLineRange( float top, float bottom, size_t *first, size_t *last ) const;
+
+	const std::vector<Line>& getLines() const { return mLines; }
+	const std::vector<Cluster>& getClusters() const { return mClusters; }
+
+	// Character index for a byte offset into the layout's text, and back
+	int byteToCharIndex( int byteIndex ) const;
+	int charToByteIndex( int charIndex ) const;
+
+	static ci::vec2 layoutToSurface( const ci::vec2 &position, int surfaceHeight ) { return ci::vec2( position.x, surfaceHeight - position.y ); }
+
+  private:
+	size_t findLine( float y ) const;
+
+	std::vector<Line> mLines;
+	std::vector<Cluster> mClusters;
+	std::vector<size_t> mLogicalOrder; // cluster indices sorted by character index
+	std::vector<int> mCharByteOffsets; // byte offset of each character, plus one past the end
+};
+
+}} // namespace kp::pango
@@ -0,0 +1,146 @@
+// CinderPangoLedger.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoLedger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+using namespace kp::pango;
+
+#ifdef NDEBUG
+std::atomic<bool> ResourceLedger::sEnabled( false );
+#else
+std::atomic<bool> ResourceLedger::sEnabled( true );
+#endif
+
+namespace {
+
+const char *sResourceNames[] = { "font map", "pango context", "layout", "font description", "attribute list", "font options", "surface", "cairo context" };
+
+static_assert( sizeof( sResourceNames ) / sizeof( sResourceNames[ 0 ] ) == static_cast<size_t>( Resource::COUNT ), "Every resource needs a name" );
+
+struct Ledger {
+	std::mutex mutex;
+	std::unordered_set<const void *> live[ static_cast<int>( Resource::COUNT ) ];
+	uint64_t created[ static_cast<int>( Resource::COUNT ) ] = {};
+	bool reportAtExit = false;
+	bool exitHandlerRegistered = false;
+};
+
+Ledger& getLedger()
+{
+	static Ledger sLedger;
+	return sLedger;
+}
+
+void reportAtExit()
+{
+	bool report;
+	{
+		std::lock_guard<std::mutex> lock( getLedger().mutex );
+		report = getLedger().reportAtExit;
+	}
+
+	const std::string leaks = report ? ResourceLedger::getLeakReport() : std::string();
+	if( ! leaks.empty() ) {
+		std::fputs( leaks.c_str(), stderr );
+	}
+}
+
+} // anonymous namespace
+
+void ResourceLedger::setEnabled( bool enabled )
+{
+	sEnabled.store( enabled, std::memory_order_relaxed );
+}
+
+const char* ResourceLedger::getName( Resource type )
+{
+	return sResourceNames[ static_cast<int>( type ) ];
+}
+
+void ResourceLedger::add( Resource type, const void *object )
+{
+	Ledger &ledger = getLedger();
+	std::lock_guard<std::mutex> lock( ledger.mutex );
+	ledger.live[ static_cast<int>( type ) ].insert( object );
+	ledger.created[ static_cast<int>( type ) ]++;
+}
+
+void ResourceLedger::remove( Resource type, const void *object )
+{
+	// Objects from before the ledger was enabled aren't in it, that's fine
+	Ledger &ledger = getLedger();
+	std::lock_guard<std::mutex> lock( ledger.mutex );
+	ledger.live[ static_cast<int>( type ) ].erase( object );
+}
+
+size_t ResourceLedger::getLiveCount( Resource type )
+{
+	Ledger &ledger = getLedger();
+	std::lock_guard<std::mutex> lock( ledger.mutex );
+	return ledger.live[ static_cast<int>( type ) ].size();
+}
+
+size_t ResourceLedger::getTotalLiveCount()
+{
+	size_t count = 0;
+	for( int i = 0; i < static_cast<int>( Resource::COUNT ); i++ ) {
+		count += getLiveCount( static_cast<Resource>( i ) );
+	}
+	return count;
+}
+
+uint64_t ResourceLedger::getCreatedCount( Resource type )
+{
+	Ledger &ledger = getLedger();
+	std::lock_guard<std::mutex> lock( ledger.mutex );
+	return ledger.created[ static_cast<int>( type ) ];
+}
+
+std::string ResourceLedger::getLeakReport()
+{
+	const size_t maxAddresses = 8;
+
+	Ledger &ledger = getLedger();
+	std::lock_guard<std::mutex> lock( ledger.mutex );
+
+	std::ostringstream report;
+	for( int i = 0; i < static_cast<int>( Resource::COUNT ); i++ ) {
+		const auto &live = ledger.live[ i ];
+		if( live.empty() ) {
+			continue;
+		}
+
+		report << "Cinder-Pango: " << live.size() << " " << sResourceNames[ i ] << "(s) alive of " << ledger.created[ i ] << " created:";
+		size_t listed = 0;
+		for( const void *object : live ) {
+			if( listed++ == maxAddresses ) {
+				report << " ...";
+				break;
+			}
+			report << " " << object;
+		}
+		report << "\n";
+	}
+	return report.str();
+}
+
+void ResourceLedger::setReportAtExit( bool report )
+{
+	Ledger &ledger = getLedger();
+	std::lock_guard<std::mutex> lock( ledger.mutex );
+	ledger.reportAtExit = report;
+
+	// Registered from here rather than reporting from a static destructor, so statics created later (e.g. the
+	// measureBatch layout pool) have released their objects by the time it runs
+	if( report && ! ledger.exitHandlerRegistered ) {
+		std::atexit( reportAtExit );
+		ledger.exitHandlerRegistered = true;
+	}
+}
@@ -0,0 +1,69 @@
+// CinderPangoLedger.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace kp { namespace pango {
+
+// The GObject, Pango and Cairo objects the library creates and owns
+enum class Resource : int {
+	FONT_MAP,
+	PANGO_CONTEXT,
+	LAYOUT,
+	FONT_DESCRIPTION,
+	ATTRIBUTE_LIST, // references held on parsed markup attributes
+	FONT_OPTIONS,
+	SURFACE,
+	CAIRO_CONTEXT,
+	COUNT
+};
+
+// Debug ledger of every tracked object that's alive, so leaks show up by type and address instead of as slow RSS growth.
+// On by default in debug builds (no NDEBUG), off in release where track/untrack are a single atomic load.
+// Objects created while the ledger was off are never reported.
+class ResourceLedger {
+  public:
+	static void setEnabled( bool enabled );
+	static bool isEnabled() { return sEnabled.load( std::memory_order_relaxed ); }
+
+	// Call right after creating / right before destroying. track passes the object through for convenience.
+	template <typename T>
+	static T* track( Resource type, T *object )
+	{
+		if( isEnabled() && object ) {
+			add( type, object );
+		}
+		return object;
+	}
+
+	static void untrack( Resource type, const void *object )
+	{
+		if( isEnabled() && object ) {
+			remove( type, object );
+		}
+	}
+
+	static const char* getName( Resource type );
+	static size_t getLiveCount( Resource type );
+	static size_t getTotalLiveCount();
+	static uint64_t getCreatedCount( Resource type );
+
+	// Live objects by type, with up to a few addresses each. Empty if nothing is alive.
+	static std::string getLeakReport();
+
+	// Prints the leak report to stderr when the process exits, if there is anything to report
+	static void setReportAtExit( bool report );
+
+  private:
+	static void add( Resource type, const void *object );
+	static void remove( Resource type, const void *object );
+
+	static std::atomic<bool> sEnabled;
+};
+
+}} // namespace kp::pango
@@ -0,0 +1,253 @@
+// CinderPangoMarkup.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoMarkup.h"
+
+#include <cstring>
+
+using namespace kp::pango;
+
+namespace {
+
+bool isAlpha( char c )
+{
+	return ( ( c >= 'a' ) && ( c <= 'z' ) ) || ( ( c >= 'A' ) && ( c <= 'Z' ) );
+}
+
+bool isDigit( char c )
+{
+	return ( c >= '0' ) && ( c <= '9' );
+}
+
+bool isHexDigit( char c )
+{
+	return isDigit( c ) || ( ( c >= 'a' ) && ( c <= 'f' ) ) || ( ( c >= 'A' ) && ( c <= 'F' ) );
+}
+
+bool isSpace( char c )
+{
+	return ( c == ' ' ) || ( c == '\t' ) || ( c == '\n' ) || ( c == '\r' );
+}
+
+bool isNameChar( char c )
+{
+	return isAlpha( c ) || isDigit( c ) || ( c == '_' ) || ( c == '-' ) || ( c == ':' );
+}
+
+// Finds the '>' closing a tag, skipping over quoted attribute values. Returns end if there is none.
+const char* findTagEnd( const char *p, const char *end )
+{
+	char quote = 0;
+	for( ; p < end; ++p ) {
+		if( quote ) {
+			if( *p == quote ) {
+				quote = 0;
+			}
+		} else if( ( *p == '"' ) || ( *p == '\'' ) ) {
+			quote = *p;
+		} else if( *p == '>' ) {
+			return p;
+		} else if( *p == '<' ) {
+			// Not a tag after all, e.g. "a <b <c>"
+			return end;
+		}
+	}
+	return end;
+}
+
+// &amp; &#38; &#x26; and friends
+bool isEntity( const char *p, const char *end )
+{
+	++p; // skip '&'
+	if( ( p < end ) && ( *p == '#' ) ) {
+		++p;
+		const bool hex = ( p < end ) && ( ( *p == 'x' ) || ( *p == 'X' ) );
+		if( hex ) {
+			++p;
+		}
+
+		const char *digitsStart = p;
+		while( ( p < end ) && ( hex ? isHexDigit( *p ) : isDigit( *p ) ) ) {
+			++p;
+		}
+		return ( p > digitsStart ) && ( p < end ) && ( *p == ';' );
+	}
+
+	const char *nameStart = p;
+	while( ( p < end ) && isAlpha( *p ) ) {
+		++p;
+	}
+	return ( p > nameStart ) && ( p < end ) && ( *p == ';' );
+}
+
+bool containsMarkup( const char *p, const char *end )
+{
+	for( ; p < end; ++p ) {
+		if( ( *p == '<' ) || ( ( *p == '&' ) && isEntity( p, end ) ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+} // anonymous namespace
+
+MarkupPreprocessorRef MarkupPreprocessor::create()
+{
+	return MarkupPreprocessorRef( new MarkupPreprocessor() );
+}
+
+MarkupPreprocessorRef MarkupPreprocessor::getDefault()
+{
+	static MarkupPreprocessorRef sDefault = MarkupPreprocessor::create();
+	return sDefault;
+}
+
+void MarkupPreprocessor::registerTag( const std::string &name, const TagExpansion &expansion )
+{
+	unregisterTag( name );
+
+	CustomTag tag;
+	tag.name = name;
+	tag.expansion = expansion;
+	mTags.push_back( tag );
+}
+
+void MarkupPreprocessor::registerStyleAlias( const std::string &name, const std::string &openMarkup, const std::string &closeMarkup )
+{
+	unregisterTag( name );
+
+	CustomTag tag;
+	tag.name = name;
+	tag.openMarkup = openMarkup;
+	tag.closeMarkup = closeMarkup;
+	mTags.push_back( tag );
+}
+
+void MarkupPreprocessor::unregisterTag( const std::string &name )
+{
+	for( auto it = mTags.begin(); it != mTags.end(); ++it ) {
+		if( it->name == name ) {
+			mTags.erase( it );
+			return;
+		}
+	}
+}
+
+const MarkupPreprocessor::CustomTag* MarkupPreprocessor::findTag( const char *name, size_t length ) const
+{
+	// Only a handful of tags are ever registered, a linear scan beats hashing (and doesn't allocate)
+	for( const CustomTag &tag : mTags ) {
+		if( ( tag.name.size() == length ) && ( std::memcmp( tag.name.data(), name, length ) == 0 ) ) {
+			return &tag;
+		}
+	}
+	return nullptr;
+}
+
+bool MarkupPreprocessor::process( const std::string &input, std::string &output ) const
+{
+	output.clear();
+	output.reserve( input.size() );
+
+	bool hasMarkup = false;
+
+	const char *p = input.data();
+	const char *end = p + input.size();
+	const char *literalStart = p;
+
+	while( p < end ) {
+		if( *p == '&' ) {
+			if( ! hasMarkup && isEntity( p, end ) ) {
+				hasMarkup = true;
+			}
+			++p;
+			continue;
+		}
+
+		if( *p != '<' ) {
+			++p;
+			continue;
+		}
+
+		// Looks like a tag, parse "<" "/"? name ... ">"
+		const char *tagStart = p;
+		const char *q = p + 1;
+		const bool closing = ( q < end ) && ( *q == '/' );
+		if( closing ) {
+			++q;
+		}
+
+		const char *nameStart = q;
+		if( ( q >= end ) || ! isAlpha( *q ) ) {
+			// A lone '<' is just text, e.g. "a < b"
+			++p;
+			continue;
+		}
+
+		while( ( q < end ) && isNameChar( *q ) ) {
+			++q;
+		}
+		const size_t nameLength = q - nameStart;
+
+		const char *tagEnd = findTagEnd( q, end );
+		if( tagEnd == end ) {
+			++p;
+			continue;
+		}
+
+		const char *attributes = q;
+		size_t attributesLength = tagEnd - q;
+
+		// Flush the text before the tag
+		output.append( literalStart, tagStart );
+		literalStart = tagEnd + 1;
+		p = tagEnd + 1;
+
+		// <br>, <BR>, <br/>, <br />
+		if( ! closing && ( nameLength == 2 ) && ( ( nameStart[ 0 ] | 0x20 ) == 'b' ) && ( ( nameStart[ 1 ] | 0x20 ) == 'r' ) ) {
+			const char *a = attributes;
+			const char *attributesEnd = attributes + attributesLength;
+			while( ( a < attributesEnd ) && isSpace( *a ) ) {
+				++a;
+			}
+			if( ( a < attributesEnd ) && ( *a == '/' ) ) {
+				++a;
+			}
+			if( a == attributesEnd ) {
+				output.push_back( '\n' );
+				continue;
+			}
+		}
+
+		const CustomTag *tag = findTag( nameStart, nameLength );
+		if( tag ) {
+			const size_t replacementStart = output.size();
+			if( tag->expansion ) {
+				// Closing tags of expansions have nothing to expand to
+				if( ! closing ) {
+					// Drop the self-closing slash
+					if( ( attributesLength > 0 ) && ( attributes[ attributesLength - 1 ] == '/' ) ) {
+						attributesLength--;
+					}
+					tag->expansion( attributes, attributesLength, output );
+				}
+			} else {
+				output.append( closing ? tag->closeMarkup : tag->openMarkup );
+			}
+
+			if( ! hasMarkup ) {
+				hasMarkup = containsMarkup( output.data() + replacementStart, output.data() + output.size() );
+			}
+			continue;
+		}
+
+		// A real tag for Pango
+		output.append( tagStart, tagEnd + 1 );
+		hasMarkup = true;
+	}
+
+	output.append( literalStart, end );
+	return hasMarkup;
+}
@@ -0,0 +1,61 @@
+// CinderPangoMarkup.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+using MarkupPreprocessorRef = std::shared_ptr<class MarkupPreprocessor>;
+
+// Prepares text for Pango in a single pass over the string:
+// - HTML-esque line breaks (<br>, <BR>, <br/>, <br />) become newlines, Pango doesn't know them
+// - Registered custom tags are expanded, either through a callback or as a style alias for a span
+// - Decides whether any real markup (tags or entities) is left, so plain text can skip the markup parser
+//
+// Register tags up front, processing is const and may run on several threads at once (e.g. batch measurement),
+// but registering isn't synchronized with it.
+class MarkupPreprocessor {
+  public:
+	static MarkupPreprocessorRef create();
+
+	// Used by every CinderPango instance unless it's given its own
+	static MarkupPreprocessorRef getDefault();
+
+	// Called for <name ...> or <name .../>, with everything between the name and the closing bracket.
+	// Append the replacement to output. Replacements may contain Pango markup.
+	using TagExpansion = std::function<void( const char *attributes, size_t attributesLength, std::string &output )>;
+	void registerTag( const std::string &name, const TagExpansion &expansion );
+
+	// <name> expands to openMarkup and </name> to closeMarkup,
+	// e.g. registerStyleAlias( "title", "<span font=\"Sans Bold 24\">", "</span>" )
+	void registerStyleAlias( const std::string &name, const std::string &openMarkup, const std::string &closeMarkup );
+
+	void unregisterTag( const std::string &name );
+
+	// Writes the processed text to output and returns true if it contains markup.
+	// Output is overwritten but keeps its capacity, so repeated calls with similar text don't allocate.
+	bool process( const std::string &input, std::string &output ) const;
+
+  protected:
+	MarkupPreprocessor() {}
+
+  private:
+	struct CustomTag {
+		std::string name;
+		TagExpansion expansion;
+		std::string openMarkup;
+		std::string closeMarkup;
+	};
+
+	const CustomTag* findTag( const char *name, size_t length ) const;
+
+	std::vector<CustomTag> mTags;
+};
+
+}} // namespace kp::pango
@@ -0,0 +1,169 @@
+// CinderPangoMetrics.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoMetrics.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace kp::pango;
+
+std::atomic<int64_t> Metrics::sCounters[ static_cast<int>( Counter::COUNT ) ] = {};
+
+namespace {
+
+struct CounterInfo {
+	const char *name;
+	const char *help;
+	bool gauge;
+};
+
+const CounterInfo sCounterInfo[] = {
+	{ "cinder_pango_instances_alive", "CinderPango instances currently alive.", true },
+	{ "cinder_pango_instances_created_total", "CinderPango instances created.", false },
+	{ "cinder_pango_renders_total", "render() calls that laid out or rasterized text.", false },
+	{ "cinder_pango_render_cache_hits_total", "render() calls that kept the existing texture.", false },
+	{ "cinder_pango_layout_pool_hits_total", "measureBatch layouts reused from the pool.", false },
+	{ "cinder_pango_layout_pool_misses_total", "measureBatch layouts created because the pool was empty.", false },
+	{ "cinder_pango_surfaces_allocated_total", "Cairo surfaces allocated for rendering.", false },
+	{ "cinder_pango_uploaded_bytes_total", "Bytes uploaded to textures.", false },
+	{ "cinder_pango_font_loads_total", "Fonts loaded through the Pango font map.", false },
+	{ "cinder_pango_font_files_loaded_total", "Font files registered with loadFont() or from memory with FontPack.", false },
+	{ "cinder_pango_set_markup_calls_total", "pango_layout_set_markup calls.", false },
+	{ "cinder_pango_fallback_cache_hits_total", "Font fallback lookups answered from the cache.", false },
+	{ "cinder_pango_fallback_cache_misses_total", "Font fallback lookups that searched the sorted font list.", false },
+	{ "cinder_pango_variation_instances_total", "Variable font instances created for a new quantized axis tuple.", false },
+	{ "cinder_pango_font_change_relayouts_total", "Instances laid out again because fonts they use were added, replaced or removed.", false },
+	{ "cinder_pango_font_retired_bytes", "Bytes of replaced or removed watched font files not freed yet.", true },
+};
+
+static_assert( sizeof( sCounterInfo ) / sizeof( sCounterInfo[ 0 ] ) == static_cast<size_t>( Counter::COUNT ), "Every counter needs a name" );
+
+std::atomic<double> sRendersPerSecond( 0.0 );
+
+// Periodic dump state, only touched when starting or stopping
+std::mutex sDumpMutex;
+std::condition_variable sDumpCondition;
+std::thread sDumpThread;
+bool sDumpStopRequested = false;
+
+void runPeriodicDump( std::string path, std::chrono::duration<double> interval );
+
+// A joinable thread left at exit would terminate the process
+struct DumpThreadGuard {
+	~DumpThreadGuard() { Metrics::stopPeriodicDump(); }
+} sDumpThreadGuard;
+
+void runPeriodicDump( std::string path, std::chrono::duration<double> interval )
+{
+	auto lastTime = std::chrono::steady_clock::now();
+	int64_t lastRenders = Metrics::get( Counter::RENDERS );
+
+	std::unique_lock<std::mutex> lock( sDumpMutex );
+	while( ! sDumpCondition.wait_for( lock, interval, [] { return sDumpStopRequested; } ) ) {
+		const auto time = std::chrono::steady_clock::now();
+		const int64_t renders = Metrics::get( Counter::RENDERS );
+		const double seconds = std::chrono::duration<double>( time - lastTime ).count();
+		sRendersPerSecond.store( ( seconds > 0.0 ) ? ( renders - lastRenders ) / seconds : 0.0 );
+		lastTime = time;
+		lastRenders = renders;
+
+		lock.unlock();
+		Metrics::writePrometheus( path );
+		lock.lock();
+	}
+}
+
+} // anonymous namespace
+
+const char* Metrics::getName( Counter counter )
+{
+	return sCounterInfo[ static_cast<int>( counter ) ].name;
+}
+
+const char* Metrics::getHelp( Counter counter )
+{
+	return sCounterInfo[ static_cast<int>( counter ) ].help;
+}
+
+bool Metrics::isGauge( Counter counter )
+{
+	return sCounterInfo[ static_cast<int>( counter ) ].gauge;
+}
+
+double Metrics::getRendersPerSecond()
+{
+	return sRendersPerSecond.load();
+}
+
+std::string Metrics::formatPrometheus()
+{
+	std::ostringstream stream;
+	for( int i = 0; i < static_cast<int>( Counter::COUNT ); i++ ) {
+		const Counter counter = static_cast<Counter>( i );
+		stream << "# HELP " << getName( counter ) << " " << getHelp( counter ) << "\n";
+		stream << "# TYPE " << getName( counter ) << ( isGauge( counter ) ? " gauge\n" : " counter\n" );
+		stream << getName( counter ) << " " << get( counter ) << "\n";
+	}
+
+	stream << "# HELP cinder_pango_renders_per_second Renders per second over the last dump interval.\n";
+	stream << "# TYPE cinder_pango_renders_per_second gauge\n";
+	stream << "cinder_pango_renders_per_second " << getRendersPerSecond() << "\n";
+	return stream.str();
+}
+
+bool Metrics::writePrometheus( const std::string &path )
+{
+	const std::string temporaryPath = path + ".tmp";
+	FILE *file = std::fopen( temporaryPath.c_str(), "w" );
+	if( ! file ) {
+		return false;
+	}
+
+	const std::string text = formatPrometheus();
+	const bool written = ( std::fwrite( text.data(), 1, text.size(), file ) == text.size() );
+	if( ( std::fclose( file ) != 0 ) || ! written ) {
+		std::remove( temporaryPath.c_str() );
+		return false;
+	}
+
+	return std::rename( temporaryPath.c_str(), path.c_str() ) == 0;
+}
+
+void Metrics::startPeriodicDump( const std::string &path, double intervalSeconds )
+{
+	stopPeriodicDump();
+
+	std::lock_guard<std::mutex> lock( sDumpMutex );
+	sDumpStopRequested = false;
+	sDumpThread = std::thread( runPeriodicDump, path, std::chrono::duration<double>( intervalSeconds ) );
+}
+
+void Metrics::stopPeriodicDump()
+{
+	{
+		std::lock_guard<std::mutex> lock( sDumpMutex );
+		if( ! sDumpThread.joinable() ) {
+			return;
+		}
+		sDumpStopRequested = true;
+	}
+
+	sDumpCondition.notify_all();
+	sDumpThread.join();
+	sRendersPerSecond.store( 0.0 );
+}
+
+void Metrics::reset()
+{
+	for( int i = 0; i < static_cast<int>( Counter::COUNT ); i++ ) {
+		if( ! isGauge( static_cast<Counter>( i ) ) ) {
+			sCounters[ i ].store( 0, std::memory_order_relaxed );
+		}
+	}
+}
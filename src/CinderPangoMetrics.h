@@ -0,0 +1,65 @@
+// CinderPangoMetrics.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace kp { namespace pango {
+
+// Process wide counters, always on. Incrementing one is a single relaxed atomic add.
+enum class Counter : int {
+	INSTANCES_ALIVE, // gauge
+	INSTANCES_CREATED,
+	RENDERS,		   // render() calls that did work
+	RENDER_CACHE_HITS, // render() calls that found nothing invalidated and kept the existing texture
+	LAYOUT_POOL_HITS,  // measureBatch reusing a pooled layout
+	LAYOUT_POOL_MISSES,
+	SURFACES_ALLOCATED,
+	BYTES_UPLOADED,
+	FONT_LOADS,		   // default font descriptions loaded through the font map
+	FONT_FILES_LOADED, // CinderPango::loadFont and FontPack
+	SET_MARKUP_CALLS,  // pango_layout_set_markup, i.e. markup parses
+	FALLBACK_CACHE_HITS, // FontFallback lookups answered without walking the font list
+	FALLBACK_CACHE_MISSES,
+	VARIATION_INSTANCES, // variable font instances created by FontVariations, one FreeType face each
+	FONT_CHANGE_RELAYOUTS, // instances laid out again because fonts they use changed, see FontWatcher
+	FONT_BYTES_RETIRED, // gauge, data of replaced or removed watched font files still held for fonts made from it
+	COUNT
+};
+
+class Metrics {
+  public:
+	static void increment( Counter counter, int64_t amount = 1 ) { sCounters[ static_cast<int>( counter ) ].fetch_add( amount, std::memory_order_relaxed ); }
+	static void decrement( Counter counter, int64_t amount = 1 ) { sCounters[ static_cast<int>( counter ) ].fetch_sub( amount, std::memory_order_relaxed ); }
+	static int64_t get( Counter counter ) { return sCounters[ static_cast<int>( counter ) ].load( std::memory_order_relaxed ); }
+
+	// Metric name in the export, e.g. "cinder_pango_renders_total"
+	static const char* getName( Counter counter );
+	static const char* getHelp( Counter counter );
+	static bool isGauge( Counter counter );
+
+	// Renders per second over the last dump interval, 0 unless the periodic dump is running
+	static double getRendersPerSecond();
+
+	// Prometheus text exposition format, one HELP / TYPE / value block per counter
+	static std::string formatPrometheus();
+	static bool writePrometheus( const std::string &path );
+
+	// Rewrites the file every interval from a background thread, so it can be scraped (e.g. by node_exporter's
+	// textfile collector) without attaching anything to the process. Writes go to a temporary file that's renamed
+	// over the old one, readers never see a partial file. Starting again replaces the previous dump.
+	static void startPeriodicDump( const std::string &path, double intervalSeconds = 10.0 );
+	static void stopPeriodicDump();
+
+	// Zeroes everything except the gauges
+	static void reset();
+
+  private:
+	static std::atomic<int64_t> sCounters[ static_cast<int>( Counter::COUNT ) ];
+};
+
+}} // namespace kp::pango
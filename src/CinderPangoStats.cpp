@@ -0,0 +1,187 @@
+// CinderPangoStats.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoStats.h"
+#include "CinderPangoTrace.h"
+
+#include <algorithm>
+
+using namespace kp::pango;
+
+namespace {
+
+std::mutex sGlobalMutex;
+
+RenderStatsHistory& getGlobalHistory()
+{
+	static RenderStatsHistory sGlobalHistory( 1024 );
+	return sGlobalHistory;
+}
+
+} // anonymous namespace
+
+const char* kp::pango::getRenderStageName( RenderStage stage )
+{
+	switch( stage ) {
+		case RenderStage::MARKUP:
+			return "markup";
+		case RenderStage::FONT_OPTIONS:
+			return "font_options";
+		case RenderStage::FONT:
+			return "font";
+		case RenderStage::LAYOUT:
+			return "layout";
+		case RenderStage::RECOLOR:
+			return "recolor";
+		case RenderStage::SURFACE:
+			return "surface";
+		case RenderStage::RASTER:
+			return "raster";
+		case RenderStage::UPLOAD:
+			return "upload";
+		default:
+			return "unknown";
+	}
+}
+
+RenderStatsHistory::RenderStatsHistory( size_t windowSize ) :
+	mWindowSize( std::max<size_t>( windowSize, 1 ) ),
+	mNumRecorded( 0 ),
+	mTotalBytesRasterized( 0 ),
+	mTotalBytesUploaded( 0 )
+{
+	for( auto &samples : mStageSamples ) {
+		samples.reserve( mWindowSize );
+	}
+	mTotalSamples.reserve( mWindowSize );
+}
+
+void RenderStatsHistory::record( const RenderStats &stats )
+{
+	const size_t slot = mNumRecorded % mWindowSize;
+	auto store = [&]( std::vector<double> &samples, double value ) {
+		if( samples.size() < mWindowSize ) {
+			samples.push_back( value );
+		} else {
+			samples[ slot ] = value;
+		}
+	};
+
+	for( size_t i = 0; i < mStageSamples.size(); i++ ) {
+		store( mStageSamples[ i ], stats.stageSeconds[ i ] );
+	}
+	store( mTotalSamples, stats.totalSeconds );
+
+	mLast = stats;
+	mNumRecorded++;
+	mTotalBytesRasterized += stats.bytesRasterized;
+	mTotalBytesUploaded += stats.bytesUploaded;
+}
+
+void RenderStatsHistory::clear()
+{
+	for( auto &samples : mStageSamples ) {
+		samples.clear();
+	}
+	mTotalSamples.clear();
+	mLast = RenderStats();
+	mNumRecorded = 0;
+	mTotalBytesRasterized = 0;
+	mTotalBytesUploaded = 0;
+}
+
+double RenderStatsHistory::getPercentile( RenderStage stage, double percentile ) const
+{
+	return getPercentile( mStageSamples[ static_cast<size_t>( stage ) ], percentile );
+}
+
+double RenderStatsHistory::getTotalPercentile( double percentile ) const
+{
+	return getPercentile( mTotalSamples, percentile );
+}
+
+double RenderStatsHistory::getPercentile( const std::vector<double> &samples, double percentile ) const
+{
+	if( samples.empty() ) {
+		return 0.0;
+	}
+
+	// Nearest rank on a copy, the window is small and this isn't called per frame
+	std::vector<double> sorted( samples );
+	const size_t rank = std::min( static_cast<size_t>( percentile / 100.0 * sorted.size() ), sorted.size() - 1 );
+	std::nth_element( sorted.begin(), sorted.begin() + rank, sorted.end() );
+	return sorted[ rank ];
+}
+
+void RenderStatsHistory::recordGlobal( const RenderStats &stats )
+{
+	std::lock_guard<std::mutex> lock( sGlobalMutex );
+	getGlobalHistory().record( stats );
+}
+
+RenderStatsHistory RenderStatsHistory::getGlobalSnapshot()
+{
+	std::lock_guard<std::mutex> lock( sGlobalMutex );
+	return getGlobalHistory();
+}
+
+void RenderStatsHistory::clearGlobal()
+{
+	std::lock_guard<std::mutex> lock( sGlobalMutex );
+	getGlobalHistory().clear();
+}
+
+RenderStatsScope::RenderStatsScope( RenderStatsHistory *history, const void *instance ) :
+	mHistory( history ),
+	mInstance( instance ),
+	mTracing( Trace::isEnabled() ),
+	mStartTime( 0 ),
+	mStageStartTime( 0 ),
+	mStage( RenderStage::MARKUP ),
+	mInStage( false )
+{
+	if( mHistory || mTracing ) {
+		mStartTime = Trace::now();
+	}
+}
+
+RenderStatsScope::~RenderStatsScope()
+{
+	if( mHistory || mTracing ) {
+		endStage();
+		const int64_t endTime = Trace::now();
+
+		if( mTracing ) {
+			Trace::record( "render", mInstance, mStartTime, endTime );
+		}
+
+		if( mHistory ) {
+			mStats.totalSeconds = ( endTime - mStartTime ) * 1e-9;
+			mHistory->record( mStats );
+			RenderStatsHistory::recordGlobal( mStats );
+		}
+	}
+}
+
+void RenderStatsScope::beginStage( RenderStage stage )
+{
+	if( mHistory || mTracing ) {
+		endStage();
+		mStage = stage;
+		mStageStartTime = Trace::now();
+		mInStage = true;
+	}
+}
+
+void RenderStatsScope::endStage()
+{
+	if( mInStage ) {
+		const int64_t endTime = Trace::now();
+		mStats.stageSeconds[ static_cast<size_t>( mStage ) ] += ( endTime - mStageStartTime ) * 1e-9;
+		if( mTracing ) {
+			Trace::record( getRenderStageName( mStage ), mInstance, mStageStartTime, endTime );
+		}
+		mInStage = false;
+	}
+}
@@ -0,0 +1,117 @@
+// CinderPangoStats.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace kp { namespace pango {
+
+// The stages of CinderPango::render, in order
+enum class RenderStage : int {
+	MARKUP,		  // preprocessing and markup detection
+	FONT_OPTIONS, // cairo font options on the context
+	FONT,		  // building and loading the font description
+	LAYOUT,		  // setting text and attributes, measuring
+	RECOLOR,	  // in place color updates
+	SURFACE,	  // creating the Cairo surface and context
+	RASTER,		  // pango_cairo_show_layout
+	UPLOAD,		  // texture upload
+	COUNT
+};
+
+const char* getRenderStageName( RenderStage stage );
+
+// What one call to render() did
+struct RenderStats {
+	std::array<double, static_cast<size_t>( RenderStage::COUNT )> stageSeconds;
+	double totalSeconds = 0.0;
+
+	// The invalidations that made render() do any work
+	bool forced = false;
+	bool markupChanged = false;
+	bool fontOptionsChanged = false;
+	bool fontChanged = false;
+	bool layoutChanged = false;
+	bool textRenderNeeded = false;
+	bool recolorNeeded = false;
+	bool surfaceResized = false;
+
+	size_t bytesRasterized = 0;
+	size_t bytesUploaded = 0;
+
+	RenderStats() { stageSeconds.fill( 0.0 ); }
+
+	double getStageSeconds( RenderStage stage ) const { return stageSeconds[ static_cast<size_t>( stage ) ]; }
+};
+
+// Rolling window of render stats, with percentiles per stage.
+// Each CinderPango instance can keep one (see CinderPango::setStatsEnabled) and all of them feed the global one.
+class RenderStatsHistory {
+  public:
+	explicit RenderStatsHistory( size_t windowSize = 240 );
+
+	void record( const RenderStats &stats );
+	void clear();
+
+	const RenderStats& getLast() const { return mLast; }
+	size_t getNumSamples() const { return std::min( mNumRecorded, mWindowSize ); }
+	uint64_t getNumRecorded() const { return mNumRecorded; }
+	size_t getTotalBytesRasterized() const { return mTotalBytesRasterized; }
+	size_t getTotalBytesUploaded() const { return mTotalBytesUploaded; }
+
+	// Percentile in [0, 100] over the window, in seconds
+	double getPercentile( RenderStage stage, double percentile ) const;
+	double getTotalPercentile( double percentile ) const;
+	double getP50( RenderStage stage ) const { return getPercentile( stage, 50.0 ); }
+	double getP99( RenderStage stage ) const { return getPercentile( stage, 99.0 ); }
+
+	// Aggregate over every instance with stats enabled. The snapshot is a copy, safe to read while other threads render.
+	static void recordGlobal( const RenderStats &stats );
+	static RenderStatsHistory getGlobalSnapshot();
+	static void clearGlobal();
+
+  private:
+	double getPercentile( const std::vector<double> &samples, double percentile ) const;
+
+	size_t mWindowSize;
+	uint64_t mNumRecorded;
+	size_t mTotalBytesRasterized;
+	size_t mTotalBytesUploaded;
+	RenderStats mLast;
+	std::array<std::vector<double>, static_cast<size_t>( RenderStage::COUNT )> mStageSamples; // ring buffers
+	std::vector<double> mTotalSamples;
+};
+
+// Times the stages of one render() call and records them when it goes out of scope, into the history and, while
+// tracing is on, as trace events for the instance (see Trace). Does nothing, not even read the clock, if neither is on.
+class RenderStatsScope {
+  public:
+	RenderStatsScope( RenderStatsHistory *history, const void *instance );
+	~RenderStatsScope();
+
+	bool isEnabled() const { return mHistory != nullptr; }
+	RenderStats& getStats() { return mStats; }
+
+	// Ends the current stage, if any, and starts timing the next one
+	void beginStage( RenderStage stage );
+	void endStage();
+
+  private:
+	RenderStatsHistory *mHistory;
+	const void *mInstance;
+	bool mTracing;
+	RenderStats mStats;
+	int64_t mStartTime; // nanoseconds, Trace::now
+	int64_t mStageStartTime;
+	RenderStage mStage;
+	bool mInStage;
+};
+
+}} // namespace kp::pango
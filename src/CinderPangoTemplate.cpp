@@ -0,0 +1,526 @@
+// CinderPangoTemplate.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoTemplate.h"
+#include "CinderPangoFallback.h"
+#include "CinderPangoInternal.h"
+#include "CinderPangoLedger.h"
+#include "CinderPangoMetrics.h"
+#include "CinderPangoTrace.h"
+
+#include "cinder/Log.h"
+
+#include <algorithm>
+
+using namespace kp::pango;
+using namespace kp::pango::detail;
+using namespace ci;
+
+namespace {
+
+// Text that has to be shaped and reordered as a whole: right to left scripts and explicit bidi controls, which the side
+// by side segments would put in the wrong order, and scripts whose letters join across a slot boundary
+bool needsWholeLayout( const char *text )
+{
+	for( const char *position = text; *position; position = g_utf8_next_char( position ) ) {
+		const gunichar c = g_utf8_get_char( position );
+		if( ( c == 0x200E ) || ( c == 0x200F ) || ( ( c >= 0x202A ) && ( c <= 0x202E ) ) || ( ( c >= 0x2066 ) && ( c <= 0x2069 ) ) ) {
+			return true;
+		}
+
+		switch( g_unichar_get_script( c ) ) {
+			case G_UNICODE_SCRIPT_ARABIC:
+			case G_UNICODE_SCRIPT_HEBREW:
+			case G_UNICODE_SCRIPT_SYRIAC:
+			case G_UNICODE_SCRIPT_THAANA:
+			case G_UNICODE_SCRIPT_NKO:
+			case G_UNICODE_SCRIPT_MONGOLIAN:
+			case G_UNICODE_SCRIPT_PHAGS_PA:
+				return true;
+			default:
+				break;
+		}
+	}
+	return false;
+}
+
+} // anonymous namespace
+
+CinderPangoTemplateRef CinderPangoTemplate::create( const std::string &templateText, const TextStyle &style )
+{
+	return CinderPangoTemplateRef( new CinderPangoTemplate( templateText, style ) );
+}
+
+CinderPangoTemplate::CinderPangoTemplate( const std::string &templateText, const TextStyle &style ) :
+	mStyle( style ),
+	mTextColor( ColorA::black() ),
+	mBackgroundColor( ColorA::zero() ),
+	mMaxSize( ivec2( 320, 240 ) ),
+	mSegmented( true ),
+	mNeedsFullRender( true ),
+	mPixelWidth( 0 ),
+	mPixelHeight( 0 ),
+	mLineBaseline( 0 ),
+	mLineOffset( 0 ),
+	mFontChangeSerial( FontFallback::getChangeSerial() ),
+	pFontMap( nullptr ),
+	pPangoContext( nullptr ),
+	pFallbackLayout( nullptr ),
+	pFontDescription( nullptr ),
+	pCairoFontOptions( nullptr ),
+	pCairoSurface( nullptr ),
+	pCairoContext( nullptr )
+{
+	// Shared with the thread's instances when FontFallback's shared font map is enabled
+	pFontMap = FontFallback::acquireFontMap();
+	pPangoContext = ResourceLedger::track( Resource::PANGO_CONTEXT, pango_font_map_create_context( pFontMap ) );
+	pFallbackLayout = ResourceLedger::track( Resource::LAYOUT, pango_layout_new( pPangoContext ) );
+
+	pCairoFontOptions = ResourceLedger::track( Resource::FONT_OPTIONS, cairo_font_options_create() );
+	applyFontOptions( pPangoContext, pCairoFontOptions, mStyle.quality );
+
+	updateFontDescription();
+	parse( templateText );
+}
+
+CinderPangoTemplate::~CinderPangoTemplate()
+{
+	for( Segment &segment : mSegments ) {
+		ResourceLedger::untrack( Resource::LAYOUT, segment.layout );
+		g_object_unref( segment.layout );
+	}
+
+	if( pCairoContext ) {
+		ResourceLedger::untrack( Resource::CAIRO_CONTEXT, pCairoContext );
+		cairo_destroy( pCairoContext );
+	}
+
+	if( pCairoSurface ) {
+		ResourceLedger::untrack( Resource::SURFACE, pCairoSurface );
+		cairo_surface_destroy( pCairoSurface );
+	}
+
+	ResourceLedger::untrack( Resource::FONT_DESCRIPTION, pFontDescription );
+	pango_font_description_free( pFontDescription );
+	ResourceLedger::untrack( Resource::FONT_OPTIONS, pCairoFontOptions );
+	cairo_font_options_destroy( pCairoFontOptions );
+	ResourceLedger::untrack( Resource::LAYOUT, pFallbackLayout );
+	g_object_unref( pFallbackLayout );
+	ResourceLedger::untrack( Resource::PANGO_CONTEXT, pPangoContext );
+	g_object_unref( pPangoContext );
+	FontFallback::releaseFontMap( pFontMap );
+}
+
+void CinderPangoTemplate::parse( const std::string &templateText )
+{
+	auto addSegment = [this]( const std::string &name, const std::string &text ) {
+		Segment segment;
+		segment.name = name;
+		segment.text = text;
+		segment.layout = ResourceLedger::track( Resource::LAYOUT, pango_layout_new( pPangoContext ) );
+		segment.needsShaping = true;
+		segment.changed = true;
+		segment.x = 0;
+		segment.width = 0;
+		segment.lastWidth = 0;
+		segment.baseline = 0;
+		segment.height = 0;
+		segment.needsWholeLayout = false;
+		pango_layout_set_font_description( segment.layout, pFontDescription );
+		mSegments.push_back( segment );
+	};
+
+	std::string text;
+	for( size_t i = 0; i < templateText.size(); i++ ) {
+		const char c = templateText[ i ];
+		const char next = ( i + 1 < templateText.size() ) ? templateText[ i + 1 ] : 0;
+
+		if( ( ( c == '{' ) || ( c == '}' ) ) && ( next == c ) ) {
+			text += c;
+			i++;
+		} else if( c == '{' ) {
+			const size_t close = templateText.find( '}', i );
+			if( close == std::string::npos ) {
+				CI_LOG_W( "Unclosed slot in template \"" << templateText << "\"" );
+				text += templateText.substr( i );
+				break;
+			}
+
+			if( ! text.empty() ) {
+				addSegment( "", text );
+				text.clear();
+			}
+
+			addSegment( templateText.substr( i + 1, close - i - 1 ), "" );
+			i = close;
+		} else {
+			text += c;
+		}
+	}
+
+	if( ! text.empty() ) {
+		addSegment( "", text );
+	}
+}
+
+const std::string& CinderPangoTemplate::getSlot( const std::string &name ) const
+{
+	for( const Segment &segment : mSegments ) {
+		if( segment.name == name ) {
+			return segment.text;
+		}
+	}
+
+	static const std::string empty;
+	return empty;
+}
+
+void CinderPangoTemplate::setSlot( const std::string &name, const std::string &value )
+{
+	bool found = false;
+
+	// The same slot may appear more than once
+	for( Segment &segment : mSegments ) {
+		if( ( segment.name == name ) && ! name.empty() ) {
+			found = true;
+			if( segment.text != value ) {
+				segment.text = value;
+				segment.needsShaping = true;
+			}
+		}
+	}
+
+	if( ! found ) {
+		CI_LOG_W( "Template has no slot named \"" << name << "\"" );
+	}
+}
+
+void CinderPangoTemplate::setStyle( const TextStyle &style )
+{
+	if( style.quality != mStyle.quality ) {
+		applyFontOptions( pPangoContext, pCairoFontOptions, style.quality );
+		pango_layout_context_changed( pFallbackLayout );
+		for( Segment &segment : mSegments ) {
+			pango_layout_context_changed( segment.layout );
+		}
+	}
+
+	mStyle = style;
+	updateFontDescription();
+
+	for( Segment &segment : mSegments ) {
+		pango_layout_set_font_description( segment.layout, pFontDescription );
+		segment.needsShaping = true;
+	}
+	mNeedsFullRender = true;
+}
+
+void CinderPangoTemplate::setTextColor( const ColorA &color )
+{
+	if( mTextColor != color ) {
+		mTextColor = color;
+		mNeedsFullRender = true;
+	}
+}
+
+void CinderPangoTemplate::setBackgroundColor( const ColorA &color )
+{
+	if( mBackgroundColor != color ) {
+		mBackgroundColor = color;
+		mNeedsFullRender = true;
+	}
+}
+
+void CinderPangoTemplate::setMaxSize( const ivec2 &maxSize )
+{
+	if( mMaxSize != maxSize ) {
+		mMaxSize = maxSize;
+		mNeedsFullRender = true;
+	}
+}
+
+void CinderPangoTemplate::updateFontDescription()
+{
+	if( pFontDescription ) {
+		ResourceLedger::untrack( Resource::FONT_DESCRIPTION, pFontDescription );
+		pango_font_description_free( pFontDescription );
+	}
+
+	pFontDescription = createFontDescription( mStyle.font, mStyle.size, mStyle.weight, mStyle.italicsEnabled, mStyle.smallCapsEnabled );
+	pango_layout_set_font_description( pFallbackLayout, pFontDescription );
+}
+
+void CinderPangoTemplate::shapeSegment( Segment &segment )
+{
+	if( MarkupPreprocessor::getDefault()->process( segment.text, mProcessedText ) ) {
+		pango_layout_set_markup( segment.layout, mProcessedText.c_str(), -1 );
+		Metrics::increment( Counter::SET_MARKUP_CALLS );
+	} else {
+		// Spans from earlier markup would otherwise stay on the new text's byte ranges
+		pango_layout_set_attributes( segment.layout, nullptr );
+		pango_layout_set_text( segment.layout, mProcessedText.c_str(), -1 );
+	}
+
+	PangoRectangle logicalRect;
+	pango_layout_get_pixel_extents( segment.layout, nullptr, &logicalRect );
+
+	segment.lastWidth = segment.width;
+	segment.width = logicalRect.width;
+	segment.height = logicalRect.height;
+	segment.baseline = PANGO_PIXELS( pango_layout_get_baseline( segment.layout ) );
+	segment.needsWholeLayout = needsWholeLayout( pango_layout_get_text( segment.layout ) );
+	segment.needsShaping = false;
+	segment.changed = true;
+}
+
+void CinderPangoTemplate::checkFontChanges()
+{
+	const uint64_t serial = FontFallback::getChangeSerial();
+	if( serial == mFontChangeSerial ) {
+		return;
+	}
+	if( ! pCairoSurface ) {
+		// Nothing laid out yet, the first render sees the current fonts
+		mFontChangeSerial = serial;
+		return;
+	}
+
+	std::vector<std::string> families;
+	bool hasMissingGlyphs = false;
+	auto addLayout = [&]( PangoLayout *layout ) {
+		addLayoutFamilies( layout, families );
+		hasMissingGlyphs = hasMissingGlyphs || ( pango_layout_get_unknown_glyphs_count( layout ) > 0 );
+	};
+	if( mSegmented ) {
+		for( const Segment &segment : mSegments ) {
+			addLayout( segment.layout );
+		}
+	} else {
+		addLayout( pFallbackLayout );
+	}
+
+	if( FontFallback::isAffected( mFontChangeSerial, families, hasMissingGlyphs ) ) {
+		clearFontMapCache( pFontMap );
+		for( Segment &segment : mSegments ) {
+			pango_layout_context_changed( segment.layout );
+			segment.needsShaping = true;
+		}
+		pango_layout_context_changed( pFallbackLayout );
+		mNeedsFullRender = true;
+		Metrics::increment( Counter::FONT_CHANGE_RELAYOUTS );
+	}
+	mFontChangeSerial = serial;
+}
+
+bool CinderPangoTemplate::render()
+{
+	TraceScope trace( "CinderPangoTemplate::render", this );
+	checkFontChanges();
+
+	bool anyChange = mNeedsFullRender;
+	bool multiline = false;
+	bool wholeLayout = false;
+	int totalWidth = 0;
+
+	for( Segment &segment : mSegments ) {
+		if( segment.needsShaping ) {
+			shapeSegment( segment );
+			anyChange = true;
+		}
+
+		multiline = multiline || ( pango_layout_get_line_count( segment.layout ) > 1 );
+		wholeLayout = wholeLayout || segment.needsWholeLayout;
+		totalWidth += segment.width;
+	}
+
+	if( ! anyChange ) {
+		return false;
+	}
+
+	// Line breaks changed or the text needs bidi reordering or joining across slots, lay the whole thing out together
+	const bool segmented = ! multiline && ! wholeLayout && ( totalWidth <= mMaxSize.x );
+	if( segmented != mSegmented ) {
+		mSegmented = segmented;
+		mNeedsFullRender = true;
+	}
+
+	const bool rendered = mSegmented ? renderSegmented() : renderFallback();
+
+	for( Segment &segment : mSegments ) {
+		segment.changed = false;
+		segment.lastWidth = segment.width;
+	}
+	mNeedsFullRender = false;
+
+	if( rendered ) {
+		uploadTexture();
+	}
+	return rendered;
+}
+
+bool CinderPangoTemplate::renderSegmented()
+{
+	// Segments share a baseline
+	int ascent = 0;
+	int descent = 0;
+	int x = 0;
+	for( Segment &segment : mSegments ) {
+		segment.x = x;
+		x += segment.width;
+		ascent = std::max( ascent, segment.baseline );
+		descent = std::max( descent, segment.height - segment.baseline );
+	}
+
+	// Aligned within the max width like the fallback's line, spacing only goes between lines so it doesn't apply here
+	const int width = getSurfaceWidth( x );
+	int offset = 0;
+	if( mStyle.alignment == TextAlignment::CENTER ) {
+		offset = ( width - x ) / 2;
+	} else if( mStyle.alignment == TextAlignment::RIGHT ) {
+		offset = width - x;
+	}
+	for( Segment &segment : mSegments ) {
+		segment.x += offset;
+	}
+	const int height = std::min( ascent + descent, mMaxSize.y );
+
+	if( resizeSurface( width, height ) || ( ascent != mLineBaseline ) || ( offset != mLineOffset ) ) {
+		mNeedsFullRender = true;
+	}
+	mLineBaseline = ascent;
+	mLineOffset = offset;
+
+	// Work out the dirty span. Changed slots of the same width only dirty their own box,
+	// one that changed width moves everything after it.
+	int dirtyStart = mNeedsFullRender ? 0 : width;
+	int dirtyEnd = mNeedsFullRender ? width : 0;
+	for( const Segment &segment : mSegments ) {
+		if( segment.changed ) {
+			dirtyStart = std::min( dirtyStart, segment.x );
+			dirtyEnd = std::max( dirtyEnd, ( segment.width == segment.lastWidth ) ? segment.x + segment.width : width );
+		}
+	}
+
+	if( dirtyStart >= dirtyEnd ) {
+		return false;
+	}
+
+	cairo_save( pCairoContext );
+	cairo_rectangle( pCairoContext, dirtyStart, 0, dirtyEnd - dirtyStart, height );
+	cairo_clip( pCairoContext );
+	clearRect( dirtyStart, 0, dirtyEnd - dirtyStart, height );
+
+	cairo_set_source_rgba( pCairoContext, mTextColor.r, mTextColor.g, mTextColor.b, mTextColor.a );
+	for( const Segment &segment : mSegments ) {
+		if( ( segment.x < dirtyEnd ) && ( segment.x + segment.width > dirtyStart ) ) {
+			cairo_move_to( pCairoContext, segment.x, mLineBaseline - segment.baseline );
+			pango_cairo_update_layout( pCairoContext, segment.layout );
+			pango_cairo_show_layout( pCairoContext, segment.layout );
+		}
+	}
+
+	cairo_restore( pCairoContext );
+	return true;
+}
+
+bool CinderPangoTemplate::renderFallback()
+{
+	// Same rules as CinderPango, markup only if a segment has any
+	std::string text;
+	bool hasMarkup = false;
+	for( const Segment &segment : mSegments ) {
+		hasMarkup = MarkupPreprocessor::getDefault()->process( segment.text, mProcessedText ) || hasMarkup;
+		text += mProcessedText;
+	}
+
+	pango_layout_set_width( pFallbackLayout, mMaxSize.x * PANGO_SCALE );
+	pango_layout_set_height( pFallbackLayout, mMaxSize.y * PANGO_SCALE );
+	applyAlignment( pFallbackLayout, mStyle.alignment );
+	pango_layout_set_spacing( pFallbackLayout, mStyle.spacing * PANGO_SCALE );
+
+	if( hasMarkup ) {
+		pango_layout_set_markup( pFallbackLayout, text.c_str(), -1 );
+		Metrics::increment( Counter::SET_MARKUP_CALLS );
+	} else {
+		pango_layout_set_attributes( pFallbackLayout, nullptr );
+		pango_layout_set_text( pFallbackLayout, text.c_str(), -1 );
+	}
+
+	const TextMetrics metrics = getLayoutMetrics( pFallbackLayout, mMaxSize );
+	const int width = getSurfaceWidth( metrics.logicalSize.x );
+	const int height = std::min( metrics.logicalSize.y, mMaxSize.y );
+	resizeSurface( width, height );
+
+	clearRect( 0, 0, width, height );
+	cairo_set_source_rgba( pCairoContext, mTextColor.r, mTextColor.g, mTextColor.b, mTextColor.a );
+	cairo_move_to( pCairoContext, 0, 0 );
+	pango_cairo_update_layout( pCairoContext, pFallbackLayout );
+	pango_cairo_show_layout( pCairoContext, pFallbackLayout );
+	return true;
+}
+
+int CinderPangoTemplate::getSurfaceWidth( int textWidth ) const
+{
+	// Centered and right aligned lines are placed within the max width, so the surface has to span all of it
+	if( ( mStyle.alignment == TextAlignment::CENTER ) || ( mStyle.alignment == TextAlignment::RIGHT ) ) {
+		return mMaxSize.x;
+	}
+	return std::min( textWidth, mMaxSize.x );
+}
+
+bool CinderPangoTemplate::resizeSurface( int width, int height )
+{
+	width = std::max( width, 1 );
+	height = std::max( height, 1 );
+
+	if( pCairoSurface && ( width == mPixelWidth ) && ( height == mPixelHeight ) ) {
+		return false;
+	}
+
+	if( pCairoContext ) {
+		ResourceLedger::untrack( Resource::CAIRO_CONTEXT, pCairoContext );
+		cairo_destroy( pCairoContext );
+	}
+
+	if( pCairoSurface ) {
+		ResourceLedger::untrack( Resource::SURFACE, pCairoSurface );
+		cairo_surface_destroy( pCairoSurface );
+	}
+
+	mPixelWidth = width;
+	mPixelHeight = height;
+	pCairoSurface = ResourceLedger::track( Resource::SURFACE, cairo_image_surface_create( CAIRO_FORMAT_ARGB32, width, height ) );
+	pCairoContext = ResourceLedger::track( Resource::CAIRO_CONTEXT, cairo_create( pCairoSurface ) );
+
+	if( CAIRO_STATUS_SUCCESS != cairo_status( pCairoContext ) ) {
+		CI_LOG_E( "Error creating Cairo surface for template." );
+	}
+
+	// Flip vertically, same as CinderPango
+	cairo_scale( pCairoContext, 1.0f, -1.0f );
+	cairo_translate( pCairoContext, 0.0f, -height );
+	return true;
+}
+
+void CinderPangoTemplate::clearRect( double x, double y, double width, double height )
+{
+	cairo_save( pCairoContext );
+	cairo_rectangle( pCairoContext, x, y, width, height );
+	cairo_set_operator( pCairoContext, CAIRO_OPERATOR_SOURCE );
+	cairo_set_source_rgba( pCairoContext, mBackgroundColor.r, mBackgroundColor.g, mBackgroundColor.b, mBackgroundColor.a );
+	cairo_fill( pCairoContext );
+	cairo_restore( pCairoContext );
+}
+
+void CinderPangoTemplate::uploadTexture()
+{
+	cairo_surface_flush( pCairoSurface );
+	auto pixels = cairo_image_surface_get_data( pCairoSurface );
+
+	if( ! mTexture || ( mTexture->getWidth() != mPixelWidth ) || ( mTexture->getHeight() != mPixelHeight ) ) {
+		mTexture = gl::Texture2d::create( pixels, GL_BGRA, mPixelWidth, mPixelHeight );
+	} else {
+		mTexture->update( pixels, GL_BGRA, GL_UNSIGNED_BYTE, 0, mPixelWidth, mPixelHeight );
+	}
+}
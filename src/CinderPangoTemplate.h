@@ -0,0 +1,116 @@
+// CinderPangoTemplate.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPango.h"
+
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+using CinderPangoTemplateRef = std::shared_ptr<class CinderPangoTemplate>;
+
+// Text with a static part and a few changing slots, e.g. "Score: {score}" or "Frame {frame}".
+// The template is split into segments once and each one is shaped into its own layout, so updating a slot only
+// reshapes that slot and re-rasterizes from where it starts (or just its own box, if its width didn't change).
+// The segments are laid out side by side on one line, aligned within the max width by the style's alignment. If the
+// text no longer fits on one line at the max width, contains line breaks, or contains right to left or joining scripts
+// (Arabic, Hebrew, Syriac, Thaana, N'Ko, Mongolian, Phags-pa) or bidi controls, everything is laid out as a single
+// wrapping layout instead, like CinderPango would.
+//
+// Since each segment is shaped on its own, nothing is shaped across a segment boundary: no kerning or ligatures between
+// the last character of one segment and the first of the next, and combining marks at the start of a slot don't attach
+// to the character before it. Keep slot boundaries between words or at punctuation.
+//
+// Uses the thread's shared font map like CinderPango when FontFallback's is enabled, and lays out again on the next
+// render when fonts its text uses are added, replaced or removed (see FontFallback::invalidate).
+//
+// Slots are written in braces, "{{" and "}}" are literal braces. Segments may contain markup as long as each tag
+// opens and closes within the same segment.
+class CinderPangoTemplate {
+  public:
+	static CinderPangoTemplateRef create( const std::string &templateText, const TextStyle &style = TextStyle() );
+	virtual ~CinderPangoTemplate();
+
+	const std::string& getSlot( const std::string &name ) const;
+	void setSlot( const std::string &name, const std::string &value );
+
+	const TextStyle& getStyle() const { return mStyle; }
+	void setStyle( const TextStyle &style );
+
+	const ci::ColorA& getTextColor() const { return mTextColor; }
+	void setTextColor( const ci::ColorA &color );
+
+	const ci::ColorA& getBackgroundColor() const { return mBackgroundColor; }
+	void setBackgroundColor( const ci::ColorA &color );
+
+	ci::ivec2 getMaxSize() const { return mMaxSize; }
+	void setMaxSize( const ci::ivec2 &maxSize );
+
+	// Reshapes and re-rasterizes whatever changed, returns true if the texture was updated
+	bool render();
+
+	ci::gl::TextureRef getTexture() const { return mTexture; }
+	ci::ivec2 getPixelSize() const { return ci::ivec2( mPixelWidth, mPixelHeight ); }
+
+	// False while the template is rendered through the wrapping fallback
+	bool isSegmented() const { return mSegmented; }
+
+  protected:
+	CinderPangoTemplate( const std::string &templateText, const TextStyle &style );
+
+  private:
+	struct Segment {
+		std::string name; // empty for static text
+		std::string text;
+		PangoLayout *layout;
+		bool needsShaping;
+		bool changed; // text changed since the last raster
+		int x;
+		int width;
+		int lastWidth;
+		int baseline;
+		int height;
+		bool needsWholeLayout; // see needsWholeLayout() in the implementation
+	};
+
+	void parse( const std::string &templateText );
+	void checkFontChanges(); // see CinderPangoCore::checkFontChanges
+	void shapeSegment( Segment &segment );
+	void updateFontDescription();
+	bool renderSegmented();
+	bool renderFallback();
+	int getSurfaceWidth( int textWidth ) const;
+	bool resizeSurface( int width, int height );
+	void clearRect( double x, double y, double width, double height );
+	void uploadTexture();
+
+	std::vector<Segment> mSegments;
+	TextStyle mStyle;
+	ci::ColorA mTextColor;
+	ci::ColorA mBackgroundColor;
+	ci::ivec2 mMaxSize;
+
+	bool mSegmented;
+	bool mNeedsFullRender;
+	int mPixelWidth;
+	int mPixelHeight;
+	int mLineBaseline;
+	int mLineOffset; // of the segmented line, from the alignment
+	uint64_t mFontChangeSerial; // FontFallback's, as of the last check
+	std::string mProcessedText;
+
+	PangoFontMap *pFontMap;
+	PangoContext *pPangoContext;
+	PangoLayout *pFallbackLayout;
+	PangoFontDescription *pFontDescription;
+	cairo_font_options_t *pCairoFontOptions;
+	cairo_surface_t *pCairoSurface;
+	cairo_t *pCairoContext;
+	ci::gl::TextureRef mTexture;
+};
+
+}} // namespace kp::pango
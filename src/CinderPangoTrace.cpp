@@ -0,0 +1,230 @@
+// CinderPangoTrace.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+using namespace kp::pango;
+
+std::atomic<bool> Trace::sEnabled( false );
+
+namespace {
+
+struct TraceEvent {
+	const char *name;
+	const void *instance;
+	int64_t beginNanoseconds;
+	int64_t endNanoseconds;
+};
+
+// Only the owning thread writes. The mutex is uncontended except while exporting.
+struct ThreadBuffer {
+	std::mutex mutex;
+	std::vector<TraceEvent> events;
+	uint64_t numRecorded = 0;
+	int threadId = 0;
+	std::string threadName;
+	bool finished = false; // the thread exited, nothing records into it anymore
+};
+
+// Buffers outlive their threads so events from finished workers still export, once they have been exported or cleared
+// they are released
+std::mutex sBuffersMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> sBuffers;
+size_t sEventsPerThread = 16384;
+int sNextThreadId = 1;
+
+// Threads that never record an event, e.g. because tracing is off, only keep their name
+struct ThreadState {
+	std::string name;
+	std::shared_ptr<ThreadBuffer> buffer;
+
+	~ThreadState()
+	{
+		if( ! buffer ) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock( sBuffersMutex );
+		std::lock_guard<std::mutex> bufferLock( buffer->mutex );
+		buffer->finished = true;
+		if( buffer->numRecorded == 0 ) {
+			sBuffers.erase( std::remove( sBuffers.begin(), sBuffers.end(), buffer ), sBuffers.end() );
+		}
+	}
+};
+
+ThreadState& getThreadState()
+{
+	thread_local ThreadState state;
+	return state;
+}
+
+ThreadBuffer& getThreadBuffer( ThreadState &state )
+{
+	if( ! state.buffer ) {
+		auto newBuffer = std::make_shared<ThreadBuffer>();
+		newBuffer->threadName = state.name;
+
+		std::lock_guard<std::mutex> lock( sBuffersMutex );
+		newBuffer->events.resize( sEventsPerThread );
+		newBuffer->threadId = sNextThreadId++;
+		sBuffers.push_back( newBuffer );
+		state.buffer = newBuffer;
+	}
+	return *state.buffer;
+}
+
+// Called with the buffers locked
+void releaseFinishedBuffers( const std::vector<std::shared_ptr<ThreadBuffer>> &finished )
+{
+	for( const auto &buffer : finished ) {
+		sBuffers.erase( std::remove( sBuffers.begin(), sBuffers.end(), buffer ), sBuffers.end() );
+	}
+}
+
+void writeJsonString( std::ostringstream &stream, const std::string &value )
+{
+	stream << '"';
+	for( char c : value ) {
+		if( ( c == '"' ) || ( c == '\\' ) ) {
+			stream << '\\' << c;
+		} else if( static_cast<unsigned char>( c ) >= 0x20 ) {
+			stream << c;
+		}
+	}
+	stream << '"';
+}
+
+} // anonymous namespace
+
+void Trace::setEnabled( bool enabled )
+{
+	sEnabled.store( enabled, std::memory_order_relaxed );
+}
+
+void Trace::setEventsPerThread( size_t count )
+{
+	std::lock_guard<std::mutex> lock( sBuffersMutex );
+	sEventsPerThread = std::max<size_t>( count, 1 );
+}
+
+void Trace::setThreadName( const std::string &name )
+{
+	ThreadState &state = getThreadState();
+	state.name = name;
+	if( state.buffer ) {
+		std::lock_guard<std::mutex> lock( state.buffer->mutex );
+		state.buffer->threadName = name;
+	}
+}
+
+void Trace::record( const char *name, const void *instance, int64_t beginNanoseconds, int64_t endNanoseconds )
+{
+	ThreadState &state = getThreadState();
+	if( ! state.buffer && ! isEnabled() ) {
+		return;
+	}
+
+	ThreadBuffer &buffer = getThreadBuffer( state );
+	std::lock_guard<std::mutex> lock( buffer.mutex );
+	buffer.events[ buffer.numRecorded % buffer.events.size() ] = { name, instance, beginNanoseconds, endNanoseconds };
+	buffer.numRecorded++;
+}
+
+int64_t Trace::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+std::string Trace::toChromeJson()
+{
+	std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+	{
+		std::lock_guard<std::mutex> lock( sBuffersMutex );
+		buffers = sBuffers;
+	}
+
+	std::ostringstream stream;
+	stream.setf( std::ios::fixed );
+	stream.precision( 3 );
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	auto separate = [&] {
+		stream << ( first ? "\n" : ",\n" );
+		first = false;
+	};
+
+	std::vector<std::shared_ptr<ThreadBuffer>> finished;
+	for( const auto &buffer : buffers ) {
+		std::lock_guard<std::mutex> lock( buffer->mutex );
+		if( buffer->finished ) {
+			finished.push_back( buffer );
+		}
+
+		if( ! buffer->threadName.empty() ) {
+			separate();
+			stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId << ",\"args\":{\"name\":";
+			writeJsonString( stream, buffer->threadName );
+			stream << "}}";
+		}
+
+		// Oldest first, only what's still in the ring
+		const uint64_t count = std::min<uint64_t>( buffer->numRecorded, buffer->events.size() );
+		for( uint64_t i = buffer->numRecorded - count; i < buffer->numRecorded; i++ ) {
+			const TraceEvent &event = buffer->events[ i % buffer->events.size() ];
+			separate();
+			stream << "{\"name\":";
+			writeJsonString( stream, event.name );
+			stream << ",\"cat\":\"cinder_pango\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId;
+			stream << ",\"ts\":" << event.beginNanoseconds / 1000.0 << ",\"dur\":" << ( event.endNanoseconds - event.beginNanoseconds ) / 1000.0;
+			if( event.instance ) {
+				stream << ",\"args\":{\"instance\":\"" << event.instance << "\"}";
+			}
+			stream << "}";
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( sBuffersMutex );
+		releaseFinishedBuffers( finished );
+	}
+
+	stream << "\n]}\n";
+	return stream.str();
+}
+
+bool Trace::writeChromeJson( const std::string &path )
+{
+	FILE *file = std::fopen( path.c_str(), "w" );
+	if( ! file ) {
+		return false;
+	}
+
+	const std::string json = toChromeJson();
+	const bool written = ( std::fwrite( json.data(), 1, json.size(), file ) == json.size() );
+	return ( std::fclose( file ) == 0 ) && written;
+}
+
+void Trace::clear()
+{
+	std::lock_guard<std::mutex> lock( sBuffersMutex );
+	std::vector<std::shared_ptr<ThreadBuffer>> finished;
+	for( const auto &buffer : sBuffers ) {
+		std::lock_guard<std::mutex> bufferLock( buffer->mutex );
+		buffer->numRecorded = 0;
+		if( buffer->finished ) {
+			finished.push_back( buffer );
+		}
+	}
+	releaseFinishedBuffers( finished );
+}
@@ -0,0 +1,68 @@
+// CinderPangoTrace.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kp { namespace pango {
+
+// Scoped trace events, recorded per thread and exported in the Chrome trace event format
+// (load the file in chrome://tracing or ui.perfetto.dev). Off by default; while off a TraceScope
+// costs one relaxed atomic load.
+class Trace {
+  public:
+	static void setEnabled( bool enabled );
+	static bool isEnabled() { return sEnabled.load( std::memory_order_relaxed ); }
+
+	// Each thread keeps its most recent events in a ring buffer of this size. Applies to threads that record their first event afterwards.
+	// The buffer is allocated with a thread's first event, and a finished thread's is released once it has been exported or cleared.
+	static void setEventsPerThread( size_t count );
+
+	// Shown in the trace viewer instead of the thread number. Doesn't allocate a buffer by itself.
+	static void setThreadName( const std::string &name );
+
+	// Name must be a string literal (or otherwise outlive the trace), only the pointer is stored
+	static void record( const char *name, const void *instance, int64_t beginNanoseconds, int64_t endNanoseconds );
+	static int64_t now();
+
+	static std::string toChromeJson();
+	static bool writeChromeJson( const std::string &path );
+	static void clear();
+
+  private:
+	static std::atomic<bool> sEnabled;
+};
+
+// Records an event from construction to destruction. The instance shows up in the event's arguments,
+// so events from different CinderPango objects can be told apart.
+class TraceScope {
+  public:
+	explicit TraceScope( const char *name, const void *instance = nullptr ) :
+		mName( name ),
+		mInstance( instance ),
+		mBeginTime( Trace::isEnabled() ? Trace::now() : -1 )
+	{
+	}
+
+	~TraceScope()
+	{
+		if( mBeginTime >= 0 ) {
+			Trace::record( mName, mInstance, mBeginTime, Trace::now() );
+		}
+	}
+
+	TraceScope( const TraceScope & ) = delete;
+	TraceScope& operator=( const TraceScope & ) = delete;
+
+  private:
+	const char *mName;
+	const void *mInstance;
+	int64_t mBeginTime;
+};
+
+}} // namespace kp::pango
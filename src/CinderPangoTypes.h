@@ -0,0 +1,111 @@
+// CinderPangoTypes.h
+// Cinder-Pango
+//
+// The handful of Cinder types the core uses. Inside a Cinder app these are Cinder's own. Define
+// CINDER_PANGO_HEADLESS (the Linux core build does) to get minimal stand-ins instead, so the core
+// only needs Pango, Cairo and fontconfig.
+
+#pragma once
+
+#ifndef CINDER_PANGO_HEADLESS
+
+#include "cinder/Cinder.h"
+#include "cinder/Color.h"
+#include "cinder/Filesystem.h"
+#include "cinder/Log.h"
+#include "cinder/Rect.h"
+#include "cinder/Vector.h"
+
+#else
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace cinder {
+
+namespace fs = std::filesystem;
+
+template <typename T>
+struct Vec2T {
+	T x, y;
+
+	Vec2T() : x( 0 ), y( 0 ) {}
+	Vec2T( T x, T y ) : x( x ), y( y ) {}
+	template <typename U>
+	explicit Vec2T( const Vec2T<U> &other ) : x( static_cast<T>( other.x ) ), y( static_cast<T>( other.y ) ) {}
+
+	bool operator==( const Vec2T &rhs ) const { return ( x == rhs.x ) && ( y == rhs.y ); }
+	bool operator!=( const Vec2T &rhs ) const { return ! ( *this == rhs ); }
+};
+
+using vec2 = Vec2T<float>;
+using ivec2 = Vec2T<int>;
+
+struct Color {
+	float r, g, b;
+
+	Color() : r( 0 ), g( 0 ), b( 0 ) {}
+	Color( float r, float g, float b ) : r( r ), g( g ), b( b ) {}
+
+	static Color black() { return Color( 0, 0, 0 ); }
+	static Color white() { return Color( 1, 1, 1 ); }
+};
+
+struct ColorA {
+	float r, g, b, a;
+
+	ColorA() : r( 0 ), g( 0 ), b( 0 ), a( 1 ) {}
+	ColorA( float r, float g, float b, float a = 1.0f ) : r( r ), g( g ), b( b ), a( a ) {}
+	ColorA( const Color &color, float a = 1.0f ) : r( color.r ), g( color.g ), b( color.b ), a( a ) {}
+
+	static ColorA black() { return ColorA( 0, 0, 0, 1 ); }
+	static ColorA white() { return ColorA( 1, 1, 1, 1 ); }
+	static ColorA zero() { return ColorA( 0, 0, 0, 0 ); }
+
+	bool operator==( const ColorA &rhs ) const { return ( r == rhs.r ) && ( g == rhs.g ) && ( b == rhs.b ) && ( a == rhs.a ); }
+	bool operator!=( const ColorA &rhs ) const { return ! ( *this == rhs ); }
+};
+
+template <typename T>
+struct RectT {
+	T x1, y1, x2, y2;
+
+	RectT() : x1( 0 ), y1( 0 ), x2( 0 ), y2( 0 ) {}
+	RectT( T x1, T y1, T x2, T y2 ) : x1( x1 ), y1( y1 ), x2( x2 ), y2( y2 ) {}
+
+	T getWidth() const { return x2 - x1; }
+	T getHeight() const { return y2 - y1; }
+
+	void include( const RectT &rect )
+	{
+		x1 = std::min( x1, rect.x1 );
+		y1 = std::min( y1, rect.y1 );
+		x2 = std::max( x2, rect.x2 );
+		y2 = std::max( y2, rect.y2 );
+	}
+};
+
+using Rectf = RectT<float>;
+
+} // namespace cinder
+
+namespace ci = cinder;
+
+namespace glm {
+
+template <typename T>
+T clamp( T value, T minValue, T maxValue )
+{
+	return std::min( std::max( value, minValue ), maxValue );
+}
+
+} // namespace glm
+
+// Cinder's logging macros, verbose output is dropped
+#define CI_LOG_E( stream ) ( std::cerr << "|error  | Cinder-Pango " << stream << std::endl )
+#define CI_LOG_W( stream ) ( std::cerr << "|warning| Cinder-Pango " << stream << std::endl )
+#define CI_LOG_I( stream ) ( std::clog << "|info   | Cinder-Pango " << stream << std::endl )
+#define CI_LOG_V( stream ) ( (void)0 )
+
+#endif
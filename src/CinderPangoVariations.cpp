@@ -0,0 +1,306 @@
+// CinderPangoVariations.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoVariations.h"
+#include "CinderPangoFallback.h"
+#include "CinderPangoFreeType.h"
+#include "CinderPangoMetrics.h"
+#include "CinderPangoTrace.h"
+#include "CinderPangoTypes.h"
+
+#include <fontconfig/fontconfig.h>
+#include <fontconfig/fcfreetype.h>
+#include <glib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <mutex>
+
+using namespace kp::pango;
+
+namespace {
+
+// Where the faces of a family come from, and its axes if it has any
+struct VariableFont {
+	std::string file; // what fontconfig lists, also the name of memory fonts
+	int index = 0;
+	const FT_Byte *data = nullptr; // set for fonts registered from memory
+	FT_Long size = 0;
+	std::vector<FontAxis> axes;
+};
+
+struct Instance {
+	std::string family; // the variable font's
+	FT_Face face;
+};
+
+struct Variations {
+	std::mutex mutex; // taken after the font set lock, see resolve()
+	std::map<std::string, VariableFont> fonts;
+	uint64_t generation = 0; // FontFallback's, fonts loaded since may have filled in families that didn't match before
+	uint64_t changeSerial = 0;
+	std::map<std::string, Instance> instances; // by the instance's family
+	std::vector<FT_Face> faces; // every instance's, dropped ones included
+	float defaultStep = 1.0f;
+	std::map<std::string, float> steps;
+};
+
+// Never destroyed, fontconfig's patterns keep referencing the instances' faces until the process exits
+Variations& getVariations()
+{
+	static Variations *variations = new Variations();
+	return *variations;
+}
+
+std::string getTag( FT_ULong tag )
+{
+	const char characters[] = { static_cast<char>( ( tag >> 24 ) & 0xFF ), static_cast<char>( ( tag >> 16 ) & 0xFF ), static_cast<char>( ( tag >> 8 ) & 0xFF ),
+		static_cast<char>( tag & 0xFF ) };
+	return std::string( characters, 4 );
+}
+
+// Called with the FreeType mutex held
+FT_Error openFace( const VariableFont &font, FT_Face *face )
+{
+	return font.data ? detail::newMemoryFace( font.data, font.size, font.index, face ) : detail::newFace( font.file.c_str(), font.index, face );
+}
+
+bool hasFamily( FcPattern *pattern, const std::string &family )
+{
+	FcChar8 *matchedFamily = nullptr;
+	for( int i = 0; FcPatternGetString( pattern, FC_FAMILY, i, &matchedFamily ) == FcResultMatch; i++ ) {
+		if( FcStrCmpIgnoreCase( matchedFamily, reinterpret_cast<const FcChar8 *>( family.c_str() ) ) == 0 ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Called with the variations locked. Families that don't match or aren't variable are kept without axes.
+const VariableFont& findFont( Variations &variations, const std::string &family )
+{
+	if( ( variations.generation != FontFallback::getGeneration() ) || ( variations.changeSerial != FontFallback::getChangeSerial() ) ) {
+		variations.fonts.clear();
+		variations.generation = FontFallback::getGeneration();
+		variations.changeSerial = FontFallback::getChangeSerial();
+	}
+
+	auto found = variations.fonts.find( family );
+	if( found != variations.fonts.end() ) {
+		return found->second;
+	}
+
+	TraceScope trace( "variations.findFont" );
+	VariableFont &font = variations.fonts[ family ];
+
+	FcPattern *pattern = FcPatternCreate();
+	FcPatternAddString( pattern, FC_FAMILY, reinterpret_cast<const FcChar8 *>( family.c_str() ) );
+	FcConfigSubstitute( nullptr, pattern, FcMatchPattern );
+	FcDefaultSubstitute( pattern );
+	FcResult result;
+	FcPattern *match = FcFontMatch( nullptr, pattern, &result );
+	FcPatternDestroy( pattern );
+
+	// Substitutes for a missing family don't count, the instance would be named after a font it isn't
+	FcChar8 *file = nullptr;
+	if( ! match || ! hasFamily( match, family ) || ( FcPatternGetString( match, FC_FILE, 0, &file ) != FcResultMatch ) ) {
+		CI_LOG_V( "No font for family \"" << family << "\", it has no axes" );
+		if( match ) {
+			FcPatternDestroy( match );
+		}
+		return font;
+	}
+
+	font.file = reinterpret_cast<const char *>( file );
+	FcPatternGetInteger( match, FC_INDEX, 0, &font.index );
+	// Named instances are in the upper bits, the instances here start from the default coordinates instead
+	font.index &= 0xFFFF;
+
+	FT_Face registeredFace = nullptr;
+	if( ( FcPatternGetFTFace( match, FC_FT_FACE, 0, &registeredFace ) == FcResultMatch ) && registeredFace->stream->base ) {
+		font.data = registeredFace->stream->base;
+		font.size = static_cast<FT_Long>( registeredFace->stream->size );
+	}
+	FcPatternDestroy( match );
+
+	std::lock_guard<std::mutex> lock( detail::getFreeTypeMutex() );
+	FT_Face face = nullptr;
+	if( openFace( font, &face ) != 0 ) {
+		CI_LOG_E( "FreeType could not open \"" << font.file << "\" for family \"" << family << "\"" );
+		return font;
+	}
+
+	FT_MM_Var *variation = nullptr;
+	if( FT_HAS_MULTIPLE_MASTERS( face ) && ( detail::getMMVar( face, &variation ) == 0 ) ) {
+		for( FT_UInt i = 0; i < variation->num_axis; i++ ) {
+			const FT_Var_Axis &axis = variation->axis[ i ];
+			font.axes.push_back( { getTag( axis.tag ), axis.minimum / 65536.0f, axis.def / 65536.0f, axis.maximum / 65536.0f } );
+		}
+		detail::doneMMVar( variation );
+	}
+	detail::doneFace( face );
+
+	return font;
+}
+
+// Called with the variations locked. The family of the instance for the axes, or the family itself if there is no
+// such instance, i.e. the font isn't variable or the axes are its defaults. font and coordinates are what to create it from.
+std::string getInstanceFamily( Variations &variations, const std::string &family, const FontAxes &axes, const VariableFont *&font, std::vector<FT_Fixed> &coordinates )
+{
+	font = &findFont( variations, family );
+	if( font->axes.empty() ) {
+		return family;
+	}
+
+	// Every axis gets a coordinate, the ones not asked for keep their default. Only the others go into the name, so the
+	// same tuple always gets the same family.
+	coordinates.clear();
+	std::string instance = family + " [";
+	bool isDefault = true;
+	for( const FontAxis &axis : font->axes ) {
+		float value = axis.defaultValue;
+		auto requested = axes.find( axis.tag );
+		if( requested != axes.end() ) {
+			auto step = variations.steps.find( axis.tag );
+			const float quantizationStep = ( step != variations.steps.end() ) ? step->second : variations.defaultStep;
+			value = ( quantizationStep > 0.0f ) ? std::round( requested->second / quantizationStep ) * quantizationStep : requested->second;
+			value = std::min( std::max( value, axis.minimum ), axis.maximum );
+		}
+		coordinates.push_back( static_cast<FT_Fixed>( std::lround( value * 65536.0f ) ) );
+
+		if( value != axis.defaultValue ) {
+			gchar number[ G_ASCII_DTOSTR_BUF_SIZE ];
+			instance += ( isDefault ? "" : " " ) + axis.tag + "=" + g_ascii_formatd( number, sizeof( number ), "%g", value );
+			isDefault = false;
+		}
+	}
+	return isDefault ? family : instance + "]";
+}
+
+} // anonymous namespace
+
+std::string FontVariations::resolve( const std::string &family, const FontAxes &axes, bool *deferred )
+{
+	if( deferred ) {
+		*deferred = false;
+	}
+	if( axes.empty() ) {
+		return family;
+	}
+
+	Variations &variations = getVariations();
+	std::unique_lock<std::mutex> lock( variations.mutex );
+	const VariableFont *font = nullptr;
+	std::vector<FT_Fixed> coordinates;
+	std::string instance = getInstanceFamily( variations, family, axes, font, coordinates );
+	if( ( instance == family ) || variations.instances.count( instance ) ) {
+		return instance;
+	}
+
+	// Workers matching fonts in the background would see the font set change under them. FontWatcher holds the font set
+	// lock while it drops instances, so it's taken first and the lookup repeated, the fonts may have changed meanwhile.
+	lock.unlock();
+	detail::FontSetWriteLock fontSetLock( false );
+	if( ! fontSetLock.isLocked() ) {
+		if( deferred ) {
+			*deferred = true;
+		}
+		return family;
+	}
+	lock.lock();
+	instance = getInstanceFamily( variations, family, axes, font, coordinates );
+	if( ( instance == family ) || variations.instances.count( instance ) ) {
+		return instance;
+	}
+
+	TraceScope trace( "variations.createInstance" );
+	std::lock_guard<std::mutex> freeTypeLock( detail::getFreeTypeMutex() );
+	FT_Face face = nullptr;
+	if( openFace( *font, &face ) != 0 ) {
+		CI_LOG_E( "FreeType could not open \"" << font->file << "\" for \"" << instance << "\"" );
+		return family;
+	}
+
+	if( detail::setVarDesignCoordinates( face, static_cast<FT_UInt>( coordinates.size() ), coordinates.data() ) != 0 ) {
+		CI_LOG_E( "FreeType could not apply the axes of \"" << instance << "\"" );
+		detail::doneFace( face );
+		return family;
+	}
+
+	// A family nobody has asked for before, or one dropped together with the fonts that had it, so no font map has
+	// anything cached for it and nothing needs invalidating
+	if( detail::registerFace( face, font->file, font->index, instance ).empty() ) {
+		detail::doneFace( face );
+		return family;
+	}
+
+	variations.faces.push_back( face );
+	variations.instances[ instance ] = { family, face };
+	Metrics::increment( Counter::VARIATION_INSTANCES );
+	return instance;
+}
+
+std::vector<FontAxis> FontVariations::getAxes( const std::string &family )
+{
+	Variations &variations = getVariations();
+	std::lock_guard<std::mutex> lock( variations.mutex );
+	return findFont( variations, family ).axes;
+}
+
+void FontVariations::setQuantizationStep( float step )
+{
+	Variations &variations = getVariations();
+	std::lock_guard<std::mutex> lock( variations.mutex );
+	variations.defaultStep = step;
+}
+
+void FontVariations::setQuantizationStep( const std::string &tag, float step )
+{
+	Variations &variations = getVariations();
+	std::lock_guard<std::mutex> lock( variations.mutex );
+	variations.steps[ tag ] = step;
+}
+
+float FontVariations::getQuantizationStep( const std::string &tag )
+{
+	Variations &variations = getVariations();
+	std::lock_guard<std::mutex> lock( variations.mutex );
+	auto step = variations.steps.find( tag );
+	return ( step != variations.steps.end() ) ? step->second : variations.defaultStep;
+}
+
+size_t FontVariations::getInstanceCount()
+{
+	Variations &variations = getVariations();
+	std::lock_guard<std::mutex> lock( variations.mutex );
+	return variations.instances.size();
+}
+
+void detail::dropVariationInstances( std::vector<std::string> &families )
+{
+	Variations &variations = getVariations();
+	std::lock_guard<std::mutex> lock( variations.mutex );
+	auto isDropped = [&families]( const std::string &family ) {
+		return std::any_of( families.begin(), families.end(), [&family]( const std::string &dropped ) { return g_ascii_strcasecmp( dropped.c_str(), family.c_str() ) == 0; } );
+	};
+
+	// The axes and the data found for the families may be gone with the faces they came from
+	for( auto font = variations.fonts.begin(); font != variations.fonts.end(); ) {
+		font = isDropped( font->first ) ? variations.fonts.erase( font ) : std::next( font );
+	}
+
+	std::vector<std::string> instances;
+	for( auto instance = variations.instances.begin(); instance != variations.instances.end(); ) {
+		if( isDropped( instance->second.family ) ) {
+			// Kept alive with the others, fonts created from it may still be around
+			detail::unregisterFace( instance->second.face );
+			instances.push_back( instance->first );
+			instance = variations.instances.erase( instance );
+		} else {
+			++instance;
+		}
+	}
+	families.insert( families.end(), instances.begin(), instances.end() );
+}
@@ -0,0 +1,57 @@
+// CinderPangoVariations.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+// Axis tag to design coordinate, e.g. { { "wght", 650.0f }, { "wdth", 90.0f } }
+using FontAxes = std::map<std::string, float>;
+
+struct FontAxis {
+	std::string tag;
+	float minimum;
+	float defaultValue;
+	float maximum;
+};
+
+// Continuous axes of variable fonts (weight, width, slant, optical size, ...). The Pango version of the block can't pass
+// variations to fonts, so each axis tuple becomes its own FreeType face with the coordinates applied, registered with
+// fontconfig under a family of its own, e.g. "Roboto Flex [wght=650 wdth=90]". That family works anywhere a family does.
+//
+// Values are rounded to the axis' quantization step and clamped to the axis range before the lookup, and instances are
+// kept for the life of the process, so animating an axis only creates a face the first time a step is reached and
+// afterwards finds it again. The step trades smoothness for faces held, each of which also gets its own glyph caches.
+// Tuples that round to the font's defaults resolve to the family itself. When FontWatcher replaces or removes the file a
+// family comes from, its instances are dropped and the next resolve() creates them again from the new file.
+//
+// Uses the FREETYPE renderer's font stack. Instances are added to the same fontconfig font set other threads match
+// against, so like loading fonts, resolve the tuples an animation goes through before other threads render. A new
+// instance can't be created while FontWarmUp::warmUpAsync(), CinderPangoCore::measureBatch() or PagedExport workers
+// are matching fonts, resolve() then returns the family unchanged and reports it as deferred. CinderPangoCore retries
+// its default axes on the next render or measure, TextAttributes::axes() spans have to be built again.
+class FontVariations {
+  public:
+	// The family of the instance, created on first use. Returns the family unchanged when it isn't a variable font or
+	// none of the axes apply to it, or when creating the instance had to be deferred (see above). Unknown axis tags are
+	// ignored.
+	static std::string resolve( const std::string &family, const FontAxes &axes, bool *deferred = nullptr );
+
+	// The axes of the font family resolves to, empty if it isn't variable
+	static std::vector<FontAxis> getAxes( const std::string &family );
+
+	// In design units of the axis, 1 by default, 0 to not quantize. The step for a tag overrides the default one, e.g.
+	// setQuantizationStep( "wght", 25.0f ). Only affects later lookups.
+	static void setQuantizationStep( float step );
+	static void setQuantizationStep( const std::string &tag, float step );
+	static float getQuantizationStep( const std::string &tag );
+
+	static size_t getInstanceCount();
+};
+
+}} // namespace kp::pango
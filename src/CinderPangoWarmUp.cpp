@@ -0,0 +1,288 @@
+// CinderPangoWarmUp.cpp
+// Cinder-Pango
+//
+
+#include "CinderPangoWarmUp.h"
+#include "CinderPangoFallback.h"
+#include "CinderPangoFreeType.h"
+#include "CinderPangoInternal.h"
+#include "CinderPangoLedger.h"
+#include "CinderPangoTrace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <locale>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+using namespace kp::pango;
+
+std::atomic<bool> UsageRecorder::sEnabled( false );
+
+namespace {
+
+// Wide enough that lines are long, narrow enough that the scratch surface stays small
+const int kScratchWidth = 1024;
+
+// Font description without size, size in Pango units, quality
+using UsageKey = std::tuple<std::string, int, int, int, int, int>;
+
+std::mutex sUsageMutex;
+std::map<UsageKey, std::set<gunichar>> sUsage;
+
+// Every line drawn at the top left of a surface one line tall, so every glyph lands inside it and gets rasterized
+size_t rasterizeLines( PangoLayout *layout, cairo_surface_t *&surface, cairo_t *&context )
+{
+	int lineHeight = 0;
+	for( GSList *line = pango_layout_get_lines_readonly( layout ); line; line = line->next ) {
+		PangoRectangle logicalRect;
+		pango_layout_line_get_pixel_extents( static_cast<PangoLayoutLine *>( line->data ), nullptr, &logicalRect );
+		lineHeight = std::max( lineHeight, logicalRect.height );
+	}
+
+	if( ! surface || ( cairo_image_surface_get_height( surface ) < lineHeight ) ) {
+		if( context ) {
+			ResourceLedger::untrack( Resource::CAIRO_CONTEXT, context );
+			cairo_destroy( context );
+			ResourceLedger::untrack( Resource::SURFACE, surface );
+			cairo_surface_destroy( surface );
+		}
+		surface = ResourceLedger::track( Resource::SURFACE, cairo_image_surface_create( CAIRO_FORMAT_ARGB32, kScratchWidth, std::max( lineHeight, 1 ) ) );
+		context = ResourceLedger::track( Resource::CAIRO_CONTEXT, cairo_create( surface ) );
+	}
+
+	// Merges the surface's font options into the layout's, the same way render() does, so the glyphs end up in the same
+	// Cairo scaled fonts as the instances'
+	pango_cairo_update_layout( context, layout );
+
+	for( GSList *line = pango_layout_get_lines_readonly( layout ); line; line = line->next ) {
+		PangoLayoutLine *layoutLine = static_cast<PangoLayoutLine *>( line->data );
+		PangoRectangle logicalRect;
+		pango_layout_line_get_pixel_extents( layoutLine, nullptr, &logicalRect );
+		cairo_move_to( context, -logicalRect.x, -logicalRect.y );
+		pango_cairo_show_layout_line( context, layoutLine );
+	}
+	cairo_surface_flush( surface );
+
+	return static_cast<size_t>( g_utf8_strlen( pango_layout_get_text( layout ), -1 ) );
+}
+
+void appendCharacter( std::string &text, gunichar character )
+{
+	char buffer[ 6 ];
+	text.append( buffer, g_unichar_to_utf8( character, buffer ) );
+}
+
+} // anonymous namespace
+
+size_t FontWarmUp::warmUp( const std::vector<WarmUpRequest> &requests )
+{
+	TraceScope trace( "warmUp" );
+	detail::FontSetReadScope fontSetScope;
+
+	// The calling thread's shared font map if there is one, so its Pango caches warm up too
+	PangoFontMap *fontMap = FontFallback::acquireFontMap();
+	if( ! fontMap ) {
+		CI_LOG_E( "Cannot create the pango font map." );
+		return 0;
+	}
+
+	PangoContext *pangoContext = ResourceLedger::track( Resource::PANGO_CONTEXT, pango_font_map_create_context( fontMap ) );
+	cairo_font_options_t *fontOptions = ResourceLedger::track( Resource::FONT_OPTIONS, cairo_font_options_create() );
+	PangoLayout *layout = ResourceLedger::track( Resource::LAYOUT, pango_layout_new( pangoContext ) );
+	pango_layout_set_width( layout, kScratchWidth * PANGO_SCALE );
+	pango_layout_set_wrap( layout, PANGO_WRAP_CHAR );
+
+	cairo_surface_t *surface = nullptr;
+	cairo_t *cairoContext = nullptr;
+	size_t characters = 0;
+
+	for( const WarmUpRequest &request : requests ) {
+		if( request.characters.empty() ) {
+			continue;
+		}
+		if( ! g_utf8_validate( request.characters.c_str(), request.characters.size(), nullptr ) ) {
+			CI_LOG_E( "Warm up characters for \"" << request.font << "\" are not valid UTF-8." );
+			continue;
+		}
+
+		detail::applyFontOptions( pangoContext, fontOptions, request.quality );
+		pango_layout_context_changed( layout );
+		pango_layout_set_text( layout, request.characters.c_str(), static_cast<int>( request.characters.size() ) );
+
+		for( float size : request.sizes ) {
+			TraceScope sizeTrace( "warmUp.size" );
+			PangoFontDescription *fontDescription = ResourceLedger::track( Resource::FONT_DESCRIPTION, pango_font_description_from_string( request.font.c_str() ) );
+			pango_font_description_set_size( fontDescription, static_cast<gint>( std::lround( size * PANGO_SCALE ) ) );
+			pango_layout_set_font_description( layout, fontDescription );
+			ResourceLedger::untrack( Resource::FONT_DESCRIPTION, fontDescription );
+			pango_font_description_free( fontDescription );
+
+			characters += rasterizeLines( layout, surface, cairoContext );
+		}
+	}
+
+	if( cairoContext ) {
+		ResourceLedger::untrack( Resource::CAIRO_CONTEXT, cairoContext );
+		cairo_destroy( cairoContext );
+		ResourceLedger::untrack( Resource::SURFACE, surface );
+		cairo_surface_destroy( surface );
+	}
+	ResourceLedger::untrack( Resource::LAYOUT, layout );
+	g_object_unref( layout );
+	ResourceLedger::untrack( Resource::FONT_OPTIONS, fontOptions );
+	cairo_font_options_destroy( fontOptions );
+	ResourceLedger::untrack( Resource::PANGO_CONTEXT, pangoContext );
+	g_object_unref( pangoContext );
+	FontFallback::releaseFontMap( fontMap );
+
+	return characters;
+}
+
+std::shared_future<size_t> FontWarmUp::warmUpAsync( const std::vector<WarmUpRequest> &requests )
+{
+	return std::async( std::launch::async, [requests] {
+		Trace::setThreadName( "FontWarmUp" );
+		return warmUp( requests );
+	} ).share();
+}
+
+std::string FontWarmUp::makeCharacterRange( uint32_t first, uint32_t last )
+{
+	std::string characters;
+	for( uint32_t character = first; character <= std::min<uint32_t>( last, 0x10FFFF ); character++ ) {
+		if( g_unichar_isdefined( character ) && ! g_unichar_iscntrl( character ) && ! g_unichar_isspace( character ) ) {
+			appendCharacter( characters, character );
+		}
+	}
+	return characters;
+}
+
+void UsageRecorder::setEnabled( bool enabled )
+{
+	sEnabled = enabled;
+}
+
+void UsageRecorder::record( PangoLayout *layout, const TextQuality &quality )
+{
+	TraceScope trace( "usageRecorder.record" );
+	const char *text = pango_layout_get_text( layout );
+	PangoLayoutIter *iter = pango_layout_get_iter( layout );
+
+	std::lock_guard<std::mutex> lock( sUsageMutex );
+	do {
+		// Null at the end of each line
+		PangoLayoutRun *run = pango_layout_iter_get_run_readonly( iter );
+		if( ! run || ! run->item->analysis.font ) {
+			continue;
+		}
+
+		// The font the run was actually drawn with, after fallback and markup
+		PangoFontDescription *fontDescription = pango_font_describe( run->item->analysis.font );
+		const int size = pango_font_description_get_size( fontDescription );
+		pango_font_description_unset_fields( fontDescription, PANGO_FONT_MASK_SIZE );
+		char *font = pango_font_description_to_string( fontDescription );
+		std::set<gunichar> &characters = sUsage[ UsageKey( font, size, static_cast<int>( quality.antialias ), static_cast<int>( quality.hintStyle ),
+			static_cast<int>( quality.hintMetrics ), static_cast<int>( quality.subpixelOrder ) ) ];
+		g_free( font );
+		pango_font_description_free( fontDescription );
+
+		const char *end = text + run->item->offset + run->item->length;
+		for( const char *position = text + run->item->offset; position < end; position = g_utf8_next_char( position ) ) {
+			const gunichar character = g_utf8_get_char( position );
+			if( ! g_unichar_isspace( character ) && ! g_unichar_iscntrl( character ) ) {
+				characters.insert( character );
+			}
+		}
+	} while( pango_layout_iter_next_run( iter ) );
+
+	pango_layout_iter_free( iter );
+}
+
+void UsageRecorder::clear()
+{
+	std::lock_guard<std::mutex> lock( sUsageMutex );
+	sUsage.clear();
+}
+
+std::vector<WarmUpRequest> UsageRecorder::getProfile()
+{
+	std::lock_guard<std::mutex> lock( sUsageMutex );
+	std::vector<WarmUpRequest> profile;
+	for( const auto &usage : sUsage ) {
+		WarmUpRequest request;
+		request.font = std::get<0>( usage.first );
+		request.sizes = { static_cast<float>( std::get<1>( usage.first ) ) / PANGO_SCALE };
+		request.quality.antialias = static_cast<TextAntialias>( std::get<2>( usage.first ) );
+		request.quality.hintStyle = static_cast<TextHintStyle>( std::get<3>( usage.first ) );
+		request.quality.hintMetrics = static_cast<TextHintMetrics>( std::get<4>( usage.first ) );
+		request.quality.subpixelOrder = static_cast<TextSubpixelOrder>( std::get<5>( usage.first ) );
+		for( gunichar character : usage.second ) {
+			appendCharacter( request.characters, character );
+		}
+		profile.push_back( request );
+	}
+	return profile;
+}
+
+bool UsageRecorder::save( const ci::fs::path &path )
+{
+	std::ofstream output( path.string(), std::ios::binary );
+	if( ! output ) {
+		CI_LOG_E( "Could not open usage profile \"" << path << "\" for writing." );
+		return false;
+	}
+	output.imbue( std::locale::classic() );
+	// Enough digits that a size in Pango units survives the round trip through points and rounds back to the same unit
+	output << std::setprecision( 9 );
+
+	// Whitespace and control characters are never recorded, so the last field can't contain a tab or line break
+	for( const WarmUpRequest &request : getProfile() ) {
+		const TextQuality &quality = request.quality;
+		output << request.font << '\t' << request.sizes.front() << '\t' << static_cast<int>( quality.antialias ) << ',' << static_cast<int>( quality.hintStyle ) << ','
+			   << static_cast<int>( quality.hintMetrics ) << ',' << static_cast<int>( quality.subpixelOrder ) << '\t' << request.characters << '\n';
+	}
+	return static_cast<bool>( output );
+}
+
+std::vector<WarmUpRequest> UsageRecorder::load( const ci::fs::path &path )
+{
+	std::vector<WarmUpRequest> profile;
+	std::ifstream input( path.string(), std::ios::binary );
+	if( ! input ) {
+		// No profile yet is normal on a first run
+		CI_LOG_V( "No usage profile at \"" << path << "\"" );
+		return profile;
+	}
+
+	std::string line;
+	while( std::getline( input, line ) ) {
+		std::istringstream fields( line );
+		WarmUpRequest request;
+		std::string size;
+		std::string quality;
+		if( ! std::getline( fields, request.font, '\t' ) || ! std::getline( fields, size, '\t' ) || ! std::getline( fields, quality, '\t' ) ||
+			! std::getline( fields, request.characters ) ) {
+			CI_LOG_E( "Skipping malformed usage profile line in \"" << path << "\"" );
+			continue;
+		}
+		request.sizes = { static_cast<float>( g_ascii_strtod( size.c_str(), nullptr ) ) };
+		int values[] = { static_cast<int>( request.quality.antialias ), static_cast<int>( request.quality.hintStyle ), static_cast<int>( request.quality.hintMetrics ),
+			static_cast<int>( request.quality.subpixelOrder ) };
+		std::istringstream qualityFields( quality );
+		std::string value;
+		for( int i = 0; ( i < 4 ) && std::getline( qualityFields, value, ',' ); i++ ) {
+			values[ i ] = std::atoi( value.c_str() );
+		}
+		request.quality = { static_cast<TextAntialias>( values[ 0 ] ), static_cast<TextHintStyle>( values[ 1 ] ), static_cast<TextHintMetrics>( values[ 2 ] ),
+			static_cast<TextSubpixelOrder>( values[ 3 ] ) };
+		profile.push_back( request );
+	}
+	return profile;
+}
@@ -0,0 +1,63 @@
+// CinderPangoWarmUp.h
+// Cinder-Pango
+//
+
+#pragma once
+
+#include "CinderPangoCore.h"
+
+#include <atomic>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace kp { namespace pango {
+
+struct WarmUpRequest {
+	std::string font = "Sans"; // Pango font description without a size, style words included, e.g. "Noto Sans Bold Italic"
+	std::vector<float> sizes = { 12.0f };
+	std::string characters;	   // UTF-8, laid out and rasterized once per size
+	TextQuality quality;	   // glyphs are cached per quality, warm up the one the instances use
+};
+
+// Gets the first use of a font, size and set of characters out of the way before it shows up as a hitch: loads the faces
+// (fallbacks included) and rasterizes every glyph into a scratch surface. Cairo keeps FreeType faces and rasterized glyphs
+// per process, so that part carries over to instances on any thread. Pango's own font caches belong to a font map, and
+// only carry over to instances sharing it, i.e. ones created later on the same thread with FontFallback's shared font map
+// enabled. Recently used sizes stay cached in Cairo, a few hundred font and size combinations at most.
+//
+// While a warm-up runs, FontWatcher and FontVariations defer changes to fontconfig's font sets and FontPack waits.
+class FontWarmUp {
+  public:
+	// Returns the number of characters rasterized, summed over all sizes
+	static size_t warmUp( const std::vector<WarmUpRequest> &requests );
+	static std::shared_future<size_t> warmUpAsync( const std::vector<WarmUpRequest> &requests );
+
+	// Every assigned code point from first to last, e.g. makeCharacterRange( 0x20, 0x7E ) for printable ASCII
+	static std::string makeCharacterRange( uint32_t first, uint32_t last );
+};
+
+// Records which fonts, sizes and characters renders actually used, fallback fonts and markup spans included, so the next
+// start can replay them: FontWarmUp::warmUpAsync( UsageRecorder::load( "fonts.profile" ) ) before the first frame.
+// Off by default. While off, render() checks one atomic flag; while on, each full render walks its layout's runs.
+class UsageRecorder {
+  public:
+	static void setEnabled( bool enabled );
+	static bool isEnabled() { return sEnabled.load( std::memory_order_relaxed ); }
+
+	static void record( PangoLayout *layout, const TextQuality &quality );
+	static void clear();
+
+	// One request per font, size and quality, in a stable order
+	static std::vector<WarmUpRequest> getProfile();
+
+	// One tab separated line per request: font, size, quality, characters. The quality is antialias, hint style, hint
+	// metrics and subpixel order, comma separated. Profiles with only the antialias there load with the rest crisp.
+	static bool save( const ci::fs::path &path );
+	static std::vector<WarmUpRequest> load( const ci::fs::path &path );
+
+  private:
+	static std::atomic<bool> sEnabled;
+};
+
+}} // namespace kp::pango